@@ -1150,6 +1150,8 @@ static void do_video_out(OutputFile *of,
     AVCodecContext *enc = ost->enc_ctx;
     AVRational frame_rate;
     int nb_frames, nb0_frames, i;
+    int next_duplicate = next_picture && next_picture->flags & AV_FRAME_FLAG_DUPLICATE;
+    int next_encoded = 0;
     double delta, delta0;
     double duration = 0;
     double sync_ipts = AV_NOPTS_VALUE;
@@ -1301,6 +1303,19 @@ static void do_video_out(OutputFile *of,
         if (!in_picture)
             return;
 
+        /* mark the frames with the same content as the previous encoded one,
+         * a filtered frame marked as duplicate may follow a dropped one */
+        if (in_picture == next_picture ?
+            next_encoded || (next_duplicate && ost->last_frame_encoded) :
+            ost->last_frame_encoded)
+            in_picture->flags |= AV_FRAME_FLAG_DUPLICATE;
+        else
+            in_picture->flags &= ~AV_FRAME_FLAG_DUPLICATE;
+        if (in_picture == next_picture)
+            next_encoded = 1;
+        else
+            ost->last_frame_encoded = 1;
+
         in_picture->pts = ost->sync_opts;
 
         if (!check_recording_time(ost))
@@ -1424,6 +1439,7 @@ static void do_video_out(OutputFile *of,
         av_frame_ref(ost->last_frame, next_picture);
     else
         av_frame_free(&ost->last_frame);
+    ost->last_frame_encoded = next_encoded;
 
     return;
 error:
@@ -4175,8 +4191,11 @@ static int init_input_thread(int i)
     if (f->ctx->pb ? !f->ctx->pb->seekable :
         strcmp(f->ctx->iformat->name, "lavfi"))
         f->non_blocking = 1;
-    ret = av_thread_message_queue_alloc(&f->in_thread_queue,
-                                        f->thread_queue_size, sizeof(f->pkt));
+    /* input_thread() is the only sender and the main thread the only
+     * receiver */
+    ret = av_thread_message_queue_alloc2(&f->in_thread_queue,
+                                         f->thread_queue_size, sizeof(f->pkt),
+                                         AV_THREAD_MESSAGE_QUEUE_SPSC);
     if (ret < 0)
         return ret;
 
@@ -480,6 +480,7 @@ typedef struct OutputStream {
     AVPacket *pkt;
     int last_dropped;
     int last_nb0_frames[3];
+    int last_frame_encoded;   ///< last_frame was the last frame sent to the encoder
 
     void  *hwaccel_ctx;
 
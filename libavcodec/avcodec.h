@@ -2382,6 +2382,17 @@ typedef struct AVCodecContext {
      * - decoding: unused
      */
     int (*get_encode_buffer)(struct AVCodecContext *s, AVPacket *pkt, int flags);
+
+    /**
+     * Priority of the slice threading jobs of this context on the shared
+     * thread pool, see av_threadpool_init_shared(). Jobs of contexts with a
+     * higher value are served first. Ignored when the context has its own
+     * slice threads.
+     *
+     * - encoding: Set by user.
+     * - decoding: Set by user.
+     */
+    int thread_priority;
 } AVCodecContext;
 
 #if FF_API_CODEC_GET_SET
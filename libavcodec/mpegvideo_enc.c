@@ -1546,10 +1546,14 @@ static int select_input_picture(MpegEncContext *s)
 
     /* set next picture type & ordering */
     if (!s->reordered_input_picture[0] && s->input_picture[0]) {
-        if (s->frame_skip_threshold || s->frame_skip_factor) {
+        if (s->frame_skip_threshold || s->frame_skip_factor ||
+            s->frame_skip_duplicate) {
             if (s->picture_in_gop_number < s->gop_size &&
                 s->next_picture_ptr &&
-                skip_check(s, s->input_picture[0], s->next_picture_ptr)) {
+                ((s->frame_skip_duplicate &&
+                  s->input_picture[0]->f->flags & AV_FRAME_FLAG_DUPLICATE) ||
+                 ((s->frame_skip_threshold || s->frame_skip_factor) &&
+                  skip_check(s, s->input_picture[0], s->next_picture_ptr)))) {
                 // FIXME check that the gop check above is +-1 correct
                 av_frame_unref(s->input_picture[0]->f);
 
@@ -0,0 +1,35 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/aarch64/cpu.h"
+#include "libavfilter/drawutils.h"
+
+void ff_draw_blend_row_neon(uint8_t *dst, const uint8_t *mask, int w,
+                            unsigned src, unsigned alpha);
+void ff_draw_blend_layer_row_neon(uint8_t *dst, const uint8_t *val,
+                                  const uint8_t *trans, int w);
+
+av_cold void ff_draw_init_aarch64(FFDrawContext *draw)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (have_neon(cpu_flags)) {
+        draw->blend_row       = ff_draw_blend_row_neon;
+        draw->blend_layer_row = ff_draw_blend_layer_row_neon;
+    }
+}
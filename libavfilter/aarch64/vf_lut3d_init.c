@@ -0,0 +1,35 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/aarch64/cpu.h"
+#include "libavfilter/lut3d.h"
+
+void ff_lut3d_interp_trilinear_neon(float *const dst[3], const float *const src[3],
+                                    const float *lut, int lutsize, int width);
+void ff_lut3d_interp_tetrahedral_neon(float *const dst[3], const float *const src[3],
+                                      const float *lut, int lutsize, int width);
+
+av_cold void ff_lut3d_dsp_init_aarch64(LUT3DDSPContext *dsp)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (have_neon(cpu_flags)) {
+        dsp->interp_trilinear   = ff_lut3d_interp_trilinear_neon;
+        dsp->interp_tetrahedral = ff_lut3d_interp_tetrahedral_neon;
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/aarch64/cpu.h"
+#include "libavfilter/xfade.h"
+
+void ff_xfade_fade8_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                         ptrdiff_t width, float progress);
+void ff_xfade_fade16_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                          ptrdiff_t width, float progress);
+void ff_xfade_dissolve8_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                             const float *noise, ptrdiff_t width, float progress);
+void ff_xfade_dissolve16_neon(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                              const float *noise, ptrdiff_t width, float progress);
+
+av_cold void ff_xfade_init_aarch64(XFadeDSPContext *dsp, int depth)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (have_neon(cpu_flags)) {
+        dsp->fade     = depth <= 8 ? ff_xfade_fade8_neon     : ff_xfade_fade16_neon;
+        dsp->dissolve = depth <= 8 ? ff_xfade_dissolve8_neon : ff_xfade_dissolve16_neon;
+    }
+}
@@ -1126,6 +1126,9 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
         }
     }
 
+    if (!(link->dst->filter->flags_internal & FF_FILTER_FLAG_DUPLICATE_AWARE))
+        frame->flags &= ~AV_FRAME_FLAG_DUPLICATE;
+
     link->frame_blocked_in = link->frame_wanted_out = 0;
     link->frame_count_in++;
     filter_unblock(link->dst);
@@ -1142,6 +1145,40 @@ error:
     return AVERROR_PATCHWELCOME;
 }
 
+int ff_filter_frame_duplicate(AVFilterLink *link, const AVFrame *prev,
+                              const AVFrame *frame)
+{
+    AVFrame *out = av_frame_alloc();
+    int ret;
+
+    if (!out)
+        return AVERROR(ENOMEM);
+    if ((ret = av_frame_ref(out, prev)) < 0)
+        goto fail;
+
+    /* only the picture is shared with prev, e.g. fps removes the captions
+     * from the frames it repeats */
+    av_dict_free(&out->metadata);
+    while (out->nb_side_data)
+        av_frame_remove_side_data(out, out->side_data[0]->type);
+    if ((ret = av_frame_copy_props(out, frame)) < 0)
+        goto fail;
+
+    /* these describe the data of prev, as set by the filter */
+    out->sample_aspect_ratio = prev->sample_aspect_ratio;
+    out->color_primaries     = prev->color_primaries;
+    out->color_trc           = prev->color_trc;
+    out->colorspace          = prev->colorspace;
+    out->color_range         = prev->color_range;
+    out->chroma_location     = prev->chroma_location;
+    out->flags              |= AV_FRAME_FLAG_DUPLICATE;
+    return ff_filter_frame(link, out);
+
+fail:
+    av_frame_free(&out);
+    return ret;
+}
+
 static int samples_ready(AVFilterLink *link, unsigned min)
 {
     return ff_framequeue_queued_frames(&link->fifo) &&
@@ -906,6 +906,14 @@ typedef struct AVFilterGraph {
 
     char *aresample_swr_opts; ///< swr options to use for the auto-inserted aresample filters, Access ONLY through AVOptions
 
+    /**
+     * Priority of the slice threading jobs of this graph on the shared thread
+     * pool, see av_threadpool_init_shared(). Jobs of graphs with a higher
+     * value are served first. Ignored when the graph has its own threads.
+     * May be set by the caller before adding any filters to the graph.
+     */
+    int thread_priority;
+
     /**
      * Private fields
      *
@@ -345,6 +345,7 @@ AVFilter ff_vsink_buffer = {
     .activate      = activate,
     .inputs        = avfilter_vsink_buffer_inputs,
     .outputs       = NULL,
+    .flags_internal = FF_FILTER_FLAG_DUPLICATE_AWARE,
 };
 
 static const AVFilterPad avfilter_asink_abuffer_inputs[] = {
@@ -52,11 +52,27 @@ typedef struct Transform {
 
 #define MAX_R 64
 
+typedef struct DeshakeDSPContext {
+    /**
+     * Find the lowest and highest values of a block of 16 x h pixels.
+     * h must be at least 1.
+     */
+    void (*block_minmax)(const uint8_t *src, ptrdiff_t stride, int h,
+                         uint8_t *lowest, uint8_t *highest);
+} DeshakeDSPContext;
+
+void ff_deshake_dsp_init(DeshakeDSPContext *dsp);
+void ff_deshake_dsp_init_aarch64(DeshakeDSPContext *dsp);
+void ff_deshake_dsp_init_x86(DeshakeDSPContext *dsp);
+
 typedef struct DeshakeContext {
     const AVClass *class;
     int counts[2*MAX_R+1][2*MAX_R+1]; /// < Scratch buffer for motion search
     double *angles;            ///< Scratch buffer for block angles
     unsigned angles_size;
+    IntMotionVector *block_mvs; ///< Motion vector of each block, -1 if not found
+    unsigned block_mvs_size;
+    DeshakeDSPContext dsp;
     AVFrame *ref;              ///< Previous frame
     int rx;                    ///< Maximum horizontal shift
     int ry;                    ///< Maximum vertical shift
@@ -21,6 +21,8 @@
 
 #include <string.h>
 
+#include "config.h"
+
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
 #include "libavutil/colorspace.h"
@@ -32,6 +34,28 @@
 
 enum { RED = 0, GREEN, BLUE, ALPHA };
 
+static void blend_row_c(uint8_t *dst, const uint8_t *mask, int w,
+                        unsigned src, unsigned alpha)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        unsigned a = mask[x] * alpha;
+        dst[x] = ((0x1010101 - a) * dst[x] + a * src) >> 24;
+    }
+}
+
+static void blend_layer_row_c(uint8_t *dst, const uint8_t *val,
+                              const uint8_t *trans, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++) {
+        unsigned t = dst[x] * trans[x] + 128;
+        dst[x] = FFMIN(val[x] + ((t + (t >> 8)) >> 8), 255);
+    }
+}
+
 int ff_fill_rgba_map(uint8_t *rgba_map, enum AVPixelFormat pix_fmt)
 {
     switch (pix_fmt) {
@@ -131,6 +155,13 @@ int ff_draw_init(FFDrawContext *draw, enum AVPixelFormat format, unsigned flags)
     for (i = 0; i < (desc->nb_components - !!(desc->flags & AV_PIX_FMT_FLAG_ALPHA && !(flags & FF_DRAW_PROCESS_ALPHA))); i++)
         draw->comp_mask[desc->comp[i].plane] |=
             1 << desc->comp[i].offset;
+
+    draw->blend_row = blend_row_c;
+    draw->blend_layer_row = blend_layer_row_c;
+    if (ARCH_AARCH64)
+        ff_draw_init_aarch64(draw);
+    if (ARCH_X86)
+        ff_draw_init_x86(draw);
     return 0;
 }
 
@@ -582,7 +613,15 @@ void ff_blend_mask(FFDrawContext *draw, FFDrawColor *color,
                 p += dst_linesize[plane];
                 m += top * mask_linesize;
             }
-            if (depth <= 8) {
+            if (depth <= 8 && l2depth == 3 && draw->pixelstep[plane] == 1 &&
+                !draw->hsub[plane] && !draw->vsub[plane]) {
+                for (y = 0; y < h_sub; y++) {
+                    draw->blend_row(p, m + xm0, w_sub,
+                                    color->comp[plane].u8[comp], alpha);
+                    p += dst_linesize[plane];
+                    m += mask_linesize;
+                }
+            } else if (depth <= 8) {
                 for (y = 0; y < h_sub; y++) {
                     blend_line_hv(p, draw->pixelstep[plane],
                                   color->comp[plane].u8[comp], alpha,
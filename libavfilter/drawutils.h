@@ -44,6 +44,22 @@ typedef struct FFDrawContext {
     uint8_t vsub_max;
     int full_range;
     unsigned flags;
+
+    /**
+     * Blend w pixels of an 8-bit plane without subsampling with the color
+     * component src through an 8-bit mask, alpha being the color alpha
+     * scaled as in ff_blend_mask(). Does not access pixels past w.
+     */
+    void (*blend_row)(uint8_t *dst, const uint8_t *mask, int w,
+                      unsigned src, unsigned alpha);
+
+    /**
+     * Blend w bytes of a premultiplied layer over an 8-bit plane:
+     * dst = min(val + dst * trans / 255, 255), the division being rounded
+     * to nearest. Does not access bytes past w.
+     */
+    void (*blend_layer_row)(uint8_t *dst, const uint8_t *val,
+                            const uint8_t *trans, int w);
 } FFDrawContext;
 
 typedef struct FFDrawColor {
@@ -70,6 +86,9 @@ typedef struct FFDrawColor {
  */
 int ff_draw_init(FFDrawContext *draw, enum AVPixelFormat format, unsigned flags);
 
+void ff_draw_init_aarch64(FFDrawContext *draw);
+void ff_draw_init_x86(FFDrawContext *draw);
+
 /**
  * Prepare a color.
  */
@@ -0,0 +1,133 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+
+#include "framethread.h"
+#include "internal.h"
+
+int ff_framethread_init(FFFrameThreadContext *ft, AVFilterContext *ctx,
+                        int max_jobs, int nb_slices,
+                        int (*process)(AVFilterContext *ctx, FFFrameJob *job, int jobnr,
+                                       int slicenr, int nb_slices))
+{
+    ft->ctx       = ctx;
+    ft->process   = process;
+    ft->nb_jobs   = 0;
+    ft->max_jobs  = FFMAX(max_jobs, 1);
+    ft->nb_slices = FFMAX(nb_slices, 1);
+    ft->jobs      = av_calloc(ft->max_jobs, sizeof(*ft->jobs));
+    ft->rets      = av_calloc(ft->max_jobs, ft->nb_slices * sizeof(*ft->rets));
+    if (!ft->jobs || !ft->rets) {
+        ff_framethread_uninit(ft);
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static void job_unref(FFFrameJob *job)
+{
+    int i;
+
+    av_frame_free(&job->out);
+    for (i = 0; i < job->nb_in; i++)
+        av_frame_free(&job->in[i]);
+    job->nb_in = 0;
+    av_buffer_unref(&job->priv);
+}
+
+static int run_job(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    FFFrameThreadContext *ft = arg;
+    int slicenr = jobnr % ft->nb_slices;
+
+    jobnr /= ft->nb_slices;
+    return ft->process(ctx, &ft->jobs[jobnr], jobnr, slicenr, ft->nb_slices);
+}
+
+int ff_framethread_flush(FFFrameThreadContext *ft)
+{
+    AVFilterContext *ctx = ft->ctx;
+    int nb_jobs = ft->nb_jobs;
+    int i, j, ret = 0;
+
+    if (!nb_jobs)
+        return 0;
+    ft->nb_jobs = 0;
+
+    ctx->internal->execute(ctx, run_job, ft, ft->rets, nb_jobs * ft->nb_slices);
+
+    for (i = 0; i < nb_jobs * ft->nb_slices; i++)
+        if (ft->rets[i] < 0)
+            ret = ft->rets[i];
+
+    /* jobs are usually queued in pts order already */
+    for (i = 1; i < nb_jobs; i++) {
+        for (j = i; j > 0 && ft->jobs[j - 1].out->pts > ft->jobs[j].out->pts; j--)
+            FFSWAP(FFFrameJob, ft->jobs[j - 1], ft->jobs[j]);
+    }
+
+    for (i = 0; i < nb_jobs; i++) {
+        FFFrameJob *job = &ft->jobs[i];
+
+        if (ret >= 0) {
+            AVFrame *out = job->out;
+            job->out = NULL;
+            ret = ff_filter_frame(ctx->outputs[0], out);
+        }
+        job_unref(job);
+    }
+
+    return ret < 0 ? ret : nb_jobs;
+}
+
+int ff_framethread_add_job(FFFrameThreadContext *ft, AVFrame *out,
+                           AVFrame **in, int nb_in, AVBufferRef *priv)
+{
+    FFFrameJob *job = &ft->jobs[ft->nb_jobs];
+    int i;
+
+    av_assert0(nb_in <= FF_FRAMETHREAD_MAX_INPUTS);
+
+    job->out  = out;
+    job->priv = priv;
+    for (i = 0; i < nb_in; i++) {
+        if (!(job->in[job->nb_in++] = av_frame_clone(in[i]))) {
+            job_unref(job);
+            return AVERROR(ENOMEM);
+        }
+    }
+    ft->nb_jobs++;
+
+    if (ft->nb_jobs == ft->max_jobs)
+        return ff_framethread_flush(ft);
+    return 0;
+}
+
+void ff_framethread_uninit(FFFrameThreadContext *ft)
+{
+    int i;
+
+    for (i = 0; i < ft->nb_jobs; i++)
+        job_unref(&ft->jobs[i]);
+    ft->nb_jobs = 0;
+    av_freep(&ft->jobs);
+    av_freep(&ft->rets);
+}
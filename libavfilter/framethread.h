@@ -0,0 +1,115 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FRAMETHREAD_H
+#define AVFILTER_FRAMETHREAD_H
+
+/**
+ * @file
+ * Frame-parallel execution for filters with a bounded temporal window.
+ *
+ * A filter using this API splits its work into one job per output frame.
+ * A job holds references to the input frames it reads (its window) and to
+ * any per-window state the filter computed sequentially, so that it does not
+ * depend on the filter state anymore once queued. Queued jobs are processed
+ * concurrently on the filter graph threads once there are as many of them as
+ * threads, and the output frames are then sent in pts order. Each job can
+ * additionally be split into slices, so that fewer frames need to be in
+ * flight to keep all threads busy.
+ *
+ * The filter needs AVFILTER_FLAG_SLICE_THREADS for the jobs to actually run
+ * in parallel.
+ */
+
+#include "libavutil/buffer.h"
+#include "libavutil/frame.h"
+
+#include "avfilter.h"
+
+#define FF_FRAMETHREAD_MAX_INPUTS 4
+
+typedef struct FFFrameJob {
+    /**
+     * Frame to fill, with pts set. Owned by the job until it is sent.
+     */
+    AVFrame *out;
+
+    /**
+     * References to the input frames read by the job.
+     */
+    AVFrame *in[FF_FRAMETHREAD_MAX_INPUTS];
+    int nb_in;
+
+    /**
+     * Filter data for this job, may be shared between jobs.
+     */
+    AVBufferRef *priv;
+} FFFrameJob;
+
+typedef struct FFFrameThreadContext {
+    AVFilterContext *ctx;
+
+    /**
+     * Fill slice slicenr of job->out. jobnr is the index of the job in the
+     * current batch; it is below max_jobs and unique among the jobs running
+     * concurrently, so it can index per-job scratch buffers. The slices of a
+     * job may run concurrently.
+     */
+    int (*process)(AVFilterContext *ctx, FFFrameJob *job, int jobnr,
+                   int slicenr, int nb_slices);
+
+    FFFrameJob *jobs;
+    int *rets;
+    int nb_jobs;
+    int max_jobs;
+    int nb_slices;
+} FFFrameThreadContext;
+
+/**
+ * @param max_jobs  maximum number of jobs run concurrently
+ * @param nb_slices number of slices each job is split into
+ */
+int ff_framethread_init(FFFrameThreadContext *ft, AVFilterContext *ctx,
+                        int max_jobs, int nb_slices,
+                        int (*process)(AVFilterContext *ctx, FFFrameJob *job, int jobnr,
+                                       int slicenr, int nb_slices));
+
+/**
+ * Queue a job producing out from the given input frames. New references to
+ * the inputs are taken; ownership of out and priv is transferred to the job
+ * even on failure. The queued jobs are run when the queue is full.
+ *
+ * @return >= 0 on success, a negative AVERROR code from running the jobs or
+ *         sending their output otherwise
+ */
+int ff_framethread_add_job(FFFrameThreadContext *ft, AVFrame *out,
+                           AVFrame **in, int nb_in, AVBufferRef *priv);
+
+/**
+ * Run all queued jobs and send their output on the first output link.
+ *
+ * @return number of frames sent or a negative AVERROR code
+ */
+int ff_framethread_flush(FFFrameThreadContext *ft);
+
+/**
+ * Drop the queued jobs and free the context.
+ */
+void ff_framethread_uninit(FFFrameThreadContext *ft);
+
+#endif /* AVFILTER_FRAMETHREAD_H */
@@ -315,6 +315,18 @@ int ff_request_frame(AVFilterLink *link);
  */
 int ff_filter_frame(AVFilterLink *link, AVFrame *frame);
 
+/**
+ * Send a new reference to the data of prev, the previous frame sent on link,
+ * with the properties, side data and metadata of frame and marked with
+ * AV_FRAME_FLAG_DUPLICATE. The aspect ratio and color properties are kept
+ * from prev. For filters producing the same output for a frame marked as
+ * duplicate of the previous one.
+ *
+ * @return >= 0 on success, a negative AVERROR on error
+ */
+int ff_filter_frame_duplicate(AVFilterLink *link, const AVFrame *prev,
+                              const AVFrame *frame);
+
 /**
  * Allocate a new filter context and return it.
  *
@@ -338,6 +350,14 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter handles AV_FRAME_FLAG_DUPLICATE on its input frames. The flag
+ * is cleared on the frames sent to other filters, since they may not produce
+ * the same output for the same input, or may propagate the flag to different
+ * output frames.
+ */
+#define FF_FILTER_FLAG_DUPLICATE_AWARE (1 << 1)
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -0,0 +1,46 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_LUT3D_H
+#define AVFILTER_LUT3D_H
+
+/**
+ * Row functions of the lut3d and haldclut filters.
+ *
+ * src holds the r, g and b coordinates of width points, already scaled to
+ * [0, lutsize - 1]; the interpolated r, g and b values are written to dst.
+ * lut holds lutsize^3 r, g, b triplets, with r varying the slowest.
+ *
+ * The SIMD versions may process up to 15 points past width, so all six rows
+ * must be padded and the padding coordinates must be within range too.
+ * They use fused multiply-adds and may not sum the terms in the same order
+ * as the C code, so their output may differ from it by a few ULP, which can
+ * change integer output by one LSB.
+ */
+typedef struct LUT3DDSPContext {
+    void (*interp_trilinear)(float *const dst[3], const float *const src[3],
+                             const float *lut, int lutsize, int width);
+    void (*interp_tetrahedral)(float *const dst[3], const float *const src[3],
+                               const float *lut, int lutsize, int width);
+} LUT3DDSPContext;
+
+void ff_lut3d_dsp_init(LUT3DDSPContext *dsp);
+void ff_lut3d_dsp_init_aarch64(LUT3DDSPContext *dsp);
+void ff_lut3d_dsp_init_x86(LUT3DDSPContext *dsp);
+
+#endif /* AVFILTER_LUT3D_H */
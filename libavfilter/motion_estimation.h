@@ -22,6 +22,7 @@
 #define AVFILTER_MOTION_ESTIMATION_H
 
 #include "libavutil/avutil.h"
+#include "libavutil/pixelutils.h"
 
 #define AV_ME_METHOD_ESA        1
 #define AV_ME_METHOD_TSS        2
@@ -57,10 +58,22 @@ typedef struct AVMotionEstContext {
     int pred_y;     ///< median predictor y
     AVMotionEstPredictor preds[2];
 
+    av_pixelutils_sad_fn sad[6];    ///< SAD of 2^n x 2^n blocks, NULL if unavailable
+
     uint64_t (*get_cost)(struct AVMotionEstContext *me_ctx, int x_mb, int y_mb,
                          int mv_x, int mv_y);
 } AVMotionEstContext;
 
+/**
+ * @return the SAD function for size x size blocks, NULL if unavailable
+ */
+static inline av_pixelutils_sad_fn ff_me_get_sad_fn(const AVMotionEstContext *me_ctx, int size)
+{
+    int n = av_log2(size);
+
+    return size == 1 << n && n < FF_ARRAY_ELEMS(me_ctx->sad) ? me_ctx->sad[n] : NULL;
+}
+
 void ff_me_init_context(AVMotionEstContext *me_ctx, int mb_size, int search_param,
                         int width, int height, int x_min, int x_max, int y_min, int y_max);
 
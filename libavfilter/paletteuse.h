@@ -0,0 +1,49 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_PALETTEUSE_H
+#define AVFILTER_PALETTEUSE_H
+
+#include <stdint.h>
+
+#include "libavutil/pixfmt.h"
+
+/**
+ * Padding value of the unused palette entries, farther from any color than
+ * all valid entries.
+ */
+#define PALETTEUSE_PAD_COLOR 1024
+
+typedef struct PaletteUseDSPContext {
+    /**
+     * Return the index of the palette entry nearest to the color (r, g, b),
+     * the lowest one on ties.
+     *
+     * @param pal the r, g and b components of the palette entries, in three
+     *            rows of AVPALETTE_COUNT elements
+     * @param nb  number of entries to search, a multiple of 16; unused
+     *            entries must be set to PALETTEUSE_PAD_COLOR
+     */
+    int (*nearest)(const int32_t *pal, int nb, int r, int g, int b);
+} PaletteUseDSPContext;
+
+void ff_paletteuse_dsp_init(PaletteUseDSPContext *dsp);
+void ff_paletteuse_dsp_init_aarch64(PaletteUseDSPContext *dsp);
+void ff_paletteuse_dsp_init_x86(PaletteUseDSPContext *dsp);
+
+#endif /* AVFILTER_PALETTEUSE_H */
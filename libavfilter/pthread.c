@@ -83,6 +83,7 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
 
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
+    ThreadContext *c;
     int ret;
 
     if (graph->nb_threads == 1) {
@@ -102,6 +103,8 @@ int ff_graph_thread_init(AVFilterGraph *graph)
         return (ret < 0) ? ret : 0;
     }
     graph->nb_threads = ret;
+    c = graph->internal->thread;
+    avpriv_slicethread_set_priority(c->thread, graph->thread_priority);
 
     graph->internal->thread_execute = thread_execute;
 
@@ -0,0 +1,41 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_THUMBNAIL_H
+#define AVFILTER_THUMBNAIL_H
+
+#include <stdint.h>
+
+typedef struct ThumbnailDSPContext {
+    /**
+     * Count the bytes of a row in four interleaved histograms of 256 bins:
+     * src[i] is counted in hist[(i & 3) * 256 + src[i]]. Consecutive bytes
+     * thus never increment the same counter, and the four histograms hold
+     * the four components of packed 32-bit pixels.
+     *
+     * @return the number of bytes processed, a multiple of 4; the caller
+     *         counts the remaining ones
+     */
+    int (*histogram_row)(int *hist, const uint8_t *src, int len);
+} ThumbnailDSPContext;
+
+void ff_thumbnail_dsp_init(ThumbnailDSPContext *dsp);
+void ff_thumbnail_dsp_init_aarch64(ThumbnailDSPContext *dsp);
+void ff_thumbnail_dsp_init_x86(ThumbnailDSPContext *dsp);
+
+#endif /* AVFILTER_THUMBNAIL_H */
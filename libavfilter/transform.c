@@ -148,6 +148,16 @@ int avfilter_transform(const uint8_t *src, uint8_t *dst,
                         int width, int height, const float *matrix,
                         enum InterpolateMethod interpolate,
                         enum FillMethod fill)
+{
+    return ff_transform_slice(src, dst, src_stride, dst_stride, width, height,
+                              0, height, matrix, interpolate, fill);
+}
+
+int ff_transform_slice(const uint8_t *src, uint8_t *dst,
+                       int src_stride, int dst_stride,
+                       int width, int height, int slice_start, int slice_end,
+                       const float *matrix, enum InterpolateMethod interpolate,
+                       enum FillMethod fill)
 {
     int x, y;
     float x_s, y_s;
@@ -168,7 +178,7 @@ int avfilter_transform(const uint8_t *src, uint8_t *dst,
             return AVERROR(EINVAL);
     }
 
-    for (y = 0; y < height; y++) {
+    for (y = slice_start; y < slice_end; y++) {
         for(x = 0; x < width; x++) {
             x_s = x * matrix[0] + y * matrix[1] + matrix[2];
             y_s = x * matrix[3] + y * matrix[4] + matrix[5];
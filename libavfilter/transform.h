@@ -132,4 +132,14 @@ int avfilter_transform(const uint8_t *src, uint8_t *dst,
                         enum InterpolateMethod interpolate,
                         enum FillMethod fill);
 
+/**
+ * Same as avfilter_transform(), but only output the lines slice_start to
+ * slice_end - 1 of dst. The whole source image may be read.
+ */
+int ff_transform_slice(const uint8_t *src, uint8_t *dst,
+                       int src_stride, int dst_stride,
+                       int width, int height, int slice_start, int slice_end,
+                       const float *matrix, enum InterpolateMethod interpolate,
+                       enum FillMethod fill);
+
 #endif /* AVFILTER_TRANSFORM_H */
@@ -67,6 +67,11 @@ typedef struct TrimContext {
 
     int64_t next_pts;
 
+    /*
+     * whether a frame was dropped right before the next output frame
+     */
+    int dropped;
+
     int eof;
 } TrimContext;
 
@@ -168,10 +173,15 @@ static int trim_filter_frame(AVFilterLink *inlink, AVFrame *frame)
 
     s->nb_frames++;
 
+    if (s->dropped)
+        frame->flags &= ~AV_FRAME_FLAG_DUPLICATE;
+    s->dropped = 0;
+
     return ff_filter_frame(ctx->outputs[0], frame);
 
 drop:
     s->nb_frames++;
+    s->dropped = 1;
     av_frame_free(&frame);
     return 0;
 }
@@ -215,6 +225,7 @@ AVFilter ff_vf_trim = {
     .priv_class  = &trim_class,
     .inputs      = trim_inputs,
     .outputs     = trim_outputs,
+    .flags_internal = FF_FILTER_FLAG_DUPLICATE_AWARE,
 };
 #endif // CONFIG_TRIM_FILTER
 
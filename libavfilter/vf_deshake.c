@@ -88,6 +88,20 @@ static const AVOption deshake_options[] = {
 
 AVFILTER_DEFINE_CLASS(deshake);
 
+typedef struct MotionThreadData {
+    const uint8_t *src1, *src2;
+    int stride;
+    int nb_block_cols, nb_block_rows;
+} MotionThreadData;
+
+typedef struct TransformThreadData {
+    AVFrame *in, *out;
+    const float *matrix[3];
+    int plane_w[3], plane_h[3];
+    enum InterpolateMethod interpolate;
+    enum FillMethod fill;
+} TransformThreadData;
+
 static int cmp(const void *a, const void *b)
 {
     return FFDIFFSIGN(*(const double *)a, *(const double *)b);
@@ -117,8 +131,8 @@ static double clean_mean(double *values, int count)
  * and ry attributes. Searches using a simple matrix of those shifts and
  * chooses the most likely shift by the smallest difference in blocks.
  */
-static void find_block_motion(DeshakeContext *deshake, uint8_t *src1,
-                              uint8_t *src2, int cx, int cy, int stride,
+static void find_block_motion(const DeshakeContext *deshake, const uint8_t *src1,
+                              const uint8_t *src2, int cx, int cy, int stride,
                               IntMotionVector *mv)
 {
     int x, y;
@@ -187,7 +201,8 @@ static void find_block_motion(DeshakeContext *deshake, uint8_t *src1,
  * really only care about the high contrast blocks, so using this method we
  * can actually skip blocks we don't care much about.
  */
-static int block_contrast(uint8_t *src, int x, int y, int stride, int blocksize)
+static int block_contrast(const DeshakeContext *deshake, const uint8_t *src,
+                          int x, int y, int stride, int blocksize)
 {
     int highest = 0;
     int lowest = 255;
@@ -203,11 +218,51 @@ static int block_contrast(uint8_t *src, int x, int y, int stride, int blocksize)
                 highest = src[pos];
             }
         }
+
+        // A pixel lowering the lowest value is not compared to the highest
+        // one, which only matters as long as every pixel lowered it. Past
+        // that, the rest of the block just extends the range.
+        if (highest >= lowest && i < blocksize * 2) {
+            uint8_t lo, hi;
+
+            deshake->dsp.block_minmax(src + (y + i + 1) * stride + x, stride,
+                                      blocksize * 2 - i, &lo, &hi);
+            lowest  = FFMIN(lowest,  lo);
+            highest = FFMAX(highest, hi);
+            break;
+        }
     }
 
     return highest - lowest;
 }
 
+static void block_minmax_c(const uint8_t *src, ptrdiff_t stride, int h,
+                           uint8_t *lowest, uint8_t *highest)
+{
+    int lo = 255, hi = 0;
+    int x, y;
+
+    for (y = 0; y < h; y++) {
+        for (x = 0; x < 16; x++) {
+            lo = FFMIN(lo, src[x]);
+            hi = FFMAX(hi, src[x]);
+        }
+        src += stride;
+    }
+    *lowest  = lo;
+    *highest = hi;
+}
+
+av_cold void ff_deshake_dsp_init(DeshakeDSPContext *dsp)
+{
+    dsp->block_minmax = block_minmax_c;
+
+    if (ARCH_AARCH64)
+        ff_deshake_dsp_init_aarch64(dsp);
+    if (ARCH_X86)
+        ff_deshake_dsp_init_x86(dsp);
+}
+
 /**
  * Find the rotation for a given block.
  */
@@ -225,6 +280,39 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
            diff;
 }
 
+/**
+ * Find the most likely shift of the blocks of a range of block rows.
+ */
+static int find_motion_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const DeshakeContext *deshake = ctx->priv;
+    const MotionThreadData *td = arg;
+    const int row_start = (td->nb_block_rows *  jobnr   ) / nb_jobs;
+    const int row_end   = (td->nb_block_rows * (jobnr+1)) / nb_jobs;
+    IntMotionVector mv = {0, 0};
+    int i, j;
+
+    for (j = row_start; j < row_end; j++) {
+        const int y = deshake->ry + j * deshake->blocksize * 2;
+        IntMotionVector *mvs = deshake->block_mvs + j * td->nb_block_cols;
+
+        for (i = 0; i < td->nb_block_cols; i++) {
+            const int x = deshake->rx + i * 16;
+
+            // If the contrast is too low, just skip this block as it probably
+            // won't be very useful to us.
+            if (block_contrast(deshake, td->src2, x, y, td->stride,
+                               deshake->blocksize) > deshake->contrast) {
+                find_block_motion(deshake, td->src1, td->src2, x, y, td->stride, &mv);
+                mvs[i] = mv;
+            } else {
+                mvs[i].x = mvs[i].y = -1;
+            }
+        }
+    }
+    return 0;
+}
+
 /**
  * Find the estimated global motion for a scene given the most likely shift
  * for each block in the frame. The global motion is estimated to be the
@@ -232,19 +320,37 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
  * move one pixel to the right and two pixels down, this would yield a
  * motion vector (1, -2).
  */
-static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
-                        int width, int height, int stride, Transform *t)
+static int find_motion(AVFilterContext *ctx, const uint8_t *src1, const uint8_t *src2,
+                       int width, int height, int stride, Transform *t)
 {
-    int x, y;
-    IntMotionVector mv = {0, 0};
+    DeshakeContext *deshake = ctx->priv;
+    const int step = deshake->blocksize * 2;
+    MotionThreadData td;
+    int x, y, i, j, nb_jobs;
     int count_max_value = 0;
-    int contrast;
 
     int pos;
     int center_x = 0, center_y = 0;
     double p_x, p_y;
 
-    av_fast_malloc(&deshake->angles, &deshake->angles_size, width * height / (16 * deshake->blocksize) * sizeof(*deshake->angles));
+    // We use a width of 16 here to match the sad function
+    td.nb_block_cols = FFMAX(width  - deshake->rx * 2 - 16   + 15       , 0) / 16;
+    td.nb_block_rows = FFMAX(height - deshake->ry * 2 - step + step - 1, 0) / step;
+    td.src1   = src1;
+    td.src2   = src2;
+    td.stride = stride;
+
+    // A frame too small for the search area has no blocks and no motion
+    if (!td.nb_block_cols || !td.nb_block_rows)
+        td.nb_block_cols = td.nb_block_rows = 0;
+
+    if (td.nb_block_rows) {
+        av_fast_malloc(&deshake->angles, &deshake->angles_size, width * height / (16 * deshake->blocksize) * sizeof(*deshake->angles));
+        av_fast_malloc(&deshake->block_mvs, &deshake->block_mvs_size,
+                       td.nb_block_cols * td.nb_block_rows * sizeof(*deshake->block_mvs));
+        if (!deshake->angles || !deshake->block_mvs)
+            return AVERROR(ENOMEM);
+    }
 
     // Reset counts to zero
     for (x = 0; x < deshake->rx * 2 + 1; x++) {
@@ -253,25 +359,32 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
         }
     }
 
+    // Find motion for every block, in parallel over the block rows. The less
+    // exhaustive search starts from the vector of the previous block when
+    // it has no coarse step, so it has to run in order then.
+    nb_jobs = FFMIN(td.nb_block_rows, ff_filter_get_nb_threads(ctx));
+    if (deshake->search == SMART_EXHAUSTIVE && (!deshake->rx || !deshake->ry))
+        nb_jobs = FFMIN(nb_jobs, 1);
+    if (nb_jobs > 0)
+        ctx->internal->execute(ctx, find_motion_slice, &td, NULL, nb_jobs);
+
     pos = 0;
-    // Find motion for every block and store the motion vector in the counts
-    for (y = deshake->ry; y < height - deshake->ry - (deshake->blocksize * 2); y += deshake->blocksize * 2) {
-        // We use a width of 16 here to match the sad function
-        for (x = deshake->rx; x < width - deshake->rx - 16; x += 16) {
-            // If the contrast is too low, just skip this block as it probably
-            // won't be very useful to us.
-            contrast = block_contrast(src2, x, y, stride, deshake->blocksize);
-            if (contrast > deshake->contrast) {
-                //av_log(NULL, AV_LOG_ERROR, "%d\n", contrast);
-                find_block_motion(deshake, src1, src2, x, y, stride, &mv);
-                if (mv.x != -1 && mv.y != -1) {
-                    deshake->counts[mv.x + deshake->rx][mv.y + deshake->ry] += 1;
-                    if (x > deshake->rx && y > deshake->ry)
-                        deshake->angles[pos++] = block_angle(x, y, 0, 0, &mv);
-
-                    center_x += mv.x;
-                    center_y += mv.y;
-                }
+    // Store the motion vector of every block in the counts
+    for (j = 0; j < td.nb_block_rows; j++) {
+        for (i = 0; i < td.nb_block_cols; i++) {
+            IntMotionVector *mv = &deshake->block_mvs[j * td.nb_block_cols + i];
+
+            x = deshake->rx + i * 16;
+            y = deshake->ry + j * step;
+            if (mv->x != -1 && mv->y != -1) {
+                // The less exhaustive search can go one step past the range
+                if (FFABS(mv->x) <= deshake->rx && FFABS(mv->y) <= deshake->ry)
+                    deshake->counts[mv->x + deshake->rx][mv->y + deshake->ry] += 1;
+                if (x > deshake->rx && y > deshake->ry)
+                    deshake->angles[pos++] = block_angle(x, y, 0, 0, mv);
+
+                center_x += mv->x;
+                center_y += mv->y;
             }
         }
     }
@@ -310,6 +423,24 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
     t->angle = av_clipf(t->angle, -0.1, 0.1);
 
     //av_log(NULL, AV_LOG_ERROR, "%d x %d\n", avg->x, avg->y);
+    return 0;
+}
+
+static int transform_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const TransformThreadData *td = arg;
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        const int h = td->plane_h[i];
+
+        // Transform the luma and chroma planes
+        ff_transform_slice(td->in->data[i], td->out->data[i],
+                           td->in->linesize[i], td->out->linesize[i],
+                           td->plane_w[i], h, (h * jobnr) / nb_jobs, (h * (jobnr+1)) / nb_jobs,
+                           td->matrix[i], td->interpolate, td->fill);
+    }
+    return 0;
 }
 
 static int deshake_transform_c(AVFilterContext *ctx,
@@ -318,24 +449,25 @@ static int deshake_transform_c(AVFilterContext *ctx,
                                     enum InterpolateMethod interpolate,
                                     enum FillMethod fill, AVFrame *in, AVFrame *out)
 {
-    int i = 0, ret = 0;
-    const float *matrixs[3];
-    int plane_w[3], plane_h[3];
-    matrixs[0] = matrix_y;
-    matrixs[1] =  matrixs[2] = matrix_uv;
-    plane_w[0] = width;
-    plane_w[1] = plane_w[2] = cw;
-    plane_h[0] = height;
-    plane_h[1] = plane_h[2] = ch;
+    TransformThreadData td;
 
-    for (i = 0; i < 3; i++) {
-        // Transform the luma and chroma planes
-        ret = avfilter_transform(in->data[i], out->data[i], in->linesize[i], out->linesize[i],
-                                 plane_w[i], plane_h[i], matrixs[i], interpolate, fill);
-        if (ret < 0)
-            return ret;
-    }
-    return ret;
+    if ((unsigned)interpolate >= INTERPOLATE_COUNT)
+        return AVERROR(EINVAL);
+
+    td.in          = in;
+    td.out         = out;
+    td.matrix[0]   = matrix_y;
+    td.matrix[1]   = td.matrix[2] = matrix_uv;
+    td.plane_w[0]  = width;
+    td.plane_w[1]  = td.plane_w[2] = cw;
+    td.plane_h[0]  = height;
+    td.plane_h[1]  = td.plane_h[2] = ch;
+    td.interpolate = interpolate;
+    td.fill        = fill;
+
+    ctx->internal->execute(ctx, transform_slice, &td, NULL,
+                           FFMIN(ch, ff_filter_get_nb_threads(ctx)));
+    return 0;
 }
 
 static av_cold int init(AVFilterContext *ctx)
@@ -363,6 +495,7 @@ static av_cold int init(AVFilterContext *ctx)
         deshake->cx &= ~15;
     }
     deshake->transform = deshake_transform_c;
+    ff_deshake_dsp_init(&deshake->dsp);
 
     av_log(ctx, AV_LOG_VERBOSE, "cx: %d, cy: %d, cw: %d, ch: %d, rx: %d, ry: %d, edge: %d blocksize: %d contrast: %d search: %d\n",
            deshake->cx, deshake->cy, deshake->cw, deshake->ch,
@@ -403,6 +536,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&deshake->ref);
     av_freep(&deshake->angles);
     deshake->angles_size = 0;
+    av_freep(&deshake->block_mvs);
+    deshake->block_mvs_size = 0;
     if (deshake->fp)
         fclose(deshake->fp);
 }
@@ -437,7 +572,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
 
     if (deshake->cx < 0 || deshake->cy < 0 || deshake->cw < 0 || deshake->ch < 0) {
         // Find the most likely global motion for the current frame
-        find_motion(deshake, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
+        ret = find_motion(link->dst, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
     } else {
         uint8_t *src1 = (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0];
         uint8_t *src2 = in->data[0];
@@ -454,7 +589,11 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         src1 += deshake->cy * in->linesize[0] + deshake->cx;
         src2 += deshake->cy * in->linesize[0] + deshake->cx;
 
-        find_motion(deshake, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
+        ret = find_motion(link->dst, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
+    }
+    if (ret < 0) {
+        av_frame_free(&in);
+        goto fail;
     }
 
 
@@ -560,4 +699,5 @@ AVFilter ff_vf_deshake = {
     .inputs        = deshake_inputs,
     .outputs       = deshake_outputs,
     .priv_class    = &deshake_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
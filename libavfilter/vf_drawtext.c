@@ -184,6 +184,17 @@ typedef struct DrawTextContext {
     FT_Face face;                   ///< freetype font face handle
     FT_Stroker stroker;             ///< freetype stroker handle
     struct AVTreeNode *glyphs;      ///< rendered glyphs, stored using the UTF-32 char code
+    struct Glyph *ascii_glyphs[128];///< rendered glyphs of the ASCII chars, for ascii_fontsize
+    unsigned int ascii_fontsize;    ///< font size of the glyphs in ascii_glyphs
+    AVBPrint layout_text;           ///< expanded text the layout was computed for
+    unsigned int layout_fontsize;   ///< font size the layout was computed for
+    int layout_valid;               ///< tells if the layout can be reused
+    struct Glyph **layout_glyphs;   ///< glyph drawn for each element in the text, or NULL
+    int nb_layout_glyphs;           ///< number of elements in the laid out text
+    int text_w, text_h;             ///< size of the laid out text
+    int glyph_ascent;               ///< max glyph ascent of the laid out text
+    int glyph_descent;              ///< min glyph descent of the laid out text
+    int text_top, text_bottom;      ///< rows covered by the glyph bitmaps, relative to y
     char *x_expr;                   ///< expression for x position
     char *y_expr;                   ///< expression for y position
     AVExpr *x_pexpr, *y_pexpr;      ///< parsed expressions for x and y
@@ -310,6 +321,30 @@ static int glyph_cmp(const void *key, const void *b)
          return FFDIFFSIGN((int64_t)a->fontsize, (int64_t)bb->fontsize);
 }
 
+/**
+ * Find the glyph of the UTF-32 codepoint code at the current font size
+ * among the loaded glyphs, or return NULL.
+ */
+static Glyph *find_glyph(DrawTextContext *s, uint32_t code)
+{
+    Glyph dummy = { 0 };
+    Glyph *glyph;
+
+    if (s->ascii_fontsize != s->fontsize) {
+        memset(s->ascii_glyphs, 0, sizeof(s->ascii_glyphs));
+        s->ascii_fontsize = s->fontsize;
+    }
+    if (code < FF_ARRAY_ELEMS(s->ascii_glyphs) && s->ascii_glyphs[code])
+        return s->ascii_glyphs[code];
+
+    dummy.code     = code;
+    dummy.fontsize = s->fontsize;
+    glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+    if (glyph && code < FF_ARRAY_ELEMS(s->ascii_glyphs))
+        s->ascii_glyphs[code] = glyph;
+    return glyph;
+}
+
 /**
  * Load glyphs corresponding to the UTF-32 codepoint code.
  */
@@ -782,6 +817,7 @@ static av_cold int init(AVFilterContext *ctx)
 
     av_bprint_init(&s->expanded_text, 0, AV_BPRINT_SIZE_UNLIMITED);
     av_bprint_init(&s->expanded_fontcolor, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&s->layout_text, 0, AV_BPRINT_SIZE_UNLIMITED);
 
     return 0;
 }
@@ -813,6 +849,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     s->x_pexpr = s->y_pexpr = s->a_pexpr = s->fontsize_pexpr = NULL;
 
     av_freep(&s->positions);
+    av_freep(&s->layout_glyphs);
     s->nb_positions = 0;
 
     av_tree_enumerate(s->glyphs, NULL, NULL, glyph_enu_free);
@@ -825,6 +862,7 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     av_bprint_finalize(&s->expanded_text, NULL);
     av_bprint_finalize(&s->expanded_fontcolor, NULL);
+    av_bprint_finalize(&s->layout_text, NULL);
 }
 
 static int config_input(AVFilterLink *inlink)
@@ -1215,52 +1253,214 @@ static int expand_text(AVFilterContext *ctx, char *text, AVBPrint *bp)
     return 0;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
-                       int width, int height,
-                       FFDrawColor *color,
-                       int x, int y, int borderw)
+/**
+ * Load the glyphs of the expanded text and compute their positions, unless
+ * the text and the font size did not change since the last call.
+ */
+static int layout_text(AVFilterContext *ctx)
 {
+    DrawTextContext *s = ctx->priv;
     char *text = s->expanded_text.str;
-    uint32_t code = 0;
-    int i, x1, y1;
+    unsigned len = s->expanded_text.len;
+    uint32_t code = 0, prev_code = 0;
+    int x = 0, y = 0, i, ret;
+    int max_text_line_w = 0;
+    int y_min = 32000, y_max = -32000;
+    int x_min = 32000, x_max = -32000;
+    int top = INT_MAX, bottom = INT_MIN;
+    FT_Vector delta;
+    Glyph *glyph = NULL, *prev_glyph = NULL;
     uint8_t *p;
-    Glyph *glyph = NULL;
 
+    if (s->layout_valid && s->layout_fontsize == s->fontsize &&
+        s->layout_text.len == len && !memcmp(s->layout_text.str, text, len))
+        return 0;
+    s->layout_valid = 0;
+
+    if (len > s->nb_positions) {
+        if (!(s->positions =
+              av_realloc(s->positions, len*sizeof(*s->positions))))
+            return AVERROR(ENOMEM);
+        if (!(s->layout_glyphs =
+              av_realloc(s->layout_glyphs, len*sizeof(*s->layout_glyphs))))
+            return AVERROR(ENOMEM);
+        s->nb_positions = len;
+    }
+
+    /* load and cache glyphs */
     for (i = 0, p = text; *p; i++) {
-        FT_Bitmap bitmap;
-        Glyph dummy = { 0 };
         GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
 continue_on_invalid:
 
-        /* skip new line chars, just go to new line */
-        if (code == '\n' || code == '\r' || code == '\t')
+        /* get glyph */
+        glyph = find_glyph(s, code);
+        if (!glyph) {
+            ret = load_glyph(ctx, &glyph, code);
+            if (ret < 0)
+                return ret;
+        }
+
+        y_min = FFMIN(glyph->bbox.yMin, y_min);
+        y_max = FFMAX(glyph->bbox.yMax, y_max);
+        x_min = FFMIN(glyph->bbox.xMin, x_min);
+        x_max = FFMAX(glyph->bbox.xMax, x_max);
+    }
+    s->max_glyph_h = y_max - y_min;
+    s->max_glyph_w = x_max - x_min;
+
+    /* compute and save position for each glyph */
+    glyph = NULL;
+    for (i = 0, p = text; *p; i++) {
+        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid2;);
+continue_on_invalid2:
+
+        s->layout_glyphs[i] = NULL;
+
+        /* skip the \n in the sequence \r\n */
+        if (prev_code == '\r' && code == '\n')
             continue;
 
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
+        prev_code = code;
+        if (is_newline(code)) {
 
-        bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
+            max_text_line_w = FFMAX(max_text_line_w, x);
+            y += s->max_glyph_h + s->line_spacing;
+            x = 0;
+            continue;
+        }
+
+        /* get glyph */
+        prev_glyph = glyph;
+        glyph = find_glyph(s, code);
+
+        /* kerning */
+        if (s->use_kerning && prev_glyph && glyph->code) {
+            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
+                           ft_kerning_default, &delta);
+            x += delta.x >> 6;
+        }
+
+        /* save position */
+        s->positions[i].x = x + glyph->bitmap_left;
+        s->positions[i].y = y - glyph->bitmap_top + y_max;
+        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
+        else              x += glyph->advance;
+
+        /* tabs are only drawn as space */
+        if (code == '\t')
+            continue;
 
         if (glyph->bitmap.pixel_mode != FT_PIXEL_MODE_MONO &&
             glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY)
             return AVERROR(EINVAL);
 
+        s->layout_glyphs[i] = glyph;
+        top    = FFMIN(top,    s->positions[i].y);
+        bottom = FFMAX(bottom, s->positions[i].y + (int)glyph->bitmap.rows);
+        if (s->borderw) {
+            top    = FFMIN(top,    s->positions[i].y - s->borderw);
+            bottom = FFMAX(bottom, s->positions[i].y - s->borderw +
+                                   (int)glyph->border_bitmap.rows);
+        }
+    }
+    s->nb_layout_glyphs = i;
+
+    s->text_w        = FFMAX(x, max_text_line_w);
+    s->text_h        = y + s->max_glyph_h;
+    s->glyph_ascent  = y_max;
+    s->glyph_descent = y_min;
+    s->text_top      = top;
+    s->text_bottom   = bottom;
+
+    av_bprint_clear(&s->layout_text);
+    av_bprint_append_data(&s->layout_text, text, len);
+    if (!av_bprint_is_complete(&s->layout_text))
+        return AVERROR(ENOMEM);
+    s->layout_fontsize = s->fontsize;
+    s->layout_valid    = 1;
+
+    return 0;
+}
+
+static void draw_glyphs(DrawTextContext *s, uint8_t *data[4], int *linesize,
+                        int width, int height,
+                        FFDrawColor *color,
+                        int x, int y, int borderw)
+{
+    int i, x1, y1;
+
+    for (i = 0; i < s->nb_layout_glyphs; i++) {
+        const Glyph *glyph = s->layout_glyphs[i];
+        FT_Bitmap bitmap;
+
+        if (!glyph)
+            continue;
+
+        bitmap = borderw ? glyph->border_bitmap : glyph->bitmap;
+
         x1 = s->positions[i].x+s->x+x - borderw;
         y1 = s->positions[i].y+s->y+y - borderw;
 
         ff_blend_mask(&s->dc, color,
-                      frame->data, frame->linesize, width, height,
+                      data, linesize, width, height,
                       bitmap.buffer, bitmap.pitch,
                       bitmap.width, bitmap.rows,
                       bitmap.pixel_mode == FT_PIXEL_MODE_MONO ? 0 : 3,
                       0, x1, y1);
     }
+}
+
+typedef struct ThreadData {
+    AVFrame *frame;
+    int width, height;
+    int start, end;                 ///< rows touched by the text, start being aligned
+    int box_w, box_h;
+    FFDrawColor fontcolor;
+    FFDrawColor shadowcolor;
+    FFDrawColor bordercolor;
+    FFDrawColor boxcolor;
+} ThreadData;
+
+/**
+ * Draw the part of the text within a band of rows. The bands are aligned
+ * on the chroma subsampling so that the blending does not depend on them.
+ */
+static int draw_text_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    const int vsub = s->dc.vsub_max;
+    const int nb_units = (td->end - td->start + (1 << vsub) - 1) >> vsub;
+    const int start = td->start + ((nb_units *  jobnr      / nb_jobs) << vsub);
+    const int end   = FFMIN(td->start + ((nb_units * (jobnr + 1) / nb_jobs) << vsub),
+                            td->height);
+    uint8_t *data[4] = { NULL };
+    int i;
+
+    for (i = 0; i < s->dc.nb_planes; i++)
+        data[i] = frame->data[i] + (start >> s->dc.vsub[i]) * frame->linesize[i];
+
+    if (s->draw_box)
+        ff_blend_rectangle(&s->dc, &td->boxcolor,
+                           data, frame->linesize, td->width, end - start,
+                           s->x - s->boxborderw, s->y - s->boxborderw - start,
+                           td->box_w + s->boxborderw * 2, td->box_h + s->boxborderw * 2);
+
+    if (s->shadowx || s->shadowy)
+        draw_glyphs(s, data, frame->linesize, td->width, end - start,
+                    &td->shadowcolor, s->shadowx, s->shadowy - start, 0);
+
+    if (s->borderw)
+        draw_glyphs(s, data, frame->linesize, td->width, end - start,
+                    &td->bordercolor, 0, -start, s->borderw);
+
+    draw_glyphs(s, data, frame->linesize, td->width, end - start,
+                &td->fontcolor, 0, -start, 0);
 
     return 0;
 }
 
-
 static void update_color_with_alpha(DrawTextContext *s, FFDrawColor *color, const FFDrawColor incolor)
 {
     *color = incolor;
@@ -1289,27 +1489,14 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
     DrawTextContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
 
-    uint32_t code = 0, prev_code = 0;
-    int x = 0, y = 0, i = 0, ret;
-    int max_text_line_w = 0, len;
-    int box_w, box_h;
-    char *text;
-    uint8_t *p;
-    int y_min = 32000, y_max = -32000;
-    int x_min = 32000, x_max = -32000;
-    FT_Vector delta;
-    Glyph *glyph = NULL, *prev_glyph = NULL;
-    Glyph dummy = { 0 };
+    ThreadData td = { 0 };
+    int ret, start, end, nb_jobs;
+    const int vsub = s->dc.vsub_max;
 
     time_t now = time(0);
     struct tm ltime;
     AVBPrint *bp = &s->expanded_text;
 
-    FFDrawColor fontcolor;
-    FFDrawColor shadowcolor;
-    FFDrawColor bordercolor;
-    FFDrawColor boxcolor;
-
     av_bprint_clear(bp);
 
     if(s->basetime != AV_NOPTS_VALUE)
@@ -1338,13 +1525,6 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
 
     if (!av_bprint_is_complete(bp))
         return AVERROR(ENOMEM);
-    text = s->expanded_text.str;
-    if ((len = s->expanded_text.len) > s->nb_positions) {
-        if (!(s->positions =
-              av_realloc(s->positions, len*sizeof(*s->positions))))
-            return AVERROR(ENOMEM);
-        s->nb_positions = len;
-    }
 
     if (s->fontcolor_expr[0]) {
         /* If expression is set, evaluate and replace the static value */
@@ -1360,83 +1540,19 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame,
         ff_draw_color(&s->dc, &s->fontcolor, s->fontcolor.rgba);
     }
 
-    x = 0;
-    y = 0;
-
     if ((ret = update_fontsize(ctx)) < 0)
         return ret;
 
-    /* load and cache glyphs */
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid;);
-continue_on_invalid:
-
-        /* get glyph */
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-        if (!glyph) {
-            ret = load_glyph(ctx, &glyph, code);
-            if (ret < 0)
-                return ret;
-        }
-
-        y_min = FFMIN(glyph->bbox.yMin, y_min);
-        y_max = FFMAX(glyph->bbox.yMax, y_max);
-        x_min = FFMIN(glyph->bbox.xMin, x_min);
-        x_max = FFMAX(glyph->bbox.xMax, x_max);
-    }
-    s->max_glyph_h = y_max - y_min;
-    s->max_glyph_w = x_max - x_min;
-
-    /* compute and save position for each glyph */
-    glyph = NULL;
-    for (i = 0, p = text; *p; i++) {
-        GET_UTF8(code, *p ? *p++ : 0, code = 0xfffd; goto continue_on_invalid2;);
-continue_on_invalid2:
-
-        /* skip the \n in the sequence \r\n */
-        if (prev_code == '\r' && code == '\n')
-            continue;
-
-        prev_code = code;
-        if (is_newline(code)) {
-
-            max_text_line_w = FFMAX(max_text_line_w, x);
-            y += s->max_glyph_h + s->line_spacing;
-            x = 0;
-            continue;
-        }
-
-        /* get glyph */
-        prev_glyph = glyph;
-        dummy.code = code;
-        dummy.fontsize = s->fontsize;
-        glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-
-        /* kerning */
-        if (s->use_kerning && prev_glyph && glyph->code) {
-            FT_Get_Kerning(s->face, prev_glyph->code, glyph->code,
-                           ft_kerning_default, &delta);
-            x += delta.x >> 6;
-        }
-
-        /* save position */
-        s->positions[i].x = x + glyph->bitmap_left;
-        s->positions[i].y = y - glyph->bitmap_top + y_max;
-        if (code == '\t') x  = (x / s->tabsize + 1)*s->tabsize;
-        else              x += glyph->advance;
-    }
-
-    max_text_line_w = FFMAX(x, max_text_line_w);
+    if ((ret = layout_text(ctx)) < 0)
+        return ret;
 
-    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = max_text_line_w;
-    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = y + s->max_glyph_h;
+    s->var_values[VAR_TW] = s->var_values[VAR_TEXT_W] = s->text_w;
+    s->var_values[VAR_TH] = s->var_values[VAR_TEXT_H] = s->text_h;
 
     s->var_values[VAR_MAX_GLYPH_W] = s->max_glyph_w;
     s->var_values[VAR_MAX_GLYPH_H] = s->max_glyph_h;
-    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = y_max;
-    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = y_min;
+    s->var_values[VAR_MAX_GLYPH_A] = s->var_values[VAR_ASCENT ] = s->glyph_ascent;
+    s->var_values[VAR_MAX_GLYPH_D] = s->var_values[VAR_DESCENT] = s->glyph_descent;
 
     s->var_values[VAR_LINE_H] = s->var_values[VAR_LH] = s->max_glyph_h;
 
@@ -1446,13 +1562,13 @@ continue_on_invalid2:
     s->x = s->var_values[VAR_X] = av_expr_eval(s->x_pexpr, s->var_values, &s->prng);
 
     update_alpha(s);
-    update_color_with_alpha(s, &fontcolor  , s->fontcolor  );
-    update_color_with_alpha(s, &shadowcolor, s->shadowcolor);
-    update_color_with_alpha(s, &bordercolor, s->bordercolor);
-    update_color_with_alpha(s, &boxcolor   , s->boxcolor   );
+    update_color_with_alpha(s, &td.fontcolor  , s->fontcolor  );
+    update_color_with_alpha(s, &td.shadowcolor, s->shadowcolor);
+    update_color_with_alpha(s, &td.bordercolor, s->bordercolor);
+    update_color_with_alpha(s, &td.boxcolor   , s->boxcolor   );
 
-    box_w = max_text_line_w;
-    box_h = y + s->max_glyph_h;
+    td.box_w = s->text_w;
+    td.box_h = s->text_h;
 
     if (s->fix_bounds) {
 
@@ -1474,33 +1590,39 @@ continue_on_invalid2:
         if (s->x - offsetleft < 0) s->x = offsetleft;
         if (s->y - offsettop < 0)  s->y = offsettop;
 
-        if (s->x + box_w + offsetright > width)
-            s->x = FFMAX(width - box_w - offsetright, 0);
-        if (s->y + box_h + offsetbottom > height)
-            s->y = FFMAX(height - box_h - offsetbottom, 0);
+        if (s->x + td.box_w + offsetright > width)
+            s->x = FFMAX(width - td.box_w - offsetright, 0);
+        if (s->y + td.box_h + offsetbottom > height)
+            s->y = FFMAX(height - td.box_h - offsetbottom, 0);
     }
 
-    /* draw box */
-    if (s->draw_box)
-        ff_blend_rectangle(&s->dc, &boxcolor,
-                           frame->data, frame->linesize, width, height,
-                           s->x - s->boxborderw, s->y - s->boxborderw,
-                           box_w + s->boxborderw * 2, box_h + s->boxborderw * 2);
-
-    if (s->shadowx || s->shadowy) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &shadowcolor, s->shadowx, s->shadowy, 0)) < 0)
-            return ret;
+    /* find the rows touched by the box, the shadow, the border and the text */
+    start = INT_MAX;
+    end   = INT_MIN;
+    if (s->text_top < s->text_bottom) {
+        start = s->y + s->text_top;
+        end   = s->y + s->text_bottom;
+        if (s->shadowx || s->shadowy) {
+            start = FFMIN(start, start + s->shadowy);
+            end   = FFMAX(end,   end   + s->shadowy);
+        }
     }
-
-    if (s->borderw) {
-        if ((ret = draw_glyphs(s, frame, width, height,
-                               &bordercolor, 0, 0, s->borderw)) < 0)
-            return ret;
+    if (s->draw_box) {
+        start = FFMIN(start, s->y - s->boxborderw);
+        end   = FFMAX(end,   s->y + s->boxborderw + td.box_h);
     }
-    if ((ret = draw_glyphs(s, frame, width, height,
-                           &fontcolor, 0, 0, 0)) < 0)
-        return ret;
+    start = FFMAX(start, 0) >> vsub << vsub;
+    end   = FFMIN(end, height);
+    if (start >= end)
+        return 0;
+
+    td.frame  = frame;
+    td.width  = width;
+    td.height = height;
+    td.start  = start;
+    td.end    = end;
+    nb_jobs   = FFMIN(ff_filter_get_nb_threads(ctx), (end - start + (1 << vsub) - 1) >> vsub);
+    ctx->internal->execute(ctx, draw_text_slice, &td, NULL, nb_jobs);
 
     return 0;
 }
@@ -1576,5 +1698,5 @@ AVFilter ff_vf_drawtext = {
     .inputs        = avfilter_vf_drawtext_inputs,
     .outputs       = avfilter_vf_drawtext_outputs,
     .process_command = command,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -252,6 +252,11 @@ static int write_frame(AVFilterContext *ctx, FPSContext *s, AVFilterLink *outlin
         // Make sure Closed Captions will not be duplicated
         av_frame_remove_side_data(s->frames[0], AV_FRAME_DATA_A53_CC);
         frame->pts = s->next_pts++;
+        /* the first output of an input frame may follow a dropped frame */
+        if (s->cur_frame_out)
+            frame->flags |= AV_FRAME_FLAG_DUPLICATE;
+        else
+            frame->flags &= ~AV_FRAME_FLAG_DUPLICATE;
 
         av_log(ctx, AV_LOG_DEBUG, "Writing frame with pts %"PRId64" to pts %"PRId64"\n",
                s->frames[0]->pts, frame->pts);
@@ -353,4 +358,5 @@ AVFilter ff_vf_fps = {
     .activate    = activate,
     .inputs      = avfilter_vf_fps_inputs,
     .outputs     = avfilter_vf_fps_outputs,
+    .flags_internal = FF_FILTER_FLAG_DUPLICATE_AWARE,
 };
@@ -38,6 +38,7 @@
 #include "formats.h"
 #include "framesync.h"
 #include "internal.h"
+#include "lut3d.h"
 #include "video.h"
 
 #define R 0
@@ -83,6 +84,11 @@ typedef struct LUT3DContext {
     int lutsize;
     int lutsize2;
     Lut3DPreLut prelut;
+    LUT3DDSPContext dsp;
+    void (*interp_row)(float *const dst[3], const float *const src[3],
+                       const float *lut, int lutsize, int width);
+    float *rowbuf;              ///< per-job lut coordinate and output rows
+    int rowbuf_stride;
 #if CONFIG_HALDCLUT_FILTER
     uint8_t clut_rgba_map[4];
     int clut_step;
@@ -149,7 +155,7 @@ static inline struct rgbvec lerp(const struct rgbvec *v0, const struct rgbvec *v
 
 #define NEAR(x) ((int)((x) + .5))
 #define PREV(x) ((int)(x))
-#define NEXT(x) (FFMIN((int)(x) + 1, lut3d->lutsize - 1))
+#define NEXT(x) (FFMIN((int)(x) + 1, lutsize - 1))
 
 /**
  * Get the nearest defined point
@@ -164,22 +170,21 @@ static inline struct rgbvec interp_nearest(const LUT3DContext *lut3d,
  * Interpolate using the 8 vertices of a cube
  * @see https://en.wikipedia.org/wiki/Trilinear_interpolation
  */
-static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
-                                             const struct rgbvec *s)
+static inline struct rgbvec trilinear(const struct rgbvec *lut, int lutsize,
+                                      const struct rgbvec *s)
 {
-    const int lutsize2 = lut3d->lutsize2;
-    const int lutsize  = lut3d->lutsize;
+    const int lutsize2 = lutsize * lutsize;
     const int prev[] = {PREV(s->r), PREV(s->g), PREV(s->b)};
     const int next[] = {NEXT(s->r), NEXT(s->g), NEXT(s->b)};
     const struct rgbvec d = {s->r - prev[0], s->g - prev[1], s->b - prev[2]};
-    const struct rgbvec c000 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-    const struct rgbvec c001 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
-    const struct rgbvec c010 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
-    const struct rgbvec c011 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
-    const struct rgbvec c100 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-    const struct rgbvec c101 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
-    const struct rgbvec c110 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
-    const struct rgbvec c111 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
+    const struct rgbvec c000 = lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+    const struct rgbvec c001 = lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
+    const struct rgbvec c010 = lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
+    const struct rgbvec c011 = lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
+    const struct rgbvec c100 = lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+    const struct rgbvec c101 = lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
+    const struct rgbvec c110 = lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
+    const struct rgbvec c111 = lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
     const struct rgbvec c00  = lerp(&c000, &c100, d.r);
     const struct rgbvec c10  = lerp(&c010, &c110, d.r);
     const struct rgbvec c01  = lerp(&c001, &c101, d.r);
@@ -190,6 +195,12 @@ static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
     return c;
 }
 
+static inline struct rgbvec interp_trilinear(const LUT3DContext *lut3d,
+                                             const struct rgbvec *s)
+{
+    return trilinear(lut3d->lut, lut3d->lutsize, s);
+}
+
 static inline struct rgbvec interp_pyramid(const LUT3DContext *lut3d,
                                            const struct rgbvec *s)
 {
@@ -289,53 +300,52 @@ static inline struct rgbvec interp_prism(const LUT3DContext *lut3d,
  * Tetrahedral interpolation. Based on code found in Truelight Software Library paper.
  * @see http://www.filmlight.ltd.uk/pdf/whitepapers/FL-TL-TN-0057-SoftwareLib.pdf
  */
-static inline struct rgbvec interp_tetrahedral(const LUT3DContext *lut3d,
-                                               const struct rgbvec *s)
+static inline struct rgbvec tetrahedral(const struct rgbvec *lut, int lutsize,
+                                        const struct rgbvec *s)
 {
-    const int lutsize2 = lut3d->lutsize2;
-    const int lutsize  = lut3d->lutsize;
+    const int lutsize2 = lutsize * lutsize;
     const int prev[] = {PREV(s->r), PREV(s->g), PREV(s->b)};
     const int next[] = {NEXT(s->r), NEXT(s->g), NEXT(s->b)};
     const struct rgbvec d = {s->r - prev[0], s->g - prev[1], s->b - prev[2]};
-    const struct rgbvec c000 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-    const struct rgbvec c111 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
+    const struct rgbvec c000 = lut[prev[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+    const struct rgbvec c111 = lut[next[0] * lutsize2 + next[1] * lutsize + next[2]];
     struct rgbvec c;
     if (d.r > d.g) {
         if (d.g > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c100 = lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+            const struct rgbvec c110 = lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
             c.r = (1-d.r) * c000.r + (d.r-d.g) * c100.r + (d.g-d.b) * c110.r + (d.b) * c111.r;
             c.g = (1-d.r) * c000.g + (d.r-d.g) * c100.g + (d.g-d.b) * c110.g + (d.b) * c111.g;
             c.b = (1-d.r) * c000.b + (d.r-d.g) * c100.b + (d.g-d.b) * c110.b + (d.b) * c111.b;
         } else if (d.r > d.b) {
-            const struct rgbvec c100 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c100 = lut[next[0] * lutsize2 + prev[1] * lutsize + prev[2]];
+            const struct rgbvec c101 = lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
             c.r = (1-d.r) * c000.r + (d.r-d.b) * c100.r + (d.b-d.g) * c101.r + (d.g) * c111.r;
             c.g = (1-d.r) * c000.g + (d.r-d.b) * c100.g + (d.b-d.g) * c101.g + (d.g) * c111.g;
             c.b = (1-d.r) * c000.b + (d.r-d.b) * c100.b + (d.b-d.g) * c101.b + (d.g) * c111.b;
         } else {
-            const struct rgbvec c001 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
-            const struct rgbvec c101 = lut3d->lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c001 = lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c101 = lut[next[0] * lutsize2 + prev[1] * lutsize + next[2]];
             c.r = (1-d.b) * c000.r + (d.b-d.r) * c001.r + (d.r-d.g) * c101.r + (d.g) * c111.r;
             c.g = (1-d.b) * c000.g + (d.b-d.r) * c001.g + (d.r-d.g) * c101.g + (d.g) * c111.g;
             c.b = (1-d.b) * c000.b + (d.b-d.r) * c001.b + (d.r-d.g) * c101.b + (d.g) * c111.b;
         }
     } else {
         if (d.b > d.g) {
-            const struct rgbvec c001 = lut3d->lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
+            const struct rgbvec c001 = lut[prev[0] * lutsize2 + prev[1] * lutsize + next[2]];
+            const struct rgbvec c011 = lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
             c.r = (1-d.b) * c000.r + (d.b-d.g) * c001.r + (d.g-d.r) * c011.r + (d.r) * c111.r;
             c.g = (1-d.b) * c000.g + (d.b-d.g) * c001.g + (d.g-d.r) * c011.g + (d.r) * c111.g;
             c.b = (1-d.b) * c000.b + (d.b-d.g) * c001.b + (d.g-d.r) * c011.b + (d.r) * c111.b;
         } else if (d.b > d.r) {
-            const struct rgbvec c010 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
-            const struct rgbvec c011 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
+            const struct rgbvec c010 = lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c011 = lut[prev[0] * lutsize2 + next[1] * lutsize + next[2]];
             c.r = (1-d.g) * c000.r + (d.g-d.b) * c010.r + (d.b-d.r) * c011.r + (d.r) * c111.r;
             c.g = (1-d.g) * c000.g + (d.g-d.b) * c010.g + (d.b-d.r) * c011.g + (d.r) * c111.g;
             c.b = (1-d.g) * c000.b + (d.g-d.b) * c010.b + (d.b-d.r) * c011.b + (d.r) * c111.b;
         } else {
-            const struct rgbvec c010 = lut3d->lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
-            const struct rgbvec c110 = lut3d->lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c010 = lut[prev[0] * lutsize2 + next[1] * lutsize + prev[2]];
+            const struct rgbvec c110 = lut[next[0] * lutsize2 + next[1] * lutsize + prev[2]];
             c.r = (1-d.g) * c000.r + (d.g-d.r) * c010.r + (d.r-d.b) * c110.r + (d.b) * c111.r;
             c.g = (1-d.g) * c000.g + (d.g-d.r) * c010.g + (d.r-d.b) * c110.g + (d.b) * c111.g;
             c.b = (1-d.g) * c000.b + (d.g-d.r) * c010.b + (d.r-d.b) * c110.b + (d.b) * c111.b;
@@ -344,6 +354,12 @@ static inline struct rgbvec interp_tetrahedral(const LUT3DContext *lut3d,
     return c;
 }
 
+static inline struct rgbvec interp_tetrahedral(const LUT3DContext *lut3d,
+                                               const struct rgbvec *s)
+{
+    return tetrahedral(lut3d->lut, lut3d->lutsize, s);
+}
+
 static inline float prelut_interp_1d_linear(const Lut3DPreLut *prelut,
                                             int idx, const float s)
 {
@@ -372,6 +388,35 @@ static inline struct rgbvec apply_prelut(const Lut3DPreLut *prelut,
     return c;
 }
 
+#define DEFINE_INTERP_ROW(name)                                                                 \
+static void interp_##name##_row_c(float *const dst[3], const float *const src[3],               \
+                                  const float *lut, int lutsize, int width)                     \
+{                                                                                               \
+    int x;                                                                                      \
+                                                                                                \
+    for (x = 0; x < width; x++) {                                                               \
+        const struct rgbvec s = {src[0][x], src[1][x], src[2][x]};                              \
+        const struct rgbvec c = name((const struct rgbvec *)lut, lutsize, &s);                  \
+        dst[0][x] = c.r;                                                                        \
+        dst[1][x] = c.g;                                                                        \
+        dst[2][x] = c.b;                                                                        \
+    }                                                                                           \
+}
+
+DEFINE_INTERP_ROW(trilinear)
+DEFINE_INTERP_ROW(tetrahedral)
+
+void ff_lut3d_dsp_init(LUT3DDSPContext *dsp)
+{
+    dsp->interp_trilinear   = interp_trilinear_row_c;
+    dsp->interp_tetrahedral = interp_tetrahedral_row_c;
+
+    if (ARCH_AARCH64)
+        ff_lut3d_dsp_init_aarch64(dsp);
+    if (ARCH_X86)
+        ff_lut3d_dsp_init_x86(dsp);
+}
+
 #define DEFINE_INTERP_FUNC_PLANAR(name, nbits, depth)                                                  \
 static int interp_##nbits##_##name##_p##depth(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs) \
 {                                                                                                      \
@@ -537,6 +582,103 @@ DEFINE_INTERP_FUNC_PLANAR_FLOAT(tetrahedral, 32)
 DEFINE_INTERP_FUNC_PLANAR_FLOAT(pyramid,     32)
 DEFINE_INTERP_FUNC_PLANAR_FLOAT(prism,       32)
 
+/**
+ * Planar path for the interpolations with a row function: the lut
+ * coordinates of each row are computed into a per-job buffer, interpolated
+ * at once, and converted back.
+ */
+static av_always_inline int interp_rows_planar(AVFilterContext *ctx, void *arg,
+                                               int jobnr, int nb_jobs,
+                                               int nbits, int depth)
+{
+    int x, y, c;
+    const LUT3DContext *lut3d = ctx->priv;
+    const Lut3DPreLut *prelut = &lut3d->prelut;
+    const ThreadData *td = arg;
+    const AVFrame *in  = td->in;
+    const AVFrame *out = td->out;
+    const int direct = out == in;
+    const int slice_start = (in->height *  jobnr   ) / nb_jobs;
+    const int slice_end   = (in->height * (jobnr+1)) / nb_jobs;
+    const float lut_max = lut3d->lutsize - 1;
+    const float scale_f = nbits == 32 ? 1.0f : 1.0f / ((1<<depth) - 1);
+    const float scale_r = lut3d->scale.r * lut_max;
+    const float scale_g = lut3d->scale.g * lut_max;
+    const float scale_b = lut3d->scale.b * lut_max;
+    float *buf = lut3d->rowbuf + jobnr * 6 * lut3d->rowbuf_stride;
+    float *coord[3], *rgb[3];
+    /* planes of the r, g and b components */
+    static const int planes[3] = { 2, 0, 1 };
+
+    for (c = 0; c < 3; c++) {
+        coord[c] = buf + c * lut3d->rowbuf_stride;
+        rgb[c]   = buf + (c + 3) * lut3d->rowbuf_stride;
+    }
+
+    for (y = slice_start; y < slice_end; y++) {
+        const uint8_t *srcr = in->data[2] + y * in->linesize[2];
+        const uint8_t *srcg = in->data[0] + y * in->linesize[0];
+        const uint8_t *srcb = in->data[1] + y * in->linesize[1];
+
+        for (x = 0; x < in->width; x++) {
+            struct rgbvec s, prelut_rgb;
+
+            if (nbits == 32) {
+                s.r = sanitizef(((const float *)srcr)[x]);
+                s.g = sanitizef(((const float *)srcg)[x]);
+                s.b = sanitizef(((const float *)srcb)[x]);
+            } else if (nbits == 16) {
+                s.r = ((const uint16_t *)srcr)[x] * scale_f;
+                s.g = ((const uint16_t *)srcg)[x] * scale_f;
+                s.b = ((const uint16_t *)srcb)[x] * scale_f;
+            } else {
+                s.r = srcr[x] * scale_f;
+                s.g = srcg[x] * scale_f;
+                s.b = srcb[x] * scale_f;
+            }
+            prelut_rgb = apply_prelut(prelut, &s);
+            coord[0][x] = av_clipf(prelut_rgb.r * scale_r, 0, lut_max);
+            coord[1][x] = av_clipf(prelut_rgb.g * scale_g, 0, lut_max);
+            coord[2][x] = av_clipf(prelut_rgb.b * scale_b, 0, lut_max);
+        }
+
+        lut3d->interp_row(rgb, (const float *const *)coord,
+                          (const float *)lut3d->lut, lut3d->lutsize, in->width);
+
+        for (c = 0; c < 3; c++) {
+            uint8_t *dst = out->data[planes[c]] + y * out->linesize[planes[c]];
+
+            if (nbits == 32) {
+                memcpy(dst, rgb[c], in->width * sizeof(float));
+            } else if (nbits == 16) {
+                for (x = 0; x < in->width; x++)
+                    ((uint16_t *)dst)[x] = av_clip_uintp2(rgb[c][x] * (float)((1<<depth) - 1), depth);
+            } else {
+                for (x = 0; x < in->width; x++)
+                    dst[x] = av_clip_uintp2(rgb[c][x] * (float)((1<<depth) - 1), depth);
+            }
+        }
+        if (!direct && in->linesize[3])
+            memcpy(out->data[3] + y * out->linesize[3],
+                   in->data[3]  + y * in->linesize[3], in->width * (nbits >> 3));
+    }
+    return 0;
+}
+
+#define DEFINE_INTERP_ROWS_PLANAR(nbits, depth)                                                    \
+static int interp_rows_##nbits##_p##depth(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs) \
+{                                                                                                  \
+    return interp_rows_planar(ctx, arg, jobnr, nb_jobs, nbits, depth);                             \
+}
+
+DEFINE_INTERP_ROWS_PLANAR( 8,  8)
+DEFINE_INTERP_ROWS_PLANAR(16,  9)
+DEFINE_INTERP_ROWS_PLANAR(16, 10)
+DEFINE_INTERP_ROWS_PLANAR(16, 12)
+DEFINE_INTERP_ROWS_PLANAR(16, 14)
+DEFINE_INTERP_ROWS_PLANAR(16, 16)
+DEFINE_INTERP_ROWS_PLANAR(32, 32)
+
 #define DEFINE_INTERP_FUNC(name, nbits)                                                             \
 static int interp_##nbits##_##name(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)         \
 {                                                                                                   \
@@ -1210,6 +1352,36 @@ static int config_input(AVFilterLink *inlink)
         av_assert0(0);
     }
 
+    lut3d->interp_row = NULL;
+    if (planar) {
+        ff_lut3d_dsp_init(&lut3d->dsp);
+        if (lut3d->interpolation == INTERPOLATE_TRILINEAR)
+            lut3d->interp_row = lut3d->dsp.interp_trilinear;
+        else if (lut3d->interpolation == INTERPOLATE_TETRAHEDRAL)
+            lut3d->interp_row = lut3d->dsp.interp_tetrahedral;
+    }
+
+    if (lut3d->interp_row) {
+        const int nb_threads = ff_filter_get_nb_threads(inlink->dst);
+
+        /* the padding coordinates must stay valid for the SIMD versions */
+        av_freep(&lut3d->rowbuf);
+        lut3d->rowbuf_stride = FFALIGN(inlink->w, 16);
+        lut3d->rowbuf = av_calloc(nb_threads * 6, lut3d->rowbuf_stride * sizeof(*lut3d->rowbuf));
+        if (!lut3d->rowbuf)
+            return AVERROR(ENOMEM);
+
+        switch (depth) {
+        case  8: lut3d->interp = interp_rows_8_p8;   break;
+        case  9: lut3d->interp = interp_rows_16_p9;  break;
+        case 10: lut3d->interp = interp_rows_16_p10; break;
+        case 12: lut3d->interp = interp_rows_16_p12; break;
+        case 14: lut3d->interp = interp_rows_16_p14; break;
+        case 16: lut3d->interp = interp_rows_16_p16; break;
+        case 32: lut3d->interp = interp_rows_32_p32; break;
+        }
+    }
+
     return 0;
 }
 
@@ -1329,6 +1501,7 @@ static av_cold void lut3d_uninit(AVFilterContext *ctx)
     LUT3DContext *lut3d = ctx->priv;
     int i;
     av_freep(&lut3d->lut);
+    av_freep(&lut3d->rowbuf);
 
     for (i = 0; i < 3; i++) {
         av_freep(&lut3d->prelut.lut[i]);
@@ -1590,6 +1763,7 @@ static av_cold void haldclut_uninit(AVFilterContext *ctx)
     LUT3DContext *lut3d = ctx->priv;
     ff_framesync_uninit(&lut3d->fs);
     av_freep(&lut3d->lut);
+    av_freep(&lut3d->rowbuf);
 }
 
 static const AVOption haldclut_options[] = {
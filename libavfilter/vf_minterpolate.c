@@ -19,6 +19,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
+#include "config.h"
 #include "motion_estimation.h"
 #include "libavcodec/mathops.h"
 #include "libavutil/avassert.h"
@@ -26,8 +29,10 @@
 #include "libavutil/motion_vector.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "formats.h"
+#include "framethread.h"
 #include "internal.h"
 #include "video.h"
 #include "scene_sad.h"
@@ -49,6 +54,7 @@
 #define CLUSTER_THRESHOLD 4
 #define PX_WEIGHT_MAX 255
 #define COST_PRED_SCALE 64
+#define MAX_FRAME_JOBS 4
 
 static const uint8_t obmc_linear32[1024] = {
   0,  0,  0,  0,  4,  4,  4,  4,  4,  4,  4,  4,  8,  8,  8,  8,  8,  8,  8,  8,  4,  4,  4,  4,  4,  4,  4,  4,  0,  0,  0,  0,
@@ -145,24 +151,43 @@ typedef struct Block {
     struct Block *subs;
 } Block;
 
-typedef struct PixelMVS {
-    int16_t mvs[NB_PIXEL_MVS][2];
-} PixelMVS;
-
-typedef struct PixelWeights {
-    uint32_t weights[NB_PIXEL_MVS];
-} PixelWeights;
-
-typedef struct PixelRefs {
-    int8_t refs[NB_PIXEL_MVS];
+typedef struct PixelAcc {
+    uint32_t val[4];
+    uint32_t weight_sum;
     int nb;
-} PixelRefs;
+} PixelAcc;
 
 typedef struct Frame {
     AVFrame *avf;
     Block *blocks;
 } Frame;
 
+/**
+ * Motion estimation results between two input frames, kept for the
+ * interpolation jobs using them.
+ */
+typedef struct MIWindow {
+    AVMotionEstContext me_ctx;
+    Block *blocks[2];
+    Block *int_blocks;
+    int b_count;
+    int scene_changed;
+} MIWindow;
+
+typedef struct MIJob {
+    AVFrame *ref[3];
+    MIWindow *win;
+    PixelAcc *pixel_acc;
+    int width, height;
+    int y_start, y_end;     ///< luma rows written by this slice
+} MIJob;
+
+typedef struct METhreadData {
+    Block *blocks;
+    int dir;
+    int pred_x, pred_y;     ///< median predictor after the last block
+} METhreadData;
+
 typedef struct MIContext {
     const AVClass *class;
     AVMotionEstContext me_ctx;
@@ -178,9 +203,14 @@ typedef struct MIContext {
     Frame frames[NB_FRAMES];
     Cluster clusters[NB_CLUSTERS];
     Block *int_blocks;
-    PixelMVS *pixel_mvs;
-    PixelWeights *pixel_weights;
-    PixelRefs *pixel_refs;
+    PixelAcc *pixel_acc;
+    FFFrameThreadContext ft;
+    atomic_int *row_progress;
+#if HAVE_THREADS
+    pthread_mutex_t progress_mutex;
+    pthread_cond_t progress_cond;
+    int progress_sync;
+#endif
     int (*mv_table[3])[2][2];
     int64_t out_pts;
     int b_width, b_height, b_count;
@@ -258,6 +288,7 @@ static int query_formats(AVFilterContext *ctx)
 
 static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int y_mv)
 {
+    av_pixelutils_sad_fn sad_fn = ff_me_get_sad_fn(me_ctx, me_ctx->mb_size);
     uint8_t *data_cur = me_ctx->data_cur;
     uint8_t *data_next = me_ctx->data_ref;
     int linesize = me_ctx->linesize;
@@ -274,15 +305,21 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     data_cur += (y + mv_y) * linesize;
     data_next += (y - mv_y) * linesize;
 
-    for (j = 0; j < me_ctx->mb_size; j++)
-        for (i = 0; i < me_ctx->mb_size; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + j * linesize] - data_next[x - mv_x + i + j * linesize]);
+    if (sad_fn) {
+        sbad = sad_fn(data_cur + x + mv_x, linesize, data_next + x - mv_x, linesize);
+    } else {
+        for (j = 0; j < me_ctx->mb_size; j++)
+            for (i = 0; i < me_ctx->mb_size; i++)
+                sbad += FFABS(data_cur[x + mv_x + i + j * linesize] - data_next[x - mv_x + i + j * linesize]);
+    }
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
 
 static uint64_t get_sbad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int y_mv)
 {
+    const int ob_size = me_ctx->mb_size * 3 / 2 + me_ctx->mb_size / 2;
+    av_pixelutils_sad_fn sad_fn = ff_me_get_sad_fn(me_ctx, ob_size);
     uint8_t *data_cur = me_ctx->data_cur;
     uint8_t *data_next = me_ctx->data_ref;
     int linesize = me_ctx->linesize;
@@ -300,15 +337,24 @@ static uint64_t get_sbad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv,
     mv_x = av_clip(x_mv - x, -FFMIN(x - x_min, x_max - x), FFMIN(x - x_min, x_max - x));
     mv_y = av_clip(y_mv - y, -FFMIN(y - y_min, y_max - y), FFMIN(y - y_min, y_max - y));
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + (y + mv_y + j) * linesize] - data_next[x - mv_x + i + (y - mv_y + j) * linesize]);
+    if (sad_fn) {
+        int offset = -me_ctx->mb_size / 2;
+
+        sbad = sad_fn(data_cur  + x + mv_x + offset + (y + mv_y + offset) * linesize, linesize,
+                      data_next + x - mv_x + offset + (y - mv_y + offset) * linesize, linesize);
+    } else {
+        for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
+            for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
+                sbad += FFABS(data_cur[x + mv_x + i + (y + mv_y + j) * linesize] - data_next[x - mv_x + i + (y - mv_y + j) * linesize]);
+    }
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
 
 static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int y_mv)
 {
+    const int ob_size = me_ctx->mb_size * 3 / 2 + me_ctx->mb_size / 2;
+    av_pixelutils_sad_fn sad_fn = ff_me_get_sad_fn(me_ctx, ob_size);
     uint8_t *data_ref = me_ctx->data_ref;
     uint8_t *data_cur = me_ctx->data_cur;
     int linesize = me_ctx->linesize;
@@ -326,13 +372,23 @@ static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, i
     x_mv = av_clip(x_mv, x_min, x_max);
     y_mv = av_clip(y_mv, y_min, y_max);
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sad += FFABS(data_ref[x_mv + i + (y_mv + j) * linesize] - data_cur[x + i + (y + j) * linesize]);
+    if (sad_fn) {
+        int offset = -me_ctx->mb_size / 2;
+
+        sad = sad_fn(data_ref + x_mv + offset + (y_mv + offset) * linesize, linesize,
+                     data_cur + x    + offset + (y    + offset) * linesize, linesize);
+    } else {
+        for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
+            for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
+                sad += FFABS(data_ref[x_mv + i + (y_mv + j) * linesize] - data_cur[x + i + (y + j) * linesize]);
+    }
 
     return sad + (FFABS(mv_x - me_ctx->pred_x) + FFABS(mv_y - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
 
+static int interpolate_job(AVFilterContext *ctx, FFFrameJob *job, int jobnr,
+                           int slicenr, int nb_slices);
+
 static int config_input(AVFilterLink *inlink)
 {
     MIContext *mi_ctx = inlink->dst->priv;
@@ -340,7 +396,11 @@ static int config_input(AVFilterLink *inlink)
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(inlink->format);
     const int height = inlink->h;
     const int width  = inlink->w;
-    int i;
+    const int nb_threads = ff_filter_get_nb_threads(inlink->dst);
+    /* bound the number of frames in flight, use slices for more threads */
+    const int nb_jobs = FFMIN(nb_threads, MAX_FRAME_JOBS);
+    const int nb_slices = FFMIN((nb_threads + nb_jobs - 1) / nb_jobs, FFMAX(height >> 4, 1));
+    int i, ret;
 
     mi_ctx->log2_chroma_h = desc->log2_chroma_h;
     mi_ctx->log2_chroma_w = desc->log2_chroma_w;
@@ -377,10 +437,9 @@ static int config_input(AVFilterLink *inlink)
         else if (mi_ctx->me_mode == ME_MODE_BILAT)
             me_ctx->get_cost = &get_sbad_ob;
 
-        mi_ctx->pixel_mvs = av_mallocz_array(width * height, sizeof(PixelMVS));
-        mi_ctx->pixel_weights = av_mallocz_array(width * height, sizeof(PixelWeights));
-        mi_ctx->pixel_refs = av_mallocz_array(width * height, sizeof(PixelRefs));
-        if (!mi_ctx->pixel_mvs || !mi_ctx->pixel_weights || !mi_ctx->pixel_refs)
+        mi_ctx->pixel_acc = av_malloc_array(width * height, nb_jobs * sizeof(PixelAcc));
+        mi_ctx->row_progress = av_malloc_array(mi_ctx->b_height, sizeof(*mi_ctx->row_progress));
+        if (!mi_ctx->pixel_acc || !mi_ctx->row_progress)
             return AVERROR(ENOMEM);
 
         if (mi_ctx->me_mode == ME_MODE_BILAT)
@@ -402,6 +461,9 @@ static int config_input(AVFilterLink *inlink)
             return AVERROR(EINVAL);
     }
 
+    if ((ret = ff_framethread_init(&mi_ctx->ft, inlink->dst, nb_jobs, nb_slices, interpolate_job)) < 0)
+        return ret;
+
     return 0;
 }
 
@@ -422,9 +484,9 @@ static int config_output(AVFilterLink *outlink)
         preds.nb++;\
     } while(0)
 
-static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int dir)
+static void search_mv(MIContext *mi_ctx, AVMotionEstContext *me_ctx, Block *blocks,
+                      int mb_x, int mb_y, int dir)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
     AVMotionEstPredictor *preds = me_ctx->preds;
     Block *block = &blocks[mb_x + mb_y * mi_ctx->b_width];
 
@@ -564,8 +626,98 @@ static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int
     block->mvs[dir][1] = mv[1] - y_mb;
 }
 
-static void bilateral_me(MIContext *mi_ctx)
+static void await_row(MIContext *mi_ctx, int mb_y, int n)
 {
+    if (atomic_load_explicit(&mi_ctx->row_progress[mb_y], memory_order_acquire) >= n)
+        return;
+#if HAVE_THREADS
+    pthread_mutex_lock(&mi_ctx->progress_mutex);
+    while (atomic_load_explicit(&mi_ctx->row_progress[mb_y], memory_order_acquire) < n)
+        pthread_cond_wait(&mi_ctx->progress_cond, &mi_ctx->progress_mutex);
+    pthread_mutex_unlock(&mi_ctx->progress_mutex);
+#endif
+}
+
+static void report_row(MIContext *mi_ctx, int mb_y, int n)
+{
+    atomic_store_explicit(&mi_ctx->row_progress[mb_y], n, memory_order_release);
+#if HAVE_THREADS
+    pthread_mutex_lock(&mi_ctx->progress_mutex);
+    pthread_cond_broadcast(&mi_ctx->progress_cond);
+    pthread_mutex_unlock(&mi_ctx->progress_mutex);
+#endif
+}
+
+static int search_mv_row(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    METhreadData *td = arg;
+    AVMotionEstContext me_ctx = mi_ctx->me_ctx;
+    const int predictive = mi_ctx->me_method == AV_ME_METHOD_EPZS ||
+                           mi_ctx->me_method == AV_ME_METHOD_UMH;
+    const int mb_y = jobnr;
+    int mb_x;
+
+    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+        /* predictors use the left, top and top-right vectors of the same frame */
+        if (predictive && mb_y > 0)
+            await_row(mi_ctx, mb_y - 1, FFMIN(mb_x + 2, mi_ctx->b_width));
+
+        search_mv(mi_ctx, &me_ctx, td->blocks, mb_x, mb_y, td->dir);
+
+        if (predictive)
+            report_row(mi_ctx, mb_y, mb_x + 1);
+    }
+
+    if (mb_y == mi_ctx->b_height - 1) {
+        td->pred_x = me_ctx.pred_x;
+        td->pred_y = me_ctx.pred_y;
+    }
+
+    return 0;
+}
+
+/**
+ * Search the vectors of all blocks, one macroblock row per job. Rows are
+ * processed as a wavefront when the search uses spatial predictors, so the
+ * result does not depend on the number of threads.
+ */
+static void motion_search(AVFilterContext *ctx, Block *blocks, int dir)
+{
+    MIContext *mi_ctx = ctx->priv;
+    METhreadData td = { .blocks = blocks, .dir = dir };
+    int mb_y;
+
+    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
+        atomic_store_explicit(&mi_ctx->row_progress[mb_y], 0, memory_order_relaxed);
+
+    ctx->internal->execute(ctx, search_mv_row, &td, NULL, mi_ctx->b_height);
+
+    /* the cost functions keep using the predictor of the last block */
+    mi_ctx->me_ctx.pred_x = td.pred_x;
+    mi_ctx->me_ctx.pred_y = td.pred_y;
+}
+
+static int compute_sbad_row(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    const int mb_y = jobnr;
+    int mb_x;
+
+    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+        int x_mb = mb_x << mi_ctx->log2_mb_size;
+        int y_mb = mb_y << mi_ctx->log2_mb_size;
+        Block *block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+
+        block->sbad = get_sbad(&mi_ctx->me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
+    }
+
+    return 0;
+}
+
+static void bilateral_me(AVFilterContext *ctx)
+{
+    MIContext *mi_ctx = ctx->priv;
     Block *block;
     int mb_x, mb_y;
 
@@ -580,9 +732,7 @@ static void bilateral_me(MIContext *mi_ctx)
             block->mvs[0][1] = 0;
         }
 
-    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-            search_mv(mi_ctx, mi_ctx->int_blocks, mb_x, mb_y, 0);
+    motion_search(ctx, mi_ctx->int_blocks, 0);
 }
 
 static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n)
@@ -765,9 +915,7 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
                     mi_ctx->me_ctx.data_cur = mi_ctx->frames[2].avf->data[0];
                     mi_ctx->me_ctx.data_ref = mi_ctx->frames[dir ? 3 : 1].avf->data[0];
 
-                    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-                            search_mv(mi_ctx, mi_ctx->frames[2].blocks, mb_x, mb_y, dir);
+                    motion_search(ctx, mi_ctx->frames[2].blocks, dir);
                 }
             }
 
@@ -782,19 +930,10 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
             mi_ctx->me_ctx.data_cur = mi_ctx->frames[1].avf->data[0];
             mi_ctx->me_ctx.data_ref = mi_ctx->frames[2].avf->data[0];
 
-            bilateral_me(mi_ctx);
+            bilateral_me(ctx);
 
-            if (mi_ctx->mc_mode == MC_MODE_AOBMC) {
-
-                for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        int x_mb = mb_x << mi_ctx->log2_mb_size;
-                        int y_mb = mb_y << mi_ctx->log2_mb_size;
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
-
-                        block->sbad = get_sbad(&mi_ctx->me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
-                    }
-            }
+            if (mi_ctx->mc_mode == MC_MODE_AOBMC)
+                ctx->internal->execute(ctx, compute_sbad_row, NULL, NULL, mi_ctx->b_height);
 
             if (mi_ctx->vsbmc) {
 
@@ -848,39 +987,68 @@ static int detect_scene_change(AVFilterContext *ctx)
     return 0;
 }
 
+/* a chroma sample takes the references of the last luma pixel covering it */
+static int is_chroma_pixel(MIContext *mi_ctx, MIJob *job, int x, int y)
+{
+    const int mask_w = (1 << mi_ctx->log2_chroma_w) - 1;
+    const int mask_h = (1 << mi_ctx->log2_chroma_h) - 1;
+
+    return ((x & mask_w) == mask_w || x == job->width  - 1) &&
+           ((y & mask_h) == mask_h || y == job->height - 1);
+}
+
+static void add_pixel(MIContext *mi_ctx, MIJob *job, PixelAcc *pixel_acc,
+                      int x, int y, int ref, uint32_t weight, int mv_x, int mv_y)
+{
+    const AVFrame *frame = job->ref[ref];
+    const int chroma = is_chroma_pixel(mi_ctx, job, x, y);
+    int plane;
+
+    pixel_acc->weight_sum += weight;
+
+    for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
+        int x_mv, y_mv;
+
+        if (plane == 1 || plane == 2) {
+            if (!chroma)
+                continue;
+            x_mv = (x >> mi_ctx->log2_chroma_w) + mv_x / (1 << mi_ctx->log2_chroma_w);
+            y_mv = (y >> mi_ctx->log2_chroma_h) + mv_y / (1 << mi_ctx->log2_chroma_h);
+        } else {
+            x_mv = x + mv_x;
+            y_mv = y + mv_y;
+        }
+
+        pixel_acc->val[plane] += weight * frame->data[plane][x_mv + y_mv * frame->linesize[plane]];
+    }
+}
+
 #define ADD_PIXELS(b_weight, mv_x, mv_y)\
     do {\
-        if (!b_weight || pixel_refs->nb + 1 >= NB_PIXEL_MVS)\
+        if (!b_weight || pixel_acc->nb + 1 >= NB_PIXEL_MVS)\
             continue;\
-        pixel_refs->refs[pixel_refs->nb] = 1;\
-        pixel_weights->weights[pixel_refs->nb] = b_weight * (ALPHA_MAX - alpha);\
-        pixel_mvs->mvs[pixel_refs->nb][0] = av_clip((mv_x * alpha) / ALPHA_MAX, x_min, x_max);\
-        pixel_mvs->mvs[pixel_refs->nb][1] = av_clip((mv_y * alpha) / ALPHA_MAX, y_min, y_max);\
-        pixel_refs->nb++;\
-        pixel_refs->refs[pixel_refs->nb] = 2;\
-        pixel_weights->weights[pixel_refs->nb] = b_weight * alpha;\
-        pixel_mvs->mvs[pixel_refs->nb][0] = av_clip(-mv_x * (ALPHA_MAX - alpha) / ALPHA_MAX, x_min, x_max);\
-        pixel_mvs->mvs[pixel_refs->nb][1] = av_clip(-mv_y * (ALPHA_MAX - alpha) / ALPHA_MAX, y_min, y_max);\
-        pixel_refs->nb++;\
+        add_pixel(mi_ctx, job, pixel_acc, x, y, 1, b_weight * (ALPHA_MAX - alpha),\
+                  av_clip((mv_x * alpha) / ALPHA_MAX, x_min, x_max),\
+                  av_clip((mv_y * alpha) / ALPHA_MAX, y_min, y_max));\
+        add_pixel(mi_ctx, job, pixel_acc, x, y, 2, b_weight * alpha,\
+                  av_clip(-mv_x * (ALPHA_MAX - alpha) / ALPHA_MAX, x_min, x_max),\
+                  av_clip(-mv_y * (ALPHA_MAX - alpha) / ALPHA_MAX, y_min, y_max));\
+        pixel_acc->nb += 2;\
     } while(0)
 
-static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
+static void bidirectional_obmc(MIContext *mi_ctx, MIJob *job, int alpha)
 {
     int x, y;
-    int width = mi_ctx->frames[0].avf->width;
-    int height = mi_ctx->frames[0].avf->height;
+    int width = job->width;
+    int height = job->height;
     int mb_y, mb_x, dir;
 
-    for (y = 0; y < height; y++)
-        for (x = 0; x < width; x++)
-            mi_ctx->pixel_refs[x + y * width].nb = 0;
-
     for (dir = 0; dir < 2; dir++)
         for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
             for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
                 int a = dir ? alpha : (ALPHA_MAX - alpha);
-                int mv_x = mi_ctx->frames[2 - dir].blocks[mb_x + mb_y * mi_ctx->b_width].mvs[dir][0];
-                int mv_y = mi_ctx->frames[2 - dir].blocks[mb_x + mb_y * mi_ctx->b_width].mvs[dir][1];
+                int mv_x = job->win->blocks[dir][mb_x + mb_y * mi_ctx->b_width].mvs[dir][0];
+                int mv_y = job->win->blocks[dir][mb_x + mb_y * mi_ctx->b_width].mvs[dir][1];
                 int start_x, start_y;
                 int startc_x, startc_y, endc_x, endc_y;
 
@@ -888,9 +1056,9 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
                 start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2 + mv_y * a / ALPHA_MAX;
 
                 startc_x = av_clip(start_x, 0, width - 1);
-                startc_y = av_clip(start_y, 0, height - 1);
+                startc_y = FFMAX(av_clip(start_y, 0, height - 1), job->y_start);
                 endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-                endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
+                endc_y = FFMIN(av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1), job->y_end);
 
                 if (dir) {
                     mv_x = -mv_x;
@@ -904,9 +1072,7 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
                         int x_min = -x;
                         int x_max = width - x - 1;
                         int obmc_weight = obmc_tab_linear[4 - mi_ctx->log2_mb_size][(x - start_x) + ((y - start_y) << (mi_ctx->log2_mb_size + 1))];
-                        PixelMVS *pixel_mvs = &mi_ctx->pixel_mvs[x + y * width];
-                        PixelWeights *pixel_weights = &mi_ctx->pixel_weights[x + y * width];
-                        PixelRefs *pixel_refs = &mi_ctx->pixel_refs[x + y * width];
+                        PixelAcc *pixel_acc = &job->pixel_acc[x + y * width];
 
                         ADD_PIXELS(obmc_weight, mv_x, mv_y);
                     }
@@ -914,76 +1080,53 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
             }
 }
 
-static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
+static void set_frame_data(MIContext *mi_ctx, MIJob *job, int alpha, AVFrame *avf_out)
 {
     int x, y, plane;
+    int width = avf_out->width;
 
-    for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
-        int width = avf_out->width;
-        int height = avf_out->height;
-        int chroma = plane == 1 || plane == 2;
-
-        for (y = 0; y < height; y++)
-            for (x = 0; x < width; x++) {
-                int x_mv, y_mv;
-                int weight_sum = 0;
-                int i, val = 0;
-                PixelMVS *pixel_mvs = &mi_ctx->pixel_mvs[x + y * avf_out->width];
-                PixelWeights *pixel_weights = &mi_ctx->pixel_weights[x + y * avf_out->width];
-                PixelRefs *pixel_refs = &mi_ctx->pixel_refs[x + y * avf_out->width];
-
-                for (i = 0; i < pixel_refs->nb; i++)
-                    weight_sum += pixel_weights->weights[i];
-
-                if (!weight_sum || !pixel_refs->nb) {
-                    pixel_weights->weights[0] = ALPHA_MAX - alpha;
-                    pixel_refs->refs[0] = 1;
-                    pixel_mvs->mvs[0][0] = 0;
-                    pixel_mvs->mvs[0][1] = 0;
-                    pixel_weights->weights[1] = alpha;
-                    pixel_refs->refs[1] = 2;
-                    pixel_mvs->mvs[1][0] = 0;
-                    pixel_mvs->mvs[1][1] = 0;
-                    pixel_refs->nb = 2;
-
-                    weight_sum = ALPHA_MAX;
-                }
+    for (y = job->y_start; y < job->y_end; y++)
+        for (x = 0; x < width; x++) {
+            PixelAcc *pixel_acc = &job->pixel_acc[x + y * width];
+            int weight_sum = pixel_acc->weight_sum;
+            int chroma = is_chroma_pixel(mi_ctx, job, x, y);
 
-                for (i = 0; i < pixel_refs->nb; i++) {
-                    Frame *frame = &mi_ctx->frames[pixel_refs->refs[i]];
-                    if (chroma) {
-                        x_mv = (x >> mi_ctx->log2_chroma_w) + pixel_mvs->mvs[i][0] / (1 << mi_ctx->log2_chroma_w);
-                        y_mv = (y >> mi_ctx->log2_chroma_h) + pixel_mvs->mvs[i][1] / (1 << mi_ctx->log2_chroma_h);
-                    } else {
-                        x_mv = x + pixel_mvs->mvs[i][0];
-                        y_mv = y + pixel_mvs->mvs[i][1];
-                    }
+            if (!weight_sum || !pixel_acc->nb) {
+                memset(pixel_acc, 0, sizeof(*pixel_acc));
+                add_pixel(mi_ctx, job, pixel_acc, x, y, 1, ALPHA_MAX - alpha, 0, 0);
+                add_pixel(mi_ctx, job, pixel_acc, x, y, 2, alpha, 0, 0);
 
-                    val += pixel_weights->weights[i] * frame->avf->data[plane][x_mv + y_mv * frame->avf->linesize[plane]];
-                }
+                weight_sum = ALPHA_MAX;
+            }
+
+            for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
+                int val = pixel_acc->val[plane];
+
+                if ((plane == 1 || plane == 2) && !chroma)
+                    continue;
 
                 val = ROUNDED_DIV(val, weight_sum);
 
-                if (chroma)
+                if (plane == 1 || plane == 2)
                     avf_out->data[plane][(x >> mi_ctx->log2_chroma_w) + (y >> mi_ctx->log2_chroma_h) * avf_out->linesize[plane]] = val;
                 else
                     avf_out->data[plane][x + y * avf_out->linesize[plane]] = val;
             }
-    }
+        }
 }
 
-static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha)
+static void var_size_bmc(MIContext *mi_ctx, MIJob *job, Block *block, int x_mb, int y_mb, int n, int alpha)
 {
     int sb_x, sb_y;
-    int width = mi_ctx->frames[0].avf->width;
-    int height = mi_ctx->frames[0].avf->height;
+    int width = job->width;
+    int height = job->height;
 
     for (sb_y = 0; sb_y < 2; sb_y++)
         for (sb_x = 0; sb_x < 2; sb_x++) {
             Block *sb = &block->subs[sb_x + sb_y * 2];
 
             if (sb->sb)
-                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha);
+                var_size_bmc(mi_ctx, job, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha);
             else {
                 int x, y;
                 int mv_x = sb->mvs[0][0] * 2;
@@ -994,15 +1137,13 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
                 int end_x = start_x + (1 << (n - 1));
                 int end_y = start_y + (1 << (n - 1));
 
-                for (y = start_y; y < end_y; y++)  {
+                for (y = FFMAX(start_y, job->y_start); y < FFMIN(end_y, job->y_end); y++)  {
                     int y_min = -y;
                     int y_max = height - y - 1;
                     for (x = start_x; x < end_x; x++) {
                         int x_min = -x;
                         int x_max = width - x - 1;
-                        PixelMVS *pixel_mvs = &mi_ctx->pixel_mvs[x + y * width];
-                        PixelWeights *pixel_weights = &mi_ctx->pixel_weights[x + y * width];
-                        PixelRefs *pixel_refs = &mi_ctx->pixel_refs[x + y * width];
+                        PixelAcc *pixel_acc = &job->pixel_acc[x + y * width];
 
                         ADD_PIXELS(PX_WEIGHT_MAX, mv_x, mv_y);
                     }
@@ -1011,11 +1152,11 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
         }
 }
 
-static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha)
+static void bilateral_obmc(MIContext *mi_ctx, MIJob *job, Block *block, int mb_x, int mb_y, int alpha)
 {
     int x, y;
-    int width = mi_ctx->frames[0].avf->width;
-    int height = mi_ctx->frames[0].avf->height;
+    int width = job->width;
+    int height = job->height;
 
     Block *nb;
     int nb_x, nb_y;
@@ -1026,6 +1167,17 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     int start_x, start_y;
     int startc_x, startc_y, endc_x, endc_y;
 
+    start_x = (mb_x << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
+    start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
+
+    startc_x = av_clip(start_x, 0, width - 1);
+    startc_y = FFMAX(av_clip(start_y, 0, height - 1), job->y_start);
+    endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
+    endc_y = FFMIN(av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1), job->y_end);
+
+    if (startc_y >= endc_y)
+        return;
+
     if (mi_ctx->mc_mode == MC_MODE_AOBMC)
         for (nb_y = FFMAX(0, mb_y - 1); nb_y < FFMIN(mb_y + 2, mi_ctx->b_height); nb_y++)
             for (nb_x = FFMAX(0, mb_x - 1); nb_x < FFMIN(mb_x + 2, mi_ctx->b_width); nb_x++) {
@@ -1033,17 +1185,9 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
                 int y_nb = nb_y << mi_ctx->log2_mb_size;
 
                 if (nb_x - mb_x || nb_y - mb_y)
-                    sbads[nb_x - mb_x + 1 + (nb_y - mb_y + 1) * 3] = get_sbad(&mi_ctx->me_ctx, x_nb, y_nb, x_nb + block->mvs[0][0], y_nb + block->mvs[0][1]);
+                    sbads[nb_x - mb_x + 1 + (nb_y - mb_y + 1) * 3] = get_sbad(&job->win->me_ctx, x_nb, y_nb, x_nb + block->mvs[0][0], y_nb + block->mvs[0][1]);
             }
 
-    start_x = (mb_x << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
-    start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
-
-    startc_x = av_clip(start_x, 0, width - 1);
-    startc_y = av_clip(start_y, 0, height - 1);
-    endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
-
     for (y = startc_y; y < endc_y; y++) {
         int y_min = -y;
         int y_max = height - y - 1;
@@ -1051,9 +1195,7 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
             int x_min = -x;
             int x_max = width - x - 1;
             int obmc_weight = obmc_tab_linear[4 - mi_ctx->log2_mb_size][(x - start_x) + ((y - start_y) << (mi_ctx->log2_mb_size + 1))];
-            PixelMVS *pixel_mvs = &mi_ctx->pixel_mvs[x + y * width];
-            PixelWeights *pixel_weights = &mi_ctx->pixel_weights[x + y * width];
-            PixelRefs *pixel_refs = &mi_ctx->pixel_refs[x + y * width];
+            PixelAcc *pixel_acc = &job->pixel_acc[x + y * width];
 
             if (mi_ctx->mc_mode == MC_MODE_AOBMC) {
                 nb_x = (((x - start_x) >> (mi_ctx->log2_mb_size - 1)) * 2 - 3) / 2;
@@ -1061,7 +1203,7 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
 
                 if (nb_x || nb_y) {
                     uint64_t sbad = sbads[nb_x + 1 + (nb_y + 1) * 3];
-                    nb = &mi_ctx->int_blocks[mb_x + nb_x + (mb_y + nb_y) * mi_ctx->b_width];
+                    nb = &job->win->int_blocks[mb_x + nb_x + (mb_y + nb_y) * mi_ctx->b_width];
 
                     if (sbad && sbad != UINT64_MAX && nb->sbad != UINT64_MAX) {
                         int phi = av_clip(ALPHA_MAX * nb->sbad / sbad, 0, ALPHA_MAX);
@@ -1075,11 +1217,13 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     }
 }
 
-static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
+static void interpolate(AVFilterContext *ctx, MIJob *job, AVFrame *avf_out)
 {
-    AVFilterContext *ctx = inlink->dst;
+    AVFilterLink *inlink = ctx->inputs[0];
     AVFilterLink *outlink = ctx->outputs[0];
     MIContext *mi_ctx = ctx->priv;
+    AVFrame *ref1 = job->ref[1];
+    AVFrame *ref2 = job->ref[2];
     int x, y;
     int plane, alpha;
     int64_t pts;
@@ -1087,85 +1231,208 @@ static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
     pts = av_rescale(avf_out->pts, (int64_t) ALPHA_MAX * outlink->time_base.num * inlink->time_base.den,
                                    (int64_t)             outlink->time_base.den * inlink->time_base.num);
 
-    alpha = (pts - mi_ctx->frames[1].avf->pts * ALPHA_MAX) / (mi_ctx->frames[2].avf->pts - mi_ctx->frames[1].avf->pts);
+    alpha = (pts - ref1->pts * ALPHA_MAX) / (ref2->pts - ref1->pts);
     alpha = av_clip(alpha, 0, ALPHA_MAX);
 
+    /* whole frame copies are done by the first slice */
     if (alpha == 0 || alpha == ALPHA_MAX) {
-        av_frame_copy(avf_out, alpha ? mi_ctx->frames[2].avf : mi_ctx->frames[1].avf);
+        if (!job->y_start)
+            av_frame_copy(avf_out, alpha ? ref2 : ref1);
         return;
     }
 
-    if (mi_ctx->scene_changed) {
-        av_log(ctx, AV_LOG_DEBUG, "scene changed, input pts %"PRId64"\n", mi_ctx->frames[1].avf->pts);
+    if (job->win->scene_changed) {
+        if (job->y_start)
+            return;
+        av_log(ctx, AV_LOG_DEBUG, "scene changed, input pts %"PRId64"\n", ref1->pts);
         /* duplicate frame */
-        av_frame_copy(avf_out, alpha > ALPHA_MAX / 2 ? mi_ctx->frames[2].avf : mi_ctx->frames[1].avf);
+        av_frame_copy(avf_out, alpha > ALPHA_MAX / 2 ? ref2 : ref1);
         return;
     }
 
     switch(mi_ctx->mi_mode) {
         case MI_MODE_DUP:
-            av_frame_copy(avf_out, alpha > ALPHA_MAX / 2 ? mi_ctx->frames[2].avf : mi_ctx->frames[1].avf);
+            if (!job->y_start)
+                av_frame_copy(avf_out, alpha > ALPHA_MAX / 2 ? ref2 : ref1);
 
             break;
         case MI_MODE_BLEND:
             for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
                 int width = avf_out->width;
-                int height = avf_out->height;
+                int y_start = job->y_start;
+                int y_end = job->y_end;
 
                 if (plane == 1 || plane == 2) {
                     width = AV_CEIL_RSHIFT(width, mi_ctx->log2_chroma_w);
-                    height = AV_CEIL_RSHIFT(height, mi_ctx->log2_chroma_h);
+                    y_start = AV_CEIL_RSHIFT(y_start, mi_ctx->log2_chroma_h);
+                    y_end = AV_CEIL_RSHIFT(y_end, mi_ctx->log2_chroma_h);
                 }
 
-                for (y = 0; y < height; y++) {
+                for (y = y_start; y < y_end; y++) {
                     for (x = 0; x < width; x++) {
                         avf_out->data[plane][x + y * avf_out->linesize[plane]] =
-                            (alpha  * mi_ctx->frames[2].avf->data[plane][x + y * mi_ctx->frames[2].avf->linesize[plane]] +
-                             (ALPHA_MAX - alpha) * mi_ctx->frames[1].avf->data[plane][x + y * mi_ctx->frames[1].avf->linesize[plane]] + 512) >> 10;
+                            (alpha  * ref2->data[plane][x + y * ref2->linesize[plane]] +
+                             (ALPHA_MAX - alpha) * ref1->data[plane][x + y * ref1->linesize[plane]] + 512) >> 10;
                     }
                 }
             }
 
             break;
         case MI_MODE_MCI:
+            memset(job->pixel_acc + job->y_start * job->width, 0,
+                   (job->y_end - job->y_start) * job->width * sizeof(*job->pixel_acc));
+
             if (mi_ctx->me_mode == ME_MODE_BIDIR) {
-                bidirectional_obmc(mi_ctx, alpha);
-                set_frame_data(mi_ctx, alpha, avf_out);
+                bidirectional_obmc(mi_ctx, job, alpha);
+                set_frame_data(mi_ctx, job, alpha, avf_out);
 
             } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
                 int mb_x, mb_y;
                 Block *block;
 
-                for (y = 0; y < mi_ctx->frames[0].avf->height; y++)
-                    for (x = 0; x < mi_ctx->frames[0].avf->width; x++)
-                        mi_ctx->pixel_refs[x + y * mi_ctx->frames[0].avf->width].nb = 0;
-
                 for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
                     for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+                        block = &job->win->int_blocks[mb_x + mb_y * mi_ctx->b_width];
 
                         if (block->sb)
-                            var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, alpha);
+                            var_size_bmc(mi_ctx, job, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, alpha);
 
-                        bilateral_obmc(mi_ctx, block, mb_x, mb_y, alpha);
+                        bilateral_obmc(mi_ctx, job, block, mb_x, mb_y, alpha);
 
                     }
 
-                set_frame_data(mi_ctx, alpha, avf_out);
+                set_frame_data(mi_ctx, job, alpha, avf_out);
             }
 
             break;
     }
 }
 
+static int interpolate_job(AVFilterContext *ctx, FFFrameJob *frame_job, int jobnr,
+                           int slicenr, int nb_slices)
+{
+    MIContext *mi_ctx = ctx->priv;
+    const int height = frame_job->in[0]->height;
+    MIJob job = {
+        .ref       = { NULL, frame_job->in[0], frame_job->in[1] },
+        .win       = (MIWindow *)frame_job->priv->data,
+        .width     = frame_job->in[0]->width,
+        .height    = height,
+        .y_start   = height *  slicenr      / nb_slices,
+        .y_end     = height * (slicenr + 1) / nb_slices,
+    };
+
+    if (mi_ctx->pixel_acc)
+        job.pixel_acc = mi_ctx->pixel_acc + (size_t)jobnr * job.width * job.height;
+
+    interpolate(ctx, &job, frame_job->out);
+
+    return 0;
+}
+
+static void free_subs(Block *block)
+{
+    int i;
+
+    if (!block->subs)
+        return;
+    for (i = 0; i < 4; i++)
+        free_subs(&block->subs[i]);
+    av_freep(&block->subs);
+}
+
+/* replaces block->subs with a deep copy of the sub-blocks in use */
+static int copy_subs(Block *block)
+{
+    const Block *subs = block->subs;
+    int i, ret = 0;
+
+    block->subs = NULL;
+    if (!block->sb)
+        return 0;
+    if (!(block->subs = av_memdup(subs, 4 * sizeof(*subs))))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < 4; i++) {
+        if (ret >= 0)
+            ret = copy_subs(&block->subs[i]);
+        else
+            block->subs[i].subs = NULL;
+    }
+
+    return ret;
+}
+
+static void free_window(void *opaque, uint8_t *data)
+{
+    MIWindow *win = (MIWindow *)data;
+    int i;
+
+    if (win->int_blocks)
+        for (i = 0; i < win->b_count; i++)
+            free_subs(&win->int_blocks[i]);
+    av_freep(&win->int_blocks);
+    av_freep(&win->blocks[0]);
+    av_freep(&win->blocks[1]);
+    av_free(win);
+}
+
+static AVBufferRef *get_window(MIContext *mi_ctx)
+{
+    AVBufferRef *buf;
+    MIWindow *win;
+    int i, ret = 0;
+
+    if (!(win = av_mallocz(sizeof(*win))))
+        return NULL;
+    if (!(buf = av_buffer_create((uint8_t *)win, sizeof(*win), free_window, NULL, 0))) {
+        av_free(win);
+        return NULL;
+    }
+
+    win->scene_changed = mi_ctx->scene_changed;
+
+    if (mi_ctx->mi_mode != MI_MODE_MCI || mi_ctx->scene_changed)
+        return buf;
+
+    win->me_ctx = mi_ctx->me_ctx;
+
+    if (mi_ctx->me_mode == ME_MODE_BIDIR) {
+        for (i = 0; i < 2; i++)
+            if (!(win->blocks[i] = av_memdup(mi_ctx->frames[2 - i].blocks, mi_ctx->b_count * sizeof(Block))))
+                ret = AVERROR(ENOMEM);
+    } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
+        if (!(win->int_blocks = av_memdup(mi_ctx->int_blocks, mi_ctx->b_count * sizeof(Block)))) {
+            ret = AVERROR(ENOMEM);
+        } else {
+            win->b_count = mi_ctx->b_count;
+            for (i = 0; i < win->b_count; i++) {
+                if (ret >= 0)
+                    ret = copy_subs(&win->int_blocks[i]);
+                else
+                    win->int_blocks[i].subs = NULL;
+            }
+        }
+    }
+
+    if (ret < 0)
+        av_buffer_unref(&buf);
+    return buf;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *avf_in)
 {
     AVFilterContext *ctx = inlink->dst;
     AVFilterLink *outlink = ctx->outputs[0];
     MIContext *mi_ctx = ctx->priv;
+    AVBufferRef *win = NULL;
     int ret;
 
     if (avf_in->pts == AV_NOPTS_VALUE) {
+        if ((ret = ff_framethread_flush(&mi_ctx->ft)) < 0) {
+            av_frame_free(&avf_in);
+            return ret;
+        }
         ret = ff_filter_frame(ctx->outputs[0], avf_in);
         return ret;
     }
@@ -1188,26 +1455,54 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *avf_in)
     mi_ctx->scene_changed = detect_scene_change(ctx);
 
     for (;;) {
+        AVFrame *refs[2] = { mi_ctx->frames[1].avf, mi_ctx->frames[2].avf };
+        AVBufferRef *priv;
         AVFrame *avf_out;
 
         if (av_compare_ts(mi_ctx->out_pts, outlink->time_base, mi_ctx->frames[2].avf->pts, inlink->time_base) > 0)
             break;
 
-        if (!(avf_out = ff_get_video_buffer(ctx->outputs[0], inlink->w, inlink->h)))
+        if (!win && !(win = get_window(mi_ctx)))
             return AVERROR(ENOMEM);
 
+        if (!(avf_out = ff_get_video_buffer(ctx->outputs[0], inlink->w, inlink->h))) {
+            av_buffer_unref(&win);
+            return AVERROR(ENOMEM);
+        }
+
         av_frame_copy_props(avf_out, mi_ctx->frames[NB_FRAMES - 1].avf);
         avf_out->pts = mi_ctx->out_pts++;
 
-        interpolate(inlink, avf_out);
+        if (!(priv = av_buffer_ref(win))) {
+            av_frame_free(&avf_out);
+            av_buffer_unref(&win);
+            return AVERROR(ENOMEM);
+        }
 
-        if ((ret = ff_filter_frame(ctx->outputs[0], avf_out)) < 0)
+        if ((ret = ff_framethread_add_job(&mi_ctx->ft, avf_out, refs, 2, priv)) < 0) {
+            av_buffer_unref(&win);
             return ret;
+        }
     }
 
+    av_buffer_unref(&win);
     return 0;
 }
 
+static int request_frame(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    MIContext *mi_ctx = ctx->priv;
+    int ret = ff_request_frame(ctx->inputs[0]);
+
+    if (ret == AVERROR_EOF && mi_ctx->ft.nb_jobs) {
+        ret = ff_framethread_flush(&mi_ctx->ft);
+        return ret < 0 ? ret : 0;
+    }
+
+    return ret;
+}
+
 static av_cold void free_blocks(Block *block, int sb)
 {
     if (block->subs)
@@ -1216,14 +1511,38 @@ static av_cold void free_blocks(Block *block, int sb)
         av_freep(&block);
 }
 
+static av_cold int init(AVFilterContext *ctx)
+{
+#if HAVE_THREADS
+    MIContext *mi_ctx = ctx->priv;
+    int ret;
+
+    if ((ret = pthread_mutex_init(&mi_ctx->progress_mutex, NULL)))
+        return AVERROR(ret);
+    if ((ret = pthread_cond_init(&mi_ctx->progress_cond, NULL))) {
+        pthread_mutex_destroy(&mi_ctx->progress_mutex);
+        return AVERROR(ret);
+    }
+    mi_ctx->progress_sync = 1;
+#endif
+
+    return 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     MIContext *mi_ctx = ctx->priv;
     int i, m;
 
-    av_freep(&mi_ctx->pixel_mvs);
-    av_freep(&mi_ctx->pixel_weights);
-    av_freep(&mi_ctx->pixel_refs);
+    ff_framethread_uninit(&mi_ctx->ft);
+    av_freep(&mi_ctx->pixel_acc);
+    av_freep(&mi_ctx->row_progress);
+#if HAVE_THREADS
+    if (mi_ctx->progress_sync) {
+        pthread_mutex_destroy(&mi_ctx->progress_mutex);
+        pthread_cond_destroy(&mi_ctx->progress_cond);
+    }
+#endif
     if (mi_ctx->int_blocks)
         for (m = 0; m < mi_ctx->b_count; m++)
             free_blocks(&mi_ctx->int_blocks[m], 0);
@@ -1254,6 +1573,7 @@ static const AVFilterPad minterpolate_outputs[] = {
         .name          = "default",
         .type          = AVMEDIA_TYPE_VIDEO,
         .config_props  = config_output,
+        .request_frame = request_frame,
     },
     { NULL }
 };
@@ -1263,8 +1583,10 @@ AVFilter ff_vf_minterpolate = {
     .description   = NULL_IF_CONFIG_SMALL("Frame rate conversion using Motion Interpolation."),
     .priv_size     = sizeof(MIContext),
     .priv_class    = &minterpolate_class,
+    .init          = init,
     .uninit        = uninit,
     .query_formats = query_formats,
     .inputs        = minterpolate_inputs,
     .outputs       = minterpolate_outputs,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -37,6 +37,7 @@
 #include "libavutil/timestamp.h"
 #include "internal.h"
 #include "drawutils.h"
+#include "filters.h"
 #include "framesync.h"
 #include "video.h"
 #include "vf_overlay.h"
@@ -82,9 +83,16 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     OverlayContext *s = ctx->priv;
 
+    int i;
+
     ff_framesync_uninit(&s->fs);
     av_expr_free(s->x_pexpr); s->x_pexpr = NULL;
     av_expr_free(s->y_pexpr); s->y_pexpr = NULL;
+    av_frame_free(&s->layer_frame);
+    av_frame_free(&s->dup_frame);
+    av_frame_free(&s->dup_overlay);
+    for (i = 0; i < FF_ARRAY_ELEMS(s->layer); i++)
+        av_freep(&s->layer[i].buf);
 }
 
 static inline int normalize_xy(double d, int chroma_sub)
@@ -865,6 +873,287 @@ static int blend_slice_rgba_pm(AVFilterContext *ctx, void *arg, int jobnr, int n
     return 0;
 }
 
+enum LayerRowType {
+    LAYER_ROW_SKIP,             ///< fully transparent row
+    LAYER_ROW_COPY,             ///< fully opaque row
+    LAYER_ROW_BLEND,
+};
+
+typedef struct LayerRange {
+    int hsub, vsub;
+    int src_wp, src_hp;         ///< size of the overlay plane
+    int xp, yp;                 ///< position of the overlay in the main plane
+    int k0, k1, j0, j1;         ///< range of the overlay samples that are blended
+} LayerRange;
+
+static int blend_layer_row_c(uint8_t *d, const uint16_t *val,
+                             const uint8_t *trans, int w)
+{
+    int x;
+
+    for (x = 0; x < w; x++)
+        d[x] = ((d[x] * trans[x] + val[x]) * 257) >> 16;
+    return w;
+}
+
+av_cold void ff_overlay_layer_init(OverlayContext *s)
+{
+    s->blend_layer_row = blend_layer_row_c;
+
+    if (ARCH_AARCH64)
+        ff_overlay_layer_init_aarch64(s);
+    if (ARCH_X86)
+        ff_overlay_layer_init_x86(s);
+}
+
+/**
+ * Get the range of the overlay samples blended by blend_plane_8_8bits() and
+ * blend_slice_packed_rgb().
+ */
+static void get_layer_range(const OverlayContext *s, const AVFrame *dst,
+                            const AVFrame *src, int hsub, int vsub, LayerRange *r)
+{
+    const int dst_wp = AV_CEIL_RSHIFT(dst->width,  hsub);
+    const int dst_hp = AV_CEIL_RSHIFT(dst->height, vsub);
+
+    r->hsub   = hsub;
+    r->vsub   = vsub;
+    r->src_wp = AV_CEIL_RSHIFT(src->width,  hsub);
+    r->src_hp = AV_CEIL_RSHIFT(src->height, vsub);
+    r->xp     = s->x >> hsub;
+    r->yp     = s->y >> vsub;
+    r->k0     = FFMAX(-r->xp, 0);
+    r->k1     = FFMAX(FFMIN(-r->xp + dst_wp, r->src_wp), r->k0);
+    r->j0     = FFMAX(-r->yp, 0);
+    r->j1     = r->j0 + FFMAX(FFMIN3(-r->yp + dst_hp, FFMIN(r->src_hp, dst_hp),
+                                     r->yp + r->src_hp), 0);
+}
+
+/**
+ * Get the component of the main frame on which plane i of a planar overlay
+ * is blended.
+ */
+static const AVComponentDescriptor *get_layer_comp(const OverlayContext *s, int i)
+{
+    if (s->format == OVERLAY_FORMAT_GBRP)
+        return &s->main_desc->comp[(i + 1) % 3];
+    return &s->main_desc->comp[i];
+}
+
+static int alloc_layer(OverlayContext *s, const AVFrame *dst, const AVFrame *src)
+{
+    int i;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(s->layer); i++)
+        s->layer[i].h = 0;
+
+    for (i = 0; i < (s->format == OVERLAY_FORMAT_RGB ? 1 : 3); i++) {
+        const int hsub = i ? s->hsub : 0, vsub = i ? s->vsub : 0;
+        const int plane = s->format == OVERLAY_FORMAT_RGB ? 0 : get_layer_comp(s, i)->plane;
+        const int step  = s->main_pix_step[plane];
+        OverlayLayer *l = &s->layer[plane];
+        LayerRange r;
+        size_t size;
+
+        get_layer_range(s, dst, src, hsub, vsub, &r);
+        l->x = (r.xp + r.k0) * step;
+        l->y =  r.yp + r.j0;
+        l->w = (r.k1 - r.k0) * step;
+        l->h =  r.j1 - r.j0;
+
+        size = (size_t)l->w * l->h;
+        av_fast_malloc(&l->buf, &l->buf_size, 4 * size + l->h);
+        if (!l->buf)
+            return AVERROR(ENOMEM);
+        l->val   = (uint16_t *)l->buf;
+        l->trans = l->buf   + 2 * size;
+        l->color = l->trans + size;
+        l->rows  = l->color + size;
+    }
+    return 0;
+}
+
+static void build_layer_plane(OverlayContext *s, const AVFrame *dst, const AVFrame *src,
+                              int i, int jobnr, int nb_jobs)
+{
+    const AVComponentDescriptor *comp = get_layer_comp(s, i);
+    OverlayLayer *l = &s->layer[comp->plane];
+    const ptrdiff_t alinesize = src->linesize[3];
+    int j, k, hsub, vsub, slice_start, slice_end;
+    LayerRange r;
+
+    get_layer_range(s, dst, src, i ? s->hsub : 0, i ? s->vsub : 0, &r);
+    hsub = r.hsub;
+    vsub = r.vsub;
+    slice_start = r.j0 + ((r.j1 - r.j0) *  jobnr)      / nb_jobs;
+    slice_end   = r.j0 + ((r.j1 - r.j0) * (jobnr + 1)) / nb_jobs;
+
+    for (j = slice_start; j < slice_end; j++) {
+        const uint8_t *sp = src->data[i] + j * src->linesize[i];
+        const uint8_t *ap = src->data[3] + (j << vsub) * alinesize;
+        int off = (j - r.j0) * l->w + comp->offset;
+
+        for (k = r.k0; k < r.k1; k++, off += comp->step) {
+            const uint8_t *a = ap + (k << hsub);
+            int alpha_v, alpha_h, alpha;
+
+            /* same alpha as blend_plane_8_8bits() */
+            if (hsub && vsub && j + 1 < r.src_hp && k + 1 < r.src_wp) {
+                alpha = (a[0] + a[alinesize] + a[1] + a[alinesize + 1]) >> 2;
+            } else if (hsub || vsub) {
+                alpha_h = hsub && k + 1 < r.src_wp ? (a[0] + a[1]) >> 1 : a[0];
+                alpha_v = vsub && j + 1 < r.src_hp ? (a[0] + a[alinesize]) >> 1 : a[0];
+                alpha = (alpha_v + alpha_h) >> 1;
+            } else
+                alpha = a[0];
+
+            l->val[off]   = sp[k] * alpha + 128;
+            l->trans[off] = 255 - alpha;
+            l->color[off] = sp[k];
+        }
+    }
+}
+
+static void build_layer_packed_rgb(OverlayContext *s, const AVFrame *dst, const AVFrame *src,
+                                   int jobnr, int nb_jobs)
+{
+    OverlayLayer *l = &s->layer[0];
+    const int dstep = s->main_pix_step[0];
+    const int sstep = s->overlay_pix_step[0];
+    const int sa = s->overlay_rgba_map[A];
+    int c, j, k, slice_start, slice_end;
+    LayerRange r;
+
+    get_layer_range(s, dst, src, 0, 0, &r);
+    slice_start = r.j0 + ((r.j1 - r.j0) *  jobnr)      / nb_jobs;
+    slice_end   = r.j0 + ((r.j1 - r.j0) * (jobnr + 1)) / nb_jobs;
+
+    for (j = slice_start; j < slice_end; j++) {
+        const uint8_t *S = src->data[0] + j * src->linesize[0] + r.k0 * sstep;
+        int off = (j - r.j0) * l->w;
+
+        for (k = r.k0; k < r.k1; k++, off += dstep, S += sstep) {
+            const int alpha = S[sa];
+
+            for (c = R; c <= B; c++) {
+                const int o = off + s->main_rgba_map[c];
+                const uint8_t v = S[s->overlay_rgba_map[c]];
+
+                l->val[o]   = v * alpha + 128;
+                l->trans[o] = 255 - alpha;
+                l->color[o] = v;
+            }
+        }
+    }
+}
+
+static int build_layer_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int i, j, x;
+
+    if (s->format == OVERLAY_FORMAT_RGB) {
+        build_layer_packed_rgb(s, td->dst, td->src, jobnr, nb_jobs);
+    } else {
+        for (i = 0; i < 3; i++)
+            build_layer_plane(s, td->dst, td->src, i, jobnr, nb_jobs);
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(s->layer); i++) {
+        OverlayLayer *l = &s->layer[i];
+        const int slice_start = (l->h *  jobnr)      / nb_jobs;
+        const int slice_end   = (l->h * (jobnr + 1)) / nb_jobs;
+
+        for (j = slice_start; j < slice_end; j++) {
+            const uint8_t *trans = l->trans + j * l->w;
+            int opaque = 1, transparent = 1;
+
+            for (x = 0; x < l->w && (opaque || transparent); x++) {
+                opaque      &= trans[x] == 0;
+                transparent &= trans[x] == 255;
+            }
+            l->rows[j] = transparent ? LAYER_ROW_SKIP  :
+                         opaque      ? LAYER_ROW_COPY  : LAYER_ROW_BLEND;
+        }
+    }
+    return 0;
+}
+
+static int blend_layer_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    OverlayContext *s = ctx->priv;
+    ThreadData *td = arg;
+    int i, j, c;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(s->layer); i++) {
+        const OverlayLayer *l = &s->layer[i];
+        const int slice_start = (l->h *  jobnr)      / nb_jobs;
+        const int slice_end   = (l->h * (jobnr + 1)) / nb_jobs;
+
+        for (j = slice_start; j < slice_end; j++) {
+            uint8_t *d = td->dst->data[i] + (l->y + j) * td->dst->linesize[i] + l->x;
+            const ptrdiff_t off = (ptrdiff_t)j * l->w;
+
+            switch (l->rows[j]) {
+            case LAYER_ROW_COPY:
+                memcpy(d, l->color + off, l->w);
+                break;
+            case LAYER_ROW_BLEND:
+                c = s->blend_layer_row(d, l->val + off, l->trans + off, l->w);
+                blend_layer_row_c(d + c, l->val + off + c, l->trans + off + c, l->w - c);
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Build the blending layer when the same overlay frame is blended again at
+ * the same position.
+ *
+ * @return 1 if the layer can be blended, 0 if the overlay has to be blended
+ *         directly, a negative AVERROR code on failure
+ */
+static int update_layer(AVFilterContext *ctx, AVFrame *mainpic, AVFrame *second)
+{
+    OverlayContext *s = ctx->priv;
+    AVFrame *prev = s->layer_frame;
+    ThreadData td;
+    int ret;
+
+    if (!prev->buf[0] || prev->width != second->width || prev->height != second->height ||
+        memcmp(prev->data, second->data, sizeof(second->data))) {
+        /* keeping a reference guarantees the buffers are not reused */
+        av_frame_unref(prev);
+        s->layer_valid = 0;
+        s->layer_pos_x = s->x;
+        s->layer_pos_y = s->y;
+        ret = av_frame_ref(prev, second);
+        return ret < 0 ? ret : 0;
+    }
+
+    if (s->layer_pos_x != s->x || s->layer_pos_y != s->y) {
+        s->layer_valid = 0;
+        s->layer_pos_x = s->x;
+        s->layer_pos_y = s->y;
+        return 0;
+    }
+    if (s->layer_valid)
+        return 1;
+
+    if ((ret = alloc_layer(s, mainpic, second)) < 0)
+        return ret;
+
+    td.dst = mainpic;
+    td.src = second;
+    ctx->internal->execute(ctx, build_layer_slice, &td, NULL,
+                           FFMIN(FFMAX(s->layer[0].h, 1), ff_filter_get_nb_threads(ctx)));
+    s->layer_valid = 1;
+    return 1;
+}
+
 static int config_input_main(AVFilterLink *inlink)
 {
     OverlayContext *s = inlink->dst->priv;
@@ -986,9 +1275,37 @@ end:
         ff_overlay_init_x86(s, s->format, inlink->format,
                             s->alpha_format, s->main_has_alpha);
 
+    /* the layer is only implemented for the 8-bit straight alpha blending */
+    s->layer_supported = s->cache && !s->alpha_format && !s->main_has_alpha &&
+                         s->format != OVERLAY_FORMAT_YUV420P10 &&
+                         s->format != OVERLAY_FORMAT_YUV422P10 &&
+                         s->format != OVERLAY_FORMAT_AUTO;
+    if (s->layer_supported) {
+        if (!s->layer_frame && !(s->layer_frame = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+        ff_overlay_layer_init(s);
+    }
+
     return 0;
 }
 
+/**
+ * Check whether blending second on a duplicate of the previous main frame
+ * gives the previous output again.
+ */
+static int same_output(OverlayContext *s, const AVFrame *second)
+{
+    const AVFrame *prev = s->dup_overlay;
+
+    if (!s->dup_frame->buf[0])
+        return 0;
+    if (!second || !prev->buf[0])
+        return !second && !prev->buf[0];
+    return prev->width == second->width && prev->height == second->height &&
+           !memcmp(prev->data, second->data, sizeof(second->data)) &&
+           s->dup_x == s->x && s->dup_y == s->y;
+}
+
 static int do_blend(FFFrameSync *fs)
 {
     AVFilterContext *ctx = fs->parent;
@@ -997,13 +1314,11 @@ static int do_blend(FFFrameSync *fs)
     AVFilterLink *inlink = ctx->inputs[0];
     int ret;
 
-    ret = ff_framesync_dualinput_get_writable(fs, &mainpic, &second);
+    ret = ff_framesync_dualinput_get(fs, &mainpic, &second);
     if (ret < 0)
         return ret;
-    if (!second)
-        return ff_filter_frame(ctx->outputs[0], mainpic);
 
-    if (s->eval_mode == EVAL_MODE_FRAME) {
+    if (second && s->eval_mode == EVAL_MODE_FRAME) {
         int64_t pos = mainpic->pkt_pos;
 
         s->var_values[VAR_N] = inlink->frame_count_out;
@@ -1023,14 +1338,60 @@ static int do_blend(FFFrameSync *fs)
                s->var_values[VAR_Y], s->y);
     }
 
-    if (s->x < mainpic->width  && s->x + second->width  >= 0 &&
+    if (mainpic->flags & AV_FRAME_FLAG_DUPLICATE) {
+        if (s->dup_frame && same_output(s, second)) {
+            ret = ff_filter_frame_duplicate(ctx->outputs[0], s->dup_frame, mainpic);
+            av_frame_free(&mainpic);
+            return ret;
+        }
+        if (!s->dup_frame) {
+            s->dup_frame   = av_frame_alloc();
+            s->dup_overlay = av_frame_alloc();
+            if (!s->dup_frame || !s->dup_overlay) {
+                av_frame_free(&mainpic);
+                return AVERROR(ENOMEM);
+            }
+        }
+    }
+    /* the previous output may not be known or may differ */
+    mainpic->flags &= ~AV_FRAME_FLAG_DUPLICATE;
+
+    if (second &&
+        s->x < mainpic->width  && s->x + second->width  >= 0 &&
         s->y < mainpic->height && s->y + second->height >= 0) {
         ThreadData td;
 
+        ret = ff_inlink_make_frame_writable(inlink, &mainpic);
+        if (ret < 0) {
+            av_frame_free(&mainpic);
+            return ret;
+        }
+
         td.dst = mainpic;
         td.src = second;
-        ctx->internal->execute(ctx, s->blend_slice, &td, NULL, FFMIN(FFMAX(1, FFMIN3(s->y + second->height, FFMIN(second->height, mainpic->height), mainpic->height - s->y)),
-                                                                     ff_filter_get_nb_threads(ctx)));
+        ret = s->layer_supported ? update_layer(ctx, mainpic, second) : 0;
+        if (ret < 0) {
+            av_frame_free(&mainpic);
+            return ret;
+        } else if (ret) {
+            ctx->internal->execute(ctx, blend_layer_slice, &td, NULL,
+                                   FFMIN(FFMAX(s->layer[0].h, 1), ff_filter_get_nb_threads(ctx)));
+        } else {
+            ctx->internal->execute(ctx, s->blend_slice, &td, NULL, FFMIN(FFMAX(1, FFMIN3(s->y + second->height, FFMIN(second->height, mainpic->height), mainpic->height - s->y)),
+                                                                         ff_filter_get_nb_threads(ctx)));
+        }
+    }
+
+    if (s->dup_frame) {
+        av_frame_unref(s->dup_frame);
+        av_frame_unref(s->dup_overlay);
+        s->dup_x = s->x;
+        s->dup_y = s->y;
+        if ((ret = av_frame_ref(s->dup_frame, mainpic)) < 0 ||
+            (second && (ret = av_frame_ref(s->dup_overlay, second)) < 0)) {
+            av_frame_free(&mainpic);
+            return ret;
+        }
     }
     return ff_filter_frame(ctx->outputs[0], mainpic);
 }
@@ -1078,6 +1439,7 @@ static const AVOption overlay_options[] = {
     { "alpha", "alpha format", OFFSET(alpha_format), AV_OPT_TYPE_INT, {.i64=0}, 0, 1, FLAGS, "alpha_format" },
         { "straight",      "", 0, AV_OPT_TYPE_CONST, {.i64=0}, .flags = FLAGS, .unit = "alpha_format" },
         { "premultiplied", "", 0, AV_OPT_TYPE_CONST, {.i64=1}, .flags = FLAGS, .unit = "alpha_format" },
+    { "cache", "cache the blending of a repeated overlay frame", OFFSET(cache), AV_OPT_TYPE_BOOL, {.i64=1}, 0, 1, FLAGS },
     { NULL }
 };
 
@@ -1121,4 +1483,5 @@ AVFilter ff_vf_overlay = {
     .outputs       = avfilter_vf_overlay_outputs,
     .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_INTERNAL |
                      AVFILTER_FLAG_SLICE_THREADS,
+    .flags_internal = FF_FILTER_FLAG_DUPLICATE_AWARE,
 };
@@ -51,6 +51,22 @@ enum OverlayFormat {
     OVERLAY_FORMAT_NB
 };
 
+/**
+ * Blending layer of an overlay frame for one plane of the main frame,
+ * precomputed for straight alpha so that blending a main byte d is
+ * d = ((d * trans + val) * 257) >> 16.
+ */
+typedef struct OverlayLayer {
+    int x, y;                   ///< position of the layer in bytes and rows
+    int w, h;                   ///< size of the layer in bytes and rows
+    uint16_t *val;              ///< overlay * alpha + 128
+    uint8_t *trans;             ///< 255 - alpha
+    uint8_t *color;             ///< overlay, copied as is on the opaque rows
+    uint8_t *rows;              ///< LAYER_ROW_* type of each row
+    uint8_t *buf;
+    unsigned int buf_size;
+} OverlayLayer;
+
 typedef struct OverlayContext {
     const AVClass *class;
     int x, y;                   ///< position of overlaid picture
@@ -80,9 +96,31 @@ typedef struct OverlayContext {
     int (*blend_row[4])(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a, int w,
                         ptrdiff_t alinesize);
     int (*blend_slice)(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs);
+
+    int cache;                  ///< cache the blending layer of repeated overlay frames
+    int layer_supported;        ///< the formats and alpha mode allow a layer
+    AVFrame *layer_frame;       ///< reference to the last overlay frame
+    int layer_valid;            ///< the layer is built from layer_frame
+    int layer_pos_x, layer_pos_y;
+    OverlayLayer layer[4];
+
+    /**
+     * Blend w bytes of a layer row into d, see OverlayLayer.
+     * @return the number of bytes processed, the caller blends the rest
+     */
+    int (*blend_layer_row)(uint8_t *d, const uint16_t *val,
+                           const uint8_t *trans, int w);
+
+    AVFrame *dup_frame;         ///< last output, resent for duplicate main frames
+    AVFrame *dup_overlay;       ///< overlay frame blended on dup_frame, if any
+    int dup_x, dup_y;           ///< position of dup_overlay
 } OverlayContext;
 
 void ff_overlay_init_x86(OverlayContext *s, int format, int pix_format,
                          int alpha_format, int main_has_alpha);
 
+void ff_overlay_layer_init(OverlayContext *s);
+void ff_overlay_layer_init_aarch64(OverlayContext *s);
+void ff_overlay_layer_init_x86(OverlayContext *s);
+
 #endif /* AVFILTER_OVERLAY_H */
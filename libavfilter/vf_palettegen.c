@@ -49,6 +49,7 @@ struct range_box {
 struct hist_node {
     struct color_ref *entries;
     int nb_entries;
+    int nb_allocated;
 };
 
 enum {
@@ -61,15 +62,34 @@ enum {
 #define NBITS 5
 #define HIST_SIZE (1<<(3*NBITS))
 
+/* Color histogram, with the list of its non-empty buckets */
+struct histogram {
+    struct hist_node nodes[HIST_SIZE];
+    uint16_t used[HIST_SIZE];   // indexes of the non-empty nodes, unordered
+    int nb_used;
+    int nb_refs;                // number of different colors
+};
+
+typedef struct ThreadData {
+    const AVFrame *f1, *f2;
+    struct histogram *hists;
+} ThreadData;
+
 typedef struct PaletteGenContext {
     const AVClass *class;
 
     int max_colors;
     int reserve_transparent;
     int stats_mode;
+    int precision;
 
     AVFrame *prev_frame;                    // previous frame used for the diff stats_mode
-    struct hist_node histogram[HIST_SIZE];  // histogram/hashtable of the colors
+    struct histogram histogram;             // histogram/hashtable of the colors
+    struct histogram *slice_hists;          // per-job histograms, merged into the main one after each frame
+    int *jobs_rets;
+    int nb_slice_hists;
+    int shift;                              // number of dropped bits per color component
+    uint32_t color_mask, color_round;       // reduce the colors to the histogram precision
     struct color_ref **refs;                // references of all the colors used in the stream
     int nb_refs;                            // number of color references (or number of different colors)
     struct range_box boxes[256];            // define the segmentation of the colorspace (the final palette)
@@ -88,6 +108,7 @@ static const AVOption palettegen_options[] = {
         { "full", "compute full frame histograms", 0, AV_OPT_TYPE_CONST, {.i64=STATS_MODE_ALL_FRAMES}, INT_MIN, INT_MAX, FLAGS, "mode" },
         { "diff", "compute histograms only for the part that differs from previous frame", 0, AV_OPT_TYPE_CONST, {.i64=STATS_MODE_DIFF_FRAMES}, INT_MIN, INT_MAX, FLAGS, "mode" },
         { "single", "compute new histogram for each frame", 0, AV_OPT_TYPE_CONST, {.i64=STATS_MODE_SINGLE_FRAMES}, INT_MIN, INT_MAX, FLAGS, "mode" },
+    { "precision", "set the number of bits per color component used in the histogram", OFFSET(precision), AV_OPT_TYPE_INT, {.i64=8}, 4, 8, FLAGS },
     { NULL }
 };
 
@@ -257,12 +278,17 @@ static void write_palette(AVFilterContext *ctx, AVFrame *out)
     }
 }
 
+static int cmp_node(const void *a, const void *b)
+{
+    return *(const uint16_t *)a - *(const uint16_t *)b;
+}
+
 /**
  * Crawl the histogram to get all the defined colors, and create a linear list
  * of them (each color reference entry is a pointer to the value in the
  * histogram/hash table).
  */
-static struct color_ref **load_color_refs(const struct hist_node *hist, int nb_refs)
+static struct color_ref **load_color_refs(struct histogram *hist, int nb_refs)
 {
     int i, j, k = 0;
     struct color_ref **refs = av_malloc_array(nb_refs, sizeof(*refs));
@@ -270,8 +296,10 @@ static struct color_ref **load_color_refs(const struct hist_node *hist, int nb_r
     if (!refs)
         return NULL;
 
-    for (j = 0; j < HIST_SIZE; j++) {
-        const struct hist_node *node = &hist[j];
+    /* only visit the used nodes, in the order of the hash table */
+    AV_QSORT(hist->used, hist->nb_used, uint16_t, cmp_node);
+    for (j = 0; j < hist->nb_used; j++) {
+        const struct hist_node *node = &hist->nodes[hist->used[j]];
 
         for (i = 0; i < node->nb_entries; i++)
             refs[k++] = &node->entries[i];
@@ -303,7 +331,8 @@ static AVFrame *get_palette_frame(AVFilterContext *ctx)
     struct range_box *box;
 
     /* reference only the used colors from histogram */
-    s->refs = load_color_refs(s->histogram, s->nb_refs);
+    av_freep(&s->refs);
+    s->refs = load_color_refs(&s->histogram, s->nb_refs);
     if (!s->refs) {
         av_log(ctx, AV_LOG_ERROR, "Unable to allocate references for %d different colors\n", s->nb_refs);
         return NULL;
@@ -317,6 +346,7 @@ static AVFrame *get_palette_frame(AVFilterContext *ctx)
 
     /* set first box for 0..nb_refs */
     box = &s->boxes[box_id];
+    box->start = 0;
     box->len = s->nb_refs;
     box->sorted_by = -1;
     box->color = get_avg_color(s->refs, box);
@@ -391,119 +421,207 @@ static AVFrame *get_palette_frame(AVFilterContext *ctx)
 
 /**
  * Hashing function for the color.
- * It keeps the NBITS least significant bit of each component to make it
- * "random" even if the scene doesn't have much different colors.
+ * It keeps the NBITS least significant bit of each component (above the
+ * dropped ones) to make it "random" even if the scene doesn't have much
+ * different colors.
  */
-static inline unsigned color_hash(uint32_t color)
+static inline unsigned color_hash(uint32_t color, int shift)
 {
-    const uint8_t r = color >> 16 & ((1<<NBITS)-1);
-    const uint8_t g = color >>  8 & ((1<<NBITS)-1);
-    const uint8_t b = color       & ((1<<NBITS)-1);
+    const uint8_t r = color >> (16 + shift) & ((1<<NBITS)-1);
+    const uint8_t g = color >> ( 8 + shift) & ((1<<NBITS)-1);
+    const uint8_t b = color >>       shift  & ((1<<NBITS)-1);
     return r<<(NBITS*2) | g<<NBITS | b;
 }
 
 /**
- * Locate the color in the hash table and increment its counter.
+ * Locate the color in the hash table and add count to its counter.
+ *
+ * @return 1 if the color was not in the histogram yet, 0 if it was, or a
+ *         negative AVERROR code
  */
-static int color_inc(struct hist_node *hist, uint32_t color)
+static int color_add(struct histogram *hist, unsigned hash,
+                     uint32_t color, uint64_t count)
 {
     int i;
-    const unsigned hash = color_hash(color);
-    struct hist_node *node = &hist[hash];
+    struct hist_node *node = &hist->nodes[hash];
     struct color_ref *e;
 
     for (i = 0; i < node->nb_entries; i++) {
         e = &node->entries[i];
         if (e->color == color) {
-            e->count++;
+            e->count += count;
             return 0;
         }
     }
 
-    e = av_dynarray2_add((void**)&node->entries, &node->nb_entries,
-                         sizeof(*node->entries), NULL);
-    if (!e)
-        return AVERROR(ENOMEM);
+    if (node->nb_entries == node->nb_allocated) {
+        const int nb_allocated = FFMAX(2 * node->nb_allocated, 4);
+        e = av_realloc_array(node->entries, nb_allocated, sizeof(*node->entries));
+        if (!e)
+            return AVERROR(ENOMEM);
+        node->entries      = e;
+        node->nb_allocated = nb_allocated;
+    }
+    if (!node->nb_entries)
+        hist->used[hist->nb_used++] = hash;
+    e = &node->entries[node->nb_entries++];
     e->color = color;
-    e->count = 1;
+    e->count = count;
+    hist->nb_refs++;
     return 1;
 }
 
 /**
- * Update histogram when pixels differ from previous frame.
+ * Empty the histogram, keeping its allocated entries for reuse.
  */
-static int update_histogram_diff(struct hist_node *hist,
-                                 const AVFrame *f1, const AVFrame *f2)
+static void reset_histogram(struct histogram *hist)
 {
-    int x, y, ret, nb_diff_colors = 0;
+    int i;
 
-    for (y = 0; y < f1->height; y++) {
-        const uint32_t *p = (const uint32_t *)(f1->data[0] + y*f1->linesize[0]);
-        const uint32_t *q = (const uint32_t *)(f2->data[0] + y*f2->linesize[0]);
+    for (i = 0; i < hist->nb_used; i++)
+        hist->nodes[hist->used[i]].nb_entries = 0;
+    hist->nb_used = 0;
+    hist->nb_refs = 0;
+}
 
-        for (x = 0; x < f1->width; x++) {
-            if (p[x] == q[x])
-                continue;
-            ret = color_inc(hist, p[x]);
+/**
+ * Add the colors of a histogram into another one. The colors new to dst are
+ * appended in the order they were first seen in src, so that merging the
+ * histograms of consecutive slices results in the same histogram as a single
+ * pass over the whole frame. src is emptied.
+ */
+static int merge_histogram(struct histogram *dst, struct histogram *src)
+{
+    int i, j, ret;
+
+    for (i = 0; i < src->nb_used; i++) {
+        const unsigned hash = src->used[i];
+        const struct hist_node *node = &src->nodes[hash];
+
+        for (j = 0; j < node->nb_entries; j++) {
+            const struct color_ref *e = &node->entries[j];
+            ret = color_add(dst, hash, e->color, e->count);
             if (ret < 0)
                 return ret;
-            nb_diff_colors += ret;
         }
     }
-    return nb_diff_colors;
+    reset_histogram(src);
+    return 0;
 }
 
 /**
- * Simple histogram of the frame.
+ * Update the histogram of the job with a slice of f1. If f2 is set, only the
+ * pixels that differ from it are accounted. Runs of identical pixels are
+ * accounted at once.
  */
-static int update_histogram_frame(struct hist_node *hist, const AVFrame *f)
+static int update_histogram_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    int x, y, ret, nb_diff_colors = 0;
+    const PaletteGenContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *f1 = td->f1, *f2 = td->f2;
+    struct histogram *hist = &td->hists[jobnr];
+    const int slice_start = (f1->height *  jobnr   ) / nb_jobs;
+    const int slice_end   = (f1->height * (jobnr+1)) / nb_jobs;
+    const int w = f1->width;
+    int x, y, ret;
+
+    for (y = slice_start; y < slice_end; y++) {
+        const uint32_t *p = (const uint32_t *)(f1->data[0] + y*f1->linesize[0]);
+        const uint32_t *q = f2 ? (const uint32_t *)(f2->data[0] + y*f2->linesize[0]) : NULL;
+
+        for (x = 0; x < w; ) {
+            const uint32_t px = p[x];
+            uint32_t color;
+            int run = 1;
 
-    for (y = 0; y < f->height; y++) {
-        const uint32_t *p = (const uint32_t *)(f->data[0] + y*f->linesize[0]);
+            if (q && px == q[x]) {
+                x++;
+                continue;
+            }
+            while (x + run < w && p[x + run] == px && !(q && q[x + run] == px))
+                run++;
+            x += run;
 
-        for (x = 0; x < f->width; x++) {
-            ret = color_inc(hist, p[x]);
+            color = (px & s->color_mask) | s->color_round;
+            ret = color_add(hist, color_hash(color, s->shift), color, run);
             if (ret < 0)
                 return ret;
-            nb_diff_colors += ret;
         }
     }
-    return nb_diff_colors;
+    return 0;
+}
+
+/**
+ * Update the histogram with f1, or with the part of it that differs from f2
+ * if set. The frame is split in slices, each accounted in its own histogram,
+ * which are then merged in order into the main one.
+ */
+static int update_histogram(AVFilterContext *ctx, const AVFrame *f1, const AVFrame *f2)
+{
+    PaletteGenContext *s = ctx->priv;
+    const int nb_jobs = FFMIN(f1->height, s->nb_slice_hists);
+    ThreadData td;
+    int i, ret;
+
+    td.f1 = f1;
+    td.f2 = f2;
+
+    if (nb_jobs <= 1) {
+        td.hists = &s->histogram;
+        ret = update_histogram_slice(ctx, &td, 0, 1);
+    } else {
+        td.hists = s->slice_hists;
+        ctx->internal->execute(ctx, update_histogram_slice, &td, s->jobs_rets, nb_jobs);
+        for (ret = 0, i = 0; i < nb_jobs; i++) {
+            if (s->jobs_rets[i] < 0)
+                ret = s->jobs_rets[i];
+            if (ret >= 0)
+                ret = merge_histogram(&s->histogram, &s->slice_hists[i]);
+        }
+        for (i = 0; i < nb_jobs; i++)
+            reset_histogram(&s->slice_hists[i]);
+    }
+    s->nb_refs = s->histogram.nb_refs;
+    return ret;
 }
 
 /**
- * Update the histogram for each passing frame. No frame will be pushed here.
+ * Update the histogram for each passing frame. No frame will be pushed here,
+ * except in the single stats_mode.
  */
 static int filter_frame(AVFilterLink *inlink, AVFrame *in)
 {
     AVFilterContext *ctx = inlink->dst;
     PaletteGenContext *s = ctx->priv;
-    int ret = s->prev_frame ? update_histogram_diff(s->histogram, s->prev_frame, in)
-                            : update_histogram_frame(s->histogram, in);
+    int ret = s->prev_frame ? update_histogram(ctx, s->prev_frame, in)
+                            : update_histogram(ctx, in, NULL);
 
-    if (ret > 0)
-        s->nb_refs += ret;
+    if (ret < 0) {
+        av_frame_free(&in);
+        return ret;
+    }
 
     if (s->stats_mode == STATS_MODE_DIFF_FRAMES) {
         av_frame_free(&s->prev_frame);
         s->prev_frame = in;
     } else if (s->stats_mode == STATS_MODE_SINGLE_FRAMES) {
         AVFrame *out;
-        int i;
 
+        /* the palette is built from the colors listed in the histogram, which
+         * is then emptied without crawling the whole hash table */
         out = get_palette_frame(ctx);
+        if (!out) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
         out->pts = in->pts;
         av_frame_free(&in);
         ret = ff_filter_frame(ctx->outputs[0], out);
-        for (i = 0; i < HIST_SIZE; i++)
-            av_freep(&s->histogram[i].entries);
+        reset_histogram(&s->histogram);
         av_freep(&s->refs);
         s->nb_refs = 0;
         s->nb_boxes = 0;
         memset(s->boxes, 0, sizeof(s->boxes));
-        memset(s->histogram, 0, sizeof(s->histogram));
     } else {
         av_frame_free(&in);
     }
@@ -535,18 +653,45 @@ static int request_frame(AVFilterLink *outlink)
  */
 static int config_output(AVFilterLink *outlink)
 {
+    AVFilterContext *ctx = outlink->src;
+    PaletteGenContext *s = ctx->priv;
+    const int nb_threads = ff_filter_get_nb_threads(ctx);
+
+    s->shift       = 8 - s->precision;
+    s->color_mask  = 0xff000000 | (0xff << s->shift & 0xff) * 0x010101;
+    s->color_round = s->shift ? (1 << s->shift - 1) * 0x010101 : 0;
+
+    if (nb_threads > 1 && !s->slice_hists) {
+        s->slice_hists = av_calloc(nb_threads, sizeof(*s->slice_hists));
+        s->jobs_rets   = av_calloc(nb_threads, sizeof(*s->jobs_rets));
+        if (!s->slice_hists || !s->jobs_rets)
+            return AVERROR(ENOMEM);
+        s->nb_slice_hists = nb_threads;
+    }
+
     outlink->w = outlink->h = 16;
     outlink->sample_aspect_ratio = av_make_q(1, 1);
     return 0;
 }
 
+static void free_histogram(struct histogram *hist)
+{
+    int i;
+
+    for (i = 0; i < HIST_SIZE; i++)
+        av_freep(&hist->nodes[i].entries);
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     int i;
     PaletteGenContext *s = ctx->priv;
 
-    for (i = 0; i < HIST_SIZE; i++)
-        av_freep(&s->histogram[i].entries);
+    free_histogram(&s->histogram);
+    for (i = 0; i < s->nb_slice_hists; i++)
+        free_histogram(&s->slice_hists[i]);
+    av_freep(&s->slice_hists);
+    av_freep(&s->jobs_rets);
     av_freep(&s->refs);
     av_frame_free(&s->prev_frame);
 }
@@ -579,4 +724,5 @@ AVFilter ff_vf_palettegen = {
     .inputs        = palettegen_inputs,
     .outputs       = palettegen_outputs,
     .priv_class    = &palettegen_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -31,6 +31,7 @@
 #include "filters.h"
 #include "framesync.h"
 #include "internal.h"
+#include "paletteuse.h"
 
 enum dithering_mode {
     DITHERING_NONE,
@@ -65,6 +66,9 @@ struct color_node {
 #define NBITS 5
 #define CACHE_SIZE (1<<(3*NBITS))
 
+/* palettes with at most that many colors are searched with dsp.nearest */
+#define DSP_MAX_COLORS 32
+
 struct cached_color {
     uint32_t color;
     uint8_t pal_entry;
@@ -77,14 +81,23 @@ struct cache_node {
 
 struct PaletteUseContext;
 
-typedef int (*set_frame_func)(struct PaletteUseContext *s, AVFrame *out, AVFrame *in,
+typedef int (*set_frame_func)(struct PaletteUseContext *s, struct cache_node *cache,
+                              AVFrame *out, AVFrame *in,
                               int x_start, int y_start, int width, int height);
 
 typedef struct PaletteUseContext {
     const AVClass *class;
     FFFrameSync fs;
-    struct cache_node cache[CACHE_SIZE];    /* lookup cache */
+    struct cache_node *cache;               /* lookup caches, CACHE_SIZE entries per thread */
+    int nb_caches;
+    int *jobs_rets;
     struct color_node map[AVPALETTE_COUNT]; /* 3D-Tree (KD-Tree with K=3) for reverse colormap */
+    PaletteUseDSPContext dsp;
+    int32_t dsp_pal[3 * AVPALETTE_COUNT];   /* planar palette for dsp.nearest */
+    uint8_t dsp_pal_ids[AVPALETTE_COUNT];   /* palette index of the dsp_pal entries */
+    int dsp_nb_colors;                      /* 0 if dsp.nearest is not used */
+    int table_bits;
+    uint8_t *table;                         /* reverse colormap of the quantized colors */
     uint32_t palette[AVPALETTE_COUNT];
     int transparency_index; /* index in the palette of transparency. -1 if there is no transparency in the palette. */
     int trans_thresh;
@@ -120,6 +133,7 @@ static const AVOption paletteuse_options[] = {
         { "rectangle", "process smallest different rectangle", 0, AV_OPT_TYPE_CONST, {.i64=DIFF_MODE_RECTANGLE}, INT_MIN, INT_MAX, FLAGS, "diff_mode" },
     { "new", "take new palette for each output frame", OFFSET(new), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { "alpha_threshold", "set the alpha threshold for transparency", OFFSET(trans_thresh), AV_OPT_TYPE_INT, {.i64=128}, 0, 255, FLAGS },
+    { "table_bits", "set the bits per component of the reverse colormap table (0 to disable)", OFFSET(table_bits), AV_OPT_TYPE_INT, {.i64=0}, 0, 8, FLAGS },
 
     /* following are the debug options, not part of the official API */
     { "debug_kdtree", "save Graphviz graph of the kdtree in specified file", OFFSET(dot_filename), AV_OPT_TYPE_STRING, {.str=NULL}, 0, 0, FLAGS },
@@ -327,13 +341,56 @@ end:
     search == COLOR_SEARCH_NNS_RECURSIVE ? colormap_nearest_recursive(root, target, trans_thresh) :      \
                                            colormap_nearest_bruteforce(palette, target, trans_thresh)
 
+static int nearest_c(const int32_t *pal, int nb, int r, int g, int b)
+{
+    int i, pal_id = 0, min_dist = INT_MAX;
+
+    for (i = 0; i < nb; i++) {
+        const int dr = pal[i                      ] - r;
+        const int dg = pal[i +     AVPALETTE_COUNT] - g;
+        const int db = pal[i + 2 * AVPALETTE_COUNT] - b;
+        const int d = dr*dr + dg*dg + db*db;
+
+        if (d < min_dist) {
+            pal_id = i;
+            min_dist = d;
+        }
+    }
+    return pal_id;
+}
+
+av_cold void ff_paletteuse_dsp_init(PaletteUseDSPContext *dsp)
+{
+    dsp->nearest = nearest_c;
+
+    if (ARCH_AARCH64)
+        ff_paletteuse_dsp_init_aarch64(dsp);
+    if (ARCH_X86)
+        ff_paletteuse_dsp_init_x86(dsp);
+}
+
+/**
+ * Search small palettes by brute force with the dsp function, which is faster
+ * than walking the tree and returns the same entry as
+ * colormap_nearest_bruteforce().
+ */
+static av_always_inline uint8_t colormap_nearest(const PaletteUseContext *s, const uint8_t *argb,
+                                                 const enum color_search_method search_method)
+{
+    if (s->dsp_nb_colors && argb[0] >= s->trans_thresh)
+        return s->dsp_pal_ids[s->dsp.nearest(s->dsp_pal, s->dsp_nb_colors,
+                                             argb[1], argb[2], argb[3])];
+    return COLORMAP_NEAREST(search_method, s->palette, s->map, argb, s->trans_thresh);
+}
+
 /**
  * Check if the requested color is in the cache already. If not, find it in the
  * color tree and cache it.
  * Note: a, r, g, and b are the components of color, but are passed as well to avoid
  * recomputing them (they are generally computed by the caller for other uses).
  */
-static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
+static av_always_inline int color_get(PaletteUseContext *s, struct cache_node *cache,
+                                      uint32_t color,
                                       uint8_t a, uint8_t r, uint8_t g, uint8_t b,
                                       const enum color_search_method search_method)
 {
@@ -343,7 +400,7 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
     const uint8_t ghash = g & ((1<<NBITS)-1);
     const uint8_t bhash = b & ((1<<NBITS)-1);
     const unsigned hash = rhash<<(NBITS*2) | ghash<<NBITS | bhash;
-    struct cache_node *node = &s->cache[hash];
+    struct cache_node *node = &cache[hash];
     struct cached_color *e;
 
     // first, check for transparency
@@ -351,6 +408,12 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
         return s->transparency_index;
     }
 
+    if (s->table && a >= s->trans_thresh) {
+        const int bits  = s->table_bits;
+        const int shift = 8 - bits;
+        return s->table[(r >> shift) << (2 * bits) | (g >> shift) << bits | b >> shift];
+    }
+
     for (i = 0; i < node->nb_entries; i++) {
         e = &node->entries[i];
         if (e->color == color)
@@ -362,12 +425,12 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color,
     if (!e)
         return AVERROR(ENOMEM);
     e->color = color;
-    e->pal_entry = COLORMAP_NEAREST(search_method, s->palette, s->map, argb_elts, s->trans_thresh);
+    e->pal_entry = colormap_nearest(s, argb_elts, search_method);
 
     return e->pal_entry;
 }
 
-static av_always_inline int get_dst_color_err(PaletteUseContext *s,
+static av_always_inline int get_dst_color_err(PaletteUseContext *s, struct cache_node *cache,
                                               uint32_t c, int *er, int *eg, int *eb,
                                               const enum color_search_method search_method)
 {
@@ -376,7 +439,7 @@ static av_always_inline int get_dst_color_err(PaletteUseContext *s,
     const uint8_t g = c >>  8 & 0xff;
     const uint8_t b = c       & 0xff;
     uint32_t dstc;
-    const int dstx = color_get(s, c, a, r, g, b, search_method);
+    const int dstx = color_get(s, cache, c, a, r, g, b, search_method);
     if (dstx < 0)
         return dstx;
     dstc = s->palette[dstx];
@@ -386,7 +449,8 @@ static av_always_inline int get_dst_color_err(PaletteUseContext *s,
     return dstx;
 }
 
-static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFrame *in,
+static av_always_inline int set_frame(PaletteUseContext *s, struct cache_node *cache,
+                                      AVFrame *out, AVFrame *in,
                                       int x_start, int y_start, int w, int h,
                                       enum dithering_mode dither,
                                       const enum color_search_method search_method)
@@ -413,7 +477,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t r = av_clip_uint8(r8 + d);
                 const uint8_t g = av_clip_uint8(g8 + d);
                 const uint8_t b = av_clip_uint8(b8 + d);
-                const int color = color_get(s, src[x], a8, r, g, b, search_method);
+                const int color = color_get(s, cache, src[x], a8, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
@@ -421,7 +485,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_HECKBERT) {
                 const int right = x < w - 1, down = y < h - 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -433,7 +497,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_FLOYD_STEINBERG) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -447,7 +511,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
             } else if (dither == DITHERING_SIERRA2) {
                 const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
                 const int right2 = x < w - 2,                    left2 = x > x_start + 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -466,7 +530,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
 
             } else if (dither == DITHERING_SIERRA2_4A) {
                 const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb, search_method);
+                const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb, search_method);
 
                 if (color < 0)
                     return color;
@@ -481,7 +545,7 @@ static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFram
                 const uint8_t r = src[x] >> 16 & 0xff;
                 const uint8_t g = src[x] >>  8 & 0xff;
                 const uint8_t b = src[x]       & 0xff;
-                const int color = color_get(s, src[x], a, r, g, b, search_method);
+                const int color = color_get(s, cache, src[x], a, r, g, b, search_method);
 
                 if (color < 0)
                     return color;
@@ -761,6 +825,28 @@ static void load_colormap(PaletteUseContext *s)
 
     colormap_insert(s->map, color_used, &nb_used, s->palette, s->trans_thresh, &box);
 
+    /* same entries as colormap_nearest_bruteforce(), in the same order */
+    s->dsp_nb_colors = 0;
+    for (i = 0; i < AVPALETTE_COUNT; i++) {
+        const uint32_t c = s->palette[i];
+
+        if (c >> 24 < s->trans_thresh)
+            continue;
+        s->dsp_pal[s->dsp_nb_colors                      ] = c >> 16 & 0xff;
+        s->dsp_pal[s->dsp_nb_colors +     AVPALETTE_COUNT] = c >>  8 & 0xff;
+        s->dsp_pal[s->dsp_nb_colors + 2 * AVPALETTE_COUNT] = c       & 0xff;
+        s->dsp_pal_ids[s->dsp_nb_colors++] = i;
+    }
+    if (s->dsp_nb_colors > DSP_MAX_COLORS &&
+        s->color_search_method != COLOR_SEARCH_BRUTEFORCE)
+        s->dsp_nb_colors = 0;
+    for (i = s->dsp_nb_colors; i < FFALIGN(s->dsp_nb_colors, 16); i++) {
+        s->dsp_pal[i                      ] = PALETTEUSE_PAD_COLOR;
+        s->dsp_pal[i +     AVPALETTE_COUNT] = PALETTEUSE_PAD_COLOR;
+        s->dsp_pal[i + 2 * AVPALETTE_COUNT] = PALETTEUSE_PAD_COLOR;
+    }
+    s->dsp_nb_colors = FFALIGN(s->dsp_nb_colors, 16);
+
     if (s->dot_filename)
         disp_tree(s->map, s->dot_filename);
 
@@ -889,12 +975,29 @@ static void set_processing_window(enum diff_mode diff_mode,
     *hp = height;
 }
 
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int x, y, w, h;
+} ThreadData;
+
+static int set_frame_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const int slice_start = td->y + (td->h *  jobnr   ) / nb_jobs;
+    const int slice_end   = td->y + (td->h * (jobnr+1)) / nb_jobs;
+
+    return s->set_frame(s, s->cache + jobnr * CACHE_SIZE, td->out, td->in,
+                        td->x, slice_start, td->w, slice_end - slice_start);
+}
+
 static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
 {
-    int x, y, w, h, ret;
+    int x, y, w, h, ret, i, nb_jobs = 1;
     AVFilterContext *ctx = inlink->dst;
     PaletteUseContext *s = ctx->priv;
     AVFilterLink *outlink = inlink->dst->outputs[0];
+    ThreadData td;
 
     AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
     if (!out) {
@@ -918,11 +1021,27 @@ static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
     ff_dlog(ctx, "%dx%d rect: (%d;%d) -> (%d,%d) [area:%dx%d]\n",
             w, h, x, y, x+w, y+h, in->width, in->height);
 
-    ret = s->set_frame(s, out, in, x, y, w, h);
-    if (ret < 0) {
-        av_frame_free(&out);
-        *outf = NULL;
-        return ret;
+    /* The error diffusion needs the rows to be processed in order, and
+     * without the reverse colormap table the bayer dithering caches the
+     * color found for the dithered pixel under the source pixel, so that
+     * its output depends on the scan order too. */
+    if (s->dither == DITHERING_NONE ||
+        (s->dither == DITHERING_BAYER && s->table))
+        nb_jobs = FFMIN(h, s->nb_caches);
+
+    td.in  = in;
+    td.out = out;
+    td.x   = x;
+    td.y   = y;
+    td.w   = w;
+    td.h   = h;
+    ctx->internal->execute(ctx, set_frame_slice, &td, s->jobs_rets, nb_jobs);
+    for (i = 0; i < nb_jobs; i++) {
+        if ((ret = s->jobs_rets[i]) < 0) {
+            av_frame_free(&out);
+            *outf = NULL;
+            return ret;
+        }
     }
     memcpy(out->data[1], s->palette, AVPALETTE_SIZE);
     if (s->calc_mean_err)
@@ -947,6 +1066,19 @@ static int config_output(AVFilterLink *outlink)
     outlink->w = ctx->inputs[0]->w;
     outlink->h = ctx->inputs[0]->h;
 
+    if (!s->cache) {
+        s->nb_caches = ff_filter_get_nb_threads(ctx);
+        s->cache     = av_calloc(s->nb_caches, CACHE_SIZE * sizeof(*s->cache));
+        s->jobs_rets = av_calloc(s->nb_caches, sizeof(*s->jobs_rets));
+        if (!s->cache || !s->jobs_rets)
+            return AVERROR(ENOMEM);
+    }
+    if (s->table_bits && !s->table) {
+        s->table = av_malloc(1 << 3 * s->table_bits);
+        if (!s->table)
+            return AVERROR(ENOMEM);
+    }
+
     outlink->time_base = ctx->inputs[0]->time_base;
     if ((ret = ff_framesync_configure(&s->fs)) < 0)
         return ret;
@@ -968,8 +1100,33 @@ static int config_input_palette(AVFilterLink *inlink)
     return 0;
 }
 
-static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
+static int fill_table(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    const int bits  = s->table_bits;
+    const int shift = 8 - bits;
+    const int half  = 1 << shift >> 1;
+    const int slice_start = (1 << bits) *  jobnr    / nb_jobs;
+    const int slice_end   = (1 << bits) * (jobnr+1) / nb_jobs;
+    uint8_t *table = s->table + (slice_start << 2 * bits);
+    int r, g, b;
+
+    /* map each quantized color to the entry nearest to the center of its
+     * range of colors */
+    for (r = slice_start; r < slice_end; r++) {
+        for (g = 0; g < 1 << bits; g++) {
+            for (b = 0; b < 1 << bits; b++) {
+                const uint8_t argb[] = {0xff, r << shift | half, g << shift | half, b << shift | half};
+                *table++ = colormap_nearest(s, argb, s->color_search_method);
+            }
+        }
+    }
+    return 0;
+}
+
+static void load_palette(AVFilterContext *ctx, const AVFrame *palette_frame)
 {
+    PaletteUseContext *s = ctx->priv;
     int i, x, y;
     const uint32_t *p = (const uint32_t *)palette_frame->data[0];
     const int p_linesize = palette_frame->linesize[0] >> 2;
@@ -979,9 +1136,9 @@ static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
     if (s->new) {
         memset(s->palette, 0, sizeof(s->palette));
         memset(s->map, 0, sizeof(s->map));
-        for (i = 0; i < CACHE_SIZE; i++)
+        for (i = 0; i < CACHE_SIZE * s->nb_caches; i++)
             av_freep(&s->cache[i].entries);
-        memset(s->cache, 0, sizeof(s->cache));
+        memset(s->cache, 0, CACHE_SIZE * s->nb_caches * sizeof(*s->cache));
     }
 
     i = 0;
@@ -998,6 +1155,10 @@ static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
 
     load_colormap(s);
 
+    if (s->table)
+        ctx->internal->execute(ctx, fill_table, NULL, NULL,
+                               FFMIN(1 << s->table_bits, s->nb_caches));
+
     if (!s->new)
         s->palette_loaded = 1;
 }
@@ -1019,7 +1180,7 @@ static int load_apply_palette(FFFrameSync *fs)
         return AVERROR_BUG;
     }
     if (!s->palette_loaded) {
-        load_palette(s, second);
+        load_palette(ctx, second);
     }
     ret = apply_palette(inlink, master, &out);
     av_frame_free(&master);
@@ -1028,11 +1189,12 @@ static int load_apply_palette(FFFrameSync *fs)
     return ff_filter_frame(ctx->outputs[0], out);
 }
 
-#define DEFINE_SET_FRAME(color_search, name, value)                             \
-static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,    \
-                            int x_start, int y_start, int w, int h)             \
-{                                                                               \
-    return set_frame(s, out, in, x_start, y_start, w, h, value, color_search);  \
+#define DEFINE_SET_FRAME(color_search, name, value)                                     \
+static int set_frame_##name(PaletteUseContext *s, struct cache_node *cache,             \
+                            AVFrame *out, AVFrame *in,                                  \
+                            int x_start, int y_start, int w, int h)                     \
+{                                                                                       \
+    return set_frame(s, cache, out, in, x_start, y_start, w, h, value, color_search);   \
 }
 
 #define DEFINE_SET_FRAME_COLOR_SEARCH(color_search, color_search_macro)                                 \
@@ -1083,6 +1245,7 @@ static av_cold int init(AVFilterContext *ctx)
     }
 
     s->set_frame = set_frame_lut[s->color_search_method][s->dither];
+    ff_paletteuse_dsp_init(&s->dsp);
 
     if (s->dither == DITHERING_BAYER) {
         int i;
@@ -1107,8 +1270,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     PaletteUseContext *s = ctx->priv;
 
     ff_framesync_uninit(&s->fs);
-    for (i = 0; i < CACHE_SIZE; i++)
+    for (i = 0; i < CACHE_SIZE * s->nb_caches; i++)
         av_freep(&s->cache[i].entries);
+    av_freep(&s->cache);
+    av_freep(&s->jobs_rets);
+    av_freep(&s->table);
     av_frame_free(&s->last_in);
     av_frame_free(&s->last_out);
 }
@@ -1145,4 +1311,5 @@ AVFilter ff_vf_paletteuse = {
     .inputs        = paletteuse_inputs,
     .outputs       = paletteuse_outputs,
     .priv_class    = &paletteuse_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
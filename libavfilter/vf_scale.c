@@ -153,6 +153,8 @@ typedef struct ScaleContext {
 
     int eval_mode;              ///< expression evaluation mode
 
+    AVFrame *dup_frame;         ///< last output, resent for duplicate input frames
+
 } ScaleContext;
 
 AVFilter ff_vf_scale2ref;
@@ -339,6 +341,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     sws_freeContext(scale->isws[1]);
     scale->sws = NULL;
     av_dict_free(&scale->opts);
+    av_frame_free(&scale->dup_frame);
 }
 
 static int query_formats(AVFilterContext *ctx)
@@ -825,15 +828,41 @@ scale:
 static int filter_frame(AVFilterLink *link, AVFrame *in)
 {
     AVFilterContext *ctx = link->dst;
+    ScaleContext *scale = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out;
     int ret;
 
+    /* with per-stream evaluation, the output only depends on the input */
+    if (in->flags & AV_FRAME_FLAG_DUPLICATE &&
+        scale->eval_mode == EVAL_MODE_INIT &&
+        in->width  == link->w && in->height == link->h && in->format == link->format &&
+        !av_cmp_q(in->sample_aspect_ratio, link->sample_aspect_ratio)) {
+        if (scale->dup_frame && scale->dup_frame->buf[0]) {
+            ret = ff_filter_frame_duplicate(outlink, scale->dup_frame, in);
+            av_frame_free(&in);
+            return ret;
+        }
+        if (!scale->dup_frame && !(scale->dup_frame = av_frame_alloc())) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+    }
+    /* the previous output may not be known or may differ */
+    in->flags &= ~AV_FRAME_FLAG_DUPLICATE;
+
     ret = scale_frame(link, in, &out);
-    if (out)
-        return ff_filter_frame(outlink, out);
+    if (!out)
+        return ret;
 
-    return ret;
+    if (scale->dup_frame) {
+        av_frame_unref(scale->dup_frame);
+        if ((ret = av_frame_ref(scale->dup_frame, out)) < 0) {
+            av_frame_free(&out);
+            return ret;
+        }
+    }
+    return ff_filter_frame(outlink, out);
 }
 
 static int filter_frame_ref(AVFilterLink *link, AVFrame *in)
@@ -888,6 +917,8 @@ static int process_command(AVFilterContext *ctx, const char *cmd, const char *ar
 
     if (ret < 0)
         av_log(ctx, AV_LOG_ERROR, "Failed to process command. Continuing with existing parameters.\n");
+    else if (scale->dup_frame)
+        av_frame_unref(scale->dup_frame);
 
     return ret;
 }
@@ -998,6 +1029,7 @@ AVFilter ff_vf_scale = {
     .inputs          = avfilter_vf_scale_inputs,
     .outputs         = avfilter_vf_scale_outputs,
     .process_command = process_command,
+    .flags_internal  = FF_FILTER_FLAG_DUPLICATE_AWARE,
 };
 
 static const AVClass scale2ref_class = {
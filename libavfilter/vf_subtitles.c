@@ -38,6 +38,7 @@
 #include "libavutil/imgutils.h"
 #include "libavutil/opt.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
 #include "drawutils.h"
 #include "avfilter.h"
 #include "internal.h"
@@ -60,6 +61,14 @@ typedef struct AssContext {
     int original_w, original_h;
     int shaping;
     FFDrawContext draw;
+
+    /* Premultiplied subtitle layer, in the pixel format of the video, kept
+     * until libass reports a change. It covers layer_w x layer_h pixels at
+     * layer_x, layer_y, and is blended as dst = val + dst * trans / max. */
+    AVFrame *layer_val;
+    AVFrame *layer_trans;
+    int layer_x, layer_y, layer_w, layer_h;
+    int layer_valid;
 } AssContext;
 
 #define OFFSET(x) offsetof(AssContext, x)
@@ -125,6 +134,8 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     AssContext *ass = ctx->priv;
 
+    av_frame_free(&ass->layer_val);
+    av_frame_free(&ass->layer_trans);
     if (ass->track)
         ass_free_track(ass->track);
     if (ass->renderer)
@@ -138,12 +149,37 @@ static int query_formats(AVFilterContext *ctx)
     return ff_set_common_formats(ctx, ff_draw_supported_pixel_formats(0));
 }
 
+static AVFrame *alloc_layer_frame(AVFilterLink *inlink)
+{
+    AVFrame *frame = av_frame_alloc();
+
+    if (!frame)
+        return NULL;
+    frame->format = inlink->format;
+    frame->width  = inlink->w;
+    frame->height = inlink->h;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        av_frame_free(&frame);
+    return frame;
+}
+
 static int config_input(AVFilterLink *inlink)
 {
     AssContext *ass = inlink->dst->priv;
 
     ff_draw_init(&ass->draw, inlink->format, ass->alpha ? FF_DRAW_PROCESS_ALPHA : 0);
 
+    /* the layer is only used for 8-bit formats */
+    if (ass->draw.desc->comp[0].depth <= 8) {
+        av_frame_free(&ass->layer_val);
+        av_frame_free(&ass->layer_trans);
+        ass->layer_val   = alloc_layer_frame(inlink);
+        ass->layer_trans = alloc_layer_frame(inlink);
+        if (!ass->layer_val || !ass->layer_trans)
+            return AVERROR(ENOMEM);
+    }
+    ass->layer_valid = 0;
+
     ass_set_frame_size  (ass->renderer, inlink->w, inlink->h);
     if (ass->original_w && ass->original_h)
         ass_set_aspect_ratio(ass->renderer, (double)inlink->w / inlink->h,
@@ -175,6 +211,108 @@ static void overlay_ass_image(AssContext *ass, AVFrame *picref,
     }
 }
 
+/* alpha is left untouched unless processed, as in ff_blend_mask() */
+static int layer_nb_planes(const FFDrawContext *draw)
+{
+    int nb_planes = draw->nb_planes - !!(draw->desc->flags & AV_PIX_FMT_FLAG_ALPHA &&
+                                         !(draw->flags & FF_DRAW_PROCESS_ALPHA));
+    return FFMAX(nb_planes, 1);
+}
+
+/**
+ * Composite the images into the premultiplied layer. Each image is blended
+ * over the layer values with its color, and over the layer transparency
+ * with a zero color, so that the layer ends up holding the sum of the
+ * contributions of the images and the fraction of the video left visible.
+ */
+static void update_layer(AssContext *ass, const ASS_Image *image)
+{
+    FFDrawContext *draw = &ass->draw;
+    AVFrame *val = ass->layer_val, *trans = ass->layer_trans;
+    const ASS_Image *img;
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+    int plane, y;
+
+    for (img = image; img; img = img->next) {
+        if (img->w <= 0 || img->h <= 0 || AA(img->color) == 0)
+            continue;
+        x0 = FFMIN(x0, img->dst_x);
+        y0 = FFMIN(y0, img->dst_y);
+        x1 = FFMAX(x1, img->dst_x + img->w);
+        y1 = FFMAX(y1, img->dst_y + img->h);
+    }
+    x0 = FFMAX(x0, 0);
+    y0 = FFMAX(y0, 0);
+    x1 = FFMIN(x1, val->width);
+    y1 = FFMIN(y1, val->height);
+
+    ass->layer_valid = 1;
+    ass->layer_w = ass->layer_h = 0;
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    /* keep the chroma samples of the layer aligned with the video ones */
+    x0 = ff_draw_round_to_sub(draw, 0, -1, x0);
+    y0 = ff_draw_round_to_sub(draw, 1, -1, y0);
+    ass->layer_x = x0;
+    ass->layer_y = y0;
+    ass->layer_w = x1 - x0;
+    ass->layer_h = y1 - y0;
+
+    for (plane = 0; plane < layer_nb_planes(draw); plane++) {
+        const int w = AV_CEIL_RSHIFT(ass->layer_w, draw->hsub[plane]) * draw->pixelstep[plane];
+        const int h = AV_CEIL_RSHIFT(ass->layer_h, draw->vsub[plane]);
+
+        for (y = 0; y < h; y++) {
+            memset(val  ->data[plane] + y * val  ->linesize[plane], 0x00, w);
+            memset(trans->data[plane] + y * trans->linesize[plane], 0xff, w);
+        }
+    }
+
+    for (img = image; img; img = img->next) {
+        uint8_t rgba_color[] = {AR(img->color), AG(img->color), AB(img->color), AA(img->color)};
+        FFDrawColor color, clear;
+
+        ff_draw_color(draw, &color, rgba_color);
+        clear = color;
+        memset(clear.comp, 0, sizeof(clear.comp));
+        ff_blend_mask(draw, &color, val->data, val->linesize,
+                      ass->layer_w, ass->layer_h,
+                      img->bitmap, img->stride, img->w, img->h,
+                      3, 0, img->dst_x - x0, img->dst_y - y0);
+        ff_blend_mask(draw, &clear, trans->data, trans->linesize,
+                      ass->layer_w, ass->layer_h,
+                      img->bitmap, img->stride, img->w, img->h,
+                      3, 0, img->dst_x - x0, img->dst_y - y0);
+    }
+}
+
+static int blend_layer_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    AssContext *ass = ctx->priv;
+    FFDrawContext *draw = &ass->draw;
+    AVFrame *frame = arg;
+    const AVFrame *val = ass->layer_val, *trans = ass->layer_trans;
+    int plane, y;
+
+    for (plane = 0; plane < layer_nb_planes(draw); plane++) {
+        const int hsub = draw->hsub[plane], vsub = draw->vsub[plane];
+        const int w = AV_CEIL_RSHIFT(ass->layer_w, hsub) * draw->pixelstep[plane];
+        const int h = AV_CEIL_RSHIFT(ass->layer_h, vsub);
+        const int slice_start = (h *  jobnr   ) / nb_jobs;
+        const int slice_end   = (h * (jobnr+1)) / nb_jobs;
+        uint8_t *dst = frame->data[plane] +
+                       (ass->layer_y >> vsub) * frame->linesize[plane] +
+                       (ass->layer_x >> hsub) * draw->pixelstep[plane];
+
+        for (y = slice_start; y < slice_end; y++)
+            draw->blend_layer_row(dst + y * frame->linesize[plane],
+                                  val  ->data[plane] + y * val  ->linesize[plane],
+                                  trans->data[plane] + y * trans->linesize[plane], w);
+    }
+    return 0;
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -188,7 +326,17 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     if (detect_change)
         av_log(ctx, AV_LOG_DEBUG, "Change happened at time ms:%f\n", time_ms);
 
-    overlay_ass_image(ass, picref, image);
+    if (!ass->layer_val) {
+        overlay_ass_image(ass, picref, image);
+    } else {
+        /* the images are only composited again when they changed */
+        if (detect_change || !ass->layer_valid)
+            update_layer(ass, image);
+        if (ass->layer_w && ass->layer_h)
+            ctx->internal->execute(ctx, blend_layer_slice, picref, NULL,
+                                   FFMIN(AV_CEIL_RSHIFT(ass->layer_h, ass->draw.vsub_max),
+                                         ff_filter_get_nb_threads(ctx)));
+    }
 
     return ff_filter_frame(outlink, picref);
 }
@@ -256,6 +404,7 @@ AVFilter ff_vf_ass = {
     .inputs        = ass_inputs,
     .outputs       = ass_outputs,
     .priv_class    = &ass_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
 #endif
 
@@ -490,5 +639,6 @@ AVFilter ff_vf_subtitles = {
     .inputs        = ass_inputs,
     .outputs       = ass_outputs,
     .priv_class    = &subtitles_class,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
 };
 #endif
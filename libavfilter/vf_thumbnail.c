@@ -27,10 +27,12 @@
  * @see http://notbrainsurgery.livejournal.com/29773.html
  */
 
+#include "config.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "avfilter.h"
 #include "internal.h"
+#include "thumbnail.h"
 
 #define HIST_SIZE (3*256)
 
@@ -43,11 +45,19 @@ typedef struct ThumbContext {
     const AVClass *class;
     int n;                      ///< current frame
     int n_frames;               ///< number of frames for analysis
-    struct thumb_frame *frames; ///< the n_frames frames
+    struct thumb_frame *frames; ///< the n_frames frames, or the best candidate
+                                ///< and the current frame in streaming mode
     AVRational tb;              ///< copy of the input timebase to ease access
+    int stream;                 ///< only keep the best candidate frame
+
+    int best;                   ///< index of the best candidate in streaming mode
+    int64_t hist_sum[HIST_SIZE]; ///< sum of the histograms of the batch in streaming mode
+    int sub_hist[4 * 256];      ///< interleaved histograms of a plane
 
     int planewidth[4];
     int planeheight[4];
+
+    ThumbnailDSPContext dsp;
 } ThumbContext;
 
 #define OFFSET(x) offsetof(ThumbContext, x)
@@ -55,6 +65,7 @@ typedef struct ThumbContext {
 
 static const AVOption thumbnail_options[] = {
     { "n", "set the frames batch size", OFFSET(n_frames), AV_OPT_TYPE_INT, {.i64=100}, 2, INT_MAX, FLAGS },
+    { "stream", "only keep the best candidate frame in memory", OFFSET(stream), AV_OPT_TYPE_BOOL, {.i64=0}, 0, 1, FLAGS },
     { NULL }
 };
 
@@ -64,16 +75,53 @@ static av_cold int init(AVFilterContext *ctx)
 {
     ThumbContext *s = ctx->priv;
 
-    s->frames = av_calloc(s->n_frames, sizeof(*s->frames));
+    s->frames = av_calloc(s->stream ? 2 : s->n_frames, sizeof(*s->frames));
     if (!s->frames) {
         av_log(ctx, AV_LOG_ERROR,
                "Allocation failure, try to lower the number of frames\n");
         return AVERROR(ENOMEM);
     }
-    av_log(ctx, AV_LOG_VERBOSE, "batch size: %d frames\n", s->n_frames);
+    ff_thumbnail_dsp_init(&s->dsp);
+    av_log(ctx, AV_LOG_VERBOSE, "batch size: %d frames%s\n", s->n_frames,
+           s->stream ? ", streaming" : "");
     return 0;
 }
 
+static int histogram_row_c(int *hist, const uint8_t *src, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++)
+        hist[(i & 3) * 256 + src[i]]++;
+    return len;
+}
+
+void ff_thumbnail_dsp_init(ThumbnailDSPContext *dsp)
+{
+    dsp->histogram_row = histogram_row_c;
+
+    if (ARCH_AARCH64)
+        ff_thumbnail_dsp_init_aarch64(dsp);
+    if (ARCH_X86)
+        ff_thumbnail_dsp_init_x86(dsp);
+}
+
+/**
+ * Count the bytes of the rows of a plane in s->sub_hist, reset beforehand.
+ */
+static void plane_sub_histogram(ThumbContext *s, const uint8_t *p,
+                                ptrdiff_t linesize, int len, int h)
+{
+    int i, j;
+
+    memset(s->sub_hist, 0, sizeof(s->sub_hist));
+    for (j = 0; j < h; j++) {
+        for (i = s->dsp.histogram_row(s->sub_hist, p, len); i < len; i++)
+            s->sub_hist[(i & 3) * 256 + p[i]]++;
+        p += linesize;
+    }
+}
+
 /**
  * @brief        Compute Sum-square deviation to estimate "closeness".
  * @param hist   color distribution histogram
@@ -100,6 +148,15 @@ static AVFrame *get_best_frame(AVFilterContext *ctx)
     int nb_frames = s->n;
     double avg_hist[HIST_SIZE] = {0}, sq_err, min_sq_err = -1;
 
+    if (s->stream) {
+        best_frame_idx = s->best;
+        memset(s->hist_sum, 0, sizeof(s->hist_sum));
+        s->n = 0;
+        picref = s->frames[0].buf;
+        s->frames[0].buf = NULL;
+        goto end;
+    }
+
     // average histogram of the N frames
     for (j = 0; j < FF_ARRAY_ELEMS(avg_hist); j++) {
         for (i = 0; i < nb_frames; i++)
@@ -124,25 +181,58 @@ static AVFrame *get_best_frame(AVFilterContext *ctx)
 
     // raise the chosen one
     picref = s->frames[best_frame_idx].buf;
+    s->frames[best_frame_idx].buf = NULL;
+
+end:
     av_log(ctx, AV_LOG_INFO, "frame id #%d (pts_time=%f) selected "
            "from a set of %d images\n", best_frame_idx,
            picref->pts * av_q2d(s->tb), nb_frames);
-    s->frames[best_frame_idx].buf = NULL;
 
     return picref;
 }
 
+/**
+ * Keep frame if it is closer than the current candidate to the average
+ * histogram of the frames seen so far in the batch. This only needs the
+ * candidate in memory, but may select a different frame than the batch
+ * mode, which compares all the frames to the average of the whole batch.
+ */
+static void select_candidate(AVFilterContext *ctx, AVFrame *frame)
+{
+    ThumbContext *s = ctx->priv;
+    struct thumb_frame *cand = &s->frames[0], *cur = &s->frames[1];
+    double avg_hist[HIST_SIZE];
+    int j;
+
+    for (j = 0; j < HIST_SIZE; j++) {
+        s->hist_sum[j] += cur->histogram[j];
+        avg_hist[j] = (double)s->hist_sum[j] / (s->n + 1);
+    }
+
+    if (!s->n || frame_sum_square_err(cur->histogram, avg_hist) <
+                 frame_sum_square_err(cand->histogram, avg_hist)) {
+        av_frame_free(&cand->buf);
+        cand->buf = frame;
+        memcpy(cand->histogram, cur->histogram, sizeof(cand->histogram));
+        s->best = s->n;
+    } else {
+        av_frame_free(&frame);
+    }
+    memset(cur->histogram, 0, sizeof(cur->histogram));
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
 {
     int i, j;
     AVFilterContext *ctx  = inlink->dst;
     ThumbContext *s   = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
-    int *hist = s->frames[s->n].histogram;
+    int *hist = s->frames[s->stream ? 1 : s->n].histogram;
     const uint8_t *p = frame->data[0];
 
     // keep a reference of each frame
-    s->frames[s->n].buf = frame;
+    if (!s->stream)
+        s->frames[s->n].buf = frame;
 
     // update current frame histogram
     switch (inlink->format) {
@@ -161,40 +251,35 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     case AV_PIX_FMT_BGR0:
     case AV_PIX_FMT_RGBA:
     case AV_PIX_FMT_BGRA:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
-                hist[0*256 + p[i*4    ]]++;
-                hist[1*256 + p[i*4 + 1]]++;
-                hist[2*256 + p[i*4 + 2]]++;
-            }
-            p += frame->linesize[0];
-        }
-        break;
     case AV_PIX_FMT_0RGB:
     case AV_PIX_FMT_0BGR:
     case AV_PIX_FMT_ARGB:
-    case AV_PIX_FMT_ABGR:
-        for (j = 0; j < inlink->h; j++) {
-            for (i = 0; i < inlink->w; i++) {
-                hist[0*256 + p[i*4 + 1]]++;
-                hist[1*256 + p[i*4 + 2]]++;
-                hist[2*256 + p[i*4 + 3]]++;
-            }
-            p += frame->linesize[0];
-        }
+    case AV_PIX_FMT_ABGR: {
+        // the interleaved histograms hold the 4 components of the pixels
+        const int first = inlink->format == AV_PIX_FMT_0RGB || inlink->format == AV_PIX_FMT_0BGR ||
+                          inlink->format == AV_PIX_FMT_ARGB || inlink->format == AV_PIX_FMT_ABGR;
+
+        plane_sub_histogram(s, p, frame->linesize[0], 4 * inlink->w, inlink->h);
+        for (j = 0; j < 3; j++)
+            for (i = 0; i < 256; i++)
+                hist[j*256 + i] += s->sub_hist[(first + j) * 256 + i];
         break;
+    }
     default:
         for (int plane = 0; plane < 3; plane++) {
-            const uint8_t *p = frame->data[plane];
-            for (j = 0; j < s->planeheight[plane]; j++) {
-                for (i = 0; i < s->planewidth[plane]; i++)
-                    hist[256*plane + p[i]]++;
-                p += frame->linesize[plane];
-            }
+            const int *sub = s->sub_hist;
+
+            plane_sub_histogram(s, frame->data[plane], frame->linesize[plane],
+                                s->planewidth[plane], s->planeheight[plane]);
+            for (i = 0; i < 256; i++)
+                hist[256*plane + i] += sub[i] + sub[256 + i] + sub[512 + i] + sub[768 + i];
         }
         break;
     }
 
+    if (s->stream)
+        select_candidate(ctx, frame);
+
     // no selection until the buffer of N frames is filled up
     s->n++;
     if (s->n < s->n_frames)
@@ -207,7 +292,7 @@ static av_cold void uninit(AVFilterContext *ctx)
 {
     int i;
     ThumbContext *s = ctx->priv;
-    for (i = 0; i < s->n_frames && s->frames && s->frames[i].buf; i++)
+    for (i = 0; i < (s->stream ? 2 : s->n_frames) && s->frames && s->frames[i].buf; i++)
         av_frame_free(&s->frames[i].buf);
     av_freep(&s->frames);
 }
@@ -20,6 +20,7 @@
 
 #include "libavutil/imgutils.h"
 #include "libavutil/eval.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixfmt.h"
 #include "avfilter.h"
@@ -27,6 +28,7 @@
 #include "internal.h"
 #include "filters.h"
 #include "video.h"
+#include "xfade.h"
 
 enum XFadeTransitions {
     CUSTOM = -1,
@@ -101,6 +103,11 @@ typedef struct XFadeContext {
     uint16_t black[4];
     uint16_t white[4];
 
+    float *noise;
+    ptrdiff_t noise_linesize;
+
+    XFadeDSPContext dsp;
+
     void (*transitionf)(AVFilterContext *ctx, const AVFrame *a, const AVFrame *b, AVFrame *out, float progress,
                         int slice_start, int slice_end, int jobnr);
 
@@ -148,6 +155,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     XFadeContext *s = ctx->priv;
 
     av_expr_free(s->e);
+    av_freep(&s->noise);
 }
 
 #define OFFSET(x) offsetof(XFadeContext, x)
@@ -266,282 +274,229 @@ static inline float smoothstep(float edge0, float edge1, float x)
     return t * t * (3.f - 2.f * t);
 }
 
-#define FADE_TRANSITION(name, type, div)                                             \
-static void fade##name##_transition(AVFilterContext *ctx,                            \
-                            const AVFrame *a, const AVFrame *b, AVFrame *out,        \
-                            float progress,                                          \
-                            int slice_start, int slice_end, int jobnr)               \
+#define FADE(name, type)                                                             \
+static void fade##name##_c(uint8_t *dstp, const uint8_t *ap, const uint8_t *bp,      \
+                           ptrdiff_t width, float progress)                          \
 {                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = mix(xf0[x], xf1[x], progress);                              \
-            }                                                                        \
+    const type *a = (const type *)ap;                                                \
+    const type *b = (const type *)bp;                                                \
+    type *dst = (type *)dstp;                                                        \
                                                                                      \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    for (int x = 0; x < width; x++)                                                  \
+        dst[x] = mix(a[x], b[x], progress);                                          \
 }
 
-FADE_TRANSITION(8, uint8_t, 1)
-FADE_TRANSITION(16, uint16_t, 2)
+FADE(8, uint8_t)
+FADE(16, uint16_t)
 
-#define WIPELEFT_TRANSITION(name, type, div)                                         \
-static void wipeleft##name##_transition(AVFilterContext *ctx,                        \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->width * progress;                                             \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = x > z ? xf1[x] : xf0[x];                                    \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
-}
+static void fade_transition(AVFilterContext *ctx,
+                            const AVFrame *a, const AVFrame *b, AVFrame *out,
+                            float progress,
+                            int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int height = slice_end - slice_start;
 
-WIPELEFT_TRANSITION(8, uint8_t, 1)
-WIPELEFT_TRANSITION(16, uint16_t, 2)
+    for (int p = 0; p < s->nb_planes; p++) {
+        const uint8_t *xf0 = a->data[p] + slice_start * a->linesize[p];
+        const uint8_t *xf1 = b->data[p] + slice_start * b->linesize[p];
+        uint8_t *dst = out->data[p] + slice_start * out->linesize[p];
 
-#define WIPERIGHT_TRANSITION(name, type, div)                                        \
-static void wiperight##name##_transition(AVFilterContext *ctx,                       \
-                                 const AVFrame *a, const AVFrame *b, AVFrame *out,   \
-                                 float progress,                                     \
-                                 int slice_start, int slice_end, int jobnr)          \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->width * (1.f - progress);                                     \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = x > z ? xf0[x] : xf1[x];                                    \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
-}
+        for (int y = 0; y < height; y++) {
+            s->dsp.fade(dst, xf0, xf1, out->width, progress);
 
-WIPERIGHT_TRANSITION(8, uint8_t, 1)
-WIPERIGHT_TRANSITION(16, uint16_t, 2)
+            dst += out->linesize[p];
+            xf0 += a->linesize[p];
+            xf1 += b->linesize[p];
+        }
+    }
+}
 
-#define WIPEUP_TRANSITION(name, type, div)                                           \
-static void wipeup##name##_transition(AVFilterContext *ctx,                          \
-                              const AVFrame *a, const AVFrame *b, AVFrame *out,      \
-                              float progress,                                        \
-                              int slice_start, int slice_end, int jobnr)             \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->height * progress;                                            \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > z ? xf1[x] : xf0[x];                      \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+/**
+ * Fill a row with the first split pixels of left and the remaining ones of
+ * right, each taken at the same position.
+ */
+static void copy_split(uint8_t *dst, const uint8_t *left, const uint8_t *right,
+                       int split, int width, int bpp)
+{
+    split = av_clip(split, 0, width);
+    memcpy(dst, left, split * bpp);
+    memcpy(dst + split * bpp, right + split * bpp, (width - split) * bpp);
 }
 
-WIPEUP_TRANSITION(8, uint8_t, 1)
-WIPEUP_TRANSITION(16, uint16_t, 2)
+static void wipeleft_transition(AVFilterContext *ctx,
+                                const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                float progress,
+                                int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int z = out->width * progress;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            copy_split(out->data[p] + y * out->linesize[p],
+                       a->data[p] + y * a->linesize[p],
+                       b->data[p] + y * b->linesize[p],
+                       z + 1, out->width, bpp);
+        }
+    }
+}
 
-#define WIPEDOWN_TRANSITION(name, type, div)                                         \
-static void wipedown##name##_transition(AVFilterContext *ctx,                        \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int z = out->height * (1.f - progress);                                    \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                dst[x] = slice_start + y > z ? xf0[x] : xf1[x];                      \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+static void wiperight_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int z = out->width * (1.f - progress);
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            copy_split(out->data[p] + y * out->linesize[p],
+                       b->data[p] + y * b->linesize[p],
+                       a->data[p] + y * a->linesize[p],
+                       z + 1, out->width, bpp);
+        }
+    }
 }
 
-WIPEDOWN_TRANSITION(8, uint8_t, 1)
-WIPEDOWN_TRANSITION(16, uint16_t, 2)
+static void wipeup_transition(AVFilterContext *ctx,
+                              const AVFrame *a, const AVFrame *b, AVFrame *out,
+                              float progress,
+                              int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int z = out->height * progress;
 
-#define SLIDELEFT_TRANSITION(name, type, div)                                        \
-static void slideleft##name##_transition(AVFilterContext *ctx,                       \
-                                 const AVFrame *a, const AVFrame *b, AVFrame *out,   \
-                                 float progress,                                     \
-                                 int slice_start, int slice_end, int jobnr)          \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int width = out->width;                                                    \
-    const int z = -progress * width;                                                 \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < width; x++) {                                        \
-                const int zx = z + x;                                                \
-                const int zz = zx % width + width * (zx < 0);                        \
-                dst[x] = (zx > 0) && (zx < width) ? xf1[zz] : xf0[zz];               \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            const AVFrame *src = y > z ? b : a;
+
+            memcpy(out->data[p] + y * out->linesize[p],
+                   src->data[p] + y * src->linesize[p], out->width * bpp);
+        }
+    }
 }
 
-SLIDELEFT_TRANSITION(8, uint8_t, 1)
-SLIDELEFT_TRANSITION(16, uint16_t, 2)
+static void wipedown_transition(AVFilterContext *ctx,
+                                const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                float progress,
+                                int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int z = out->height * (1.f - progress);
 
-#define SLIDERIGHT_TRANSITION(name, type, div)                                       \
-static void slideright##name##_transition(AVFilterContext *ctx,                      \
-                                  const AVFrame *a, const AVFrame *b, AVFrame *out,  \
-                                  float progress,                                    \
-                                  int slice_start, int slice_end, int jobnr)         \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int width = out->width;                                                    \
-    const int z = progress * width;                                                  \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < out->width; x++) {                                   \
-                const int zx = z + x;                                                \
-                const int zz = zx % width + width * (zx < 0);                        \
-                dst[x] = (zx > 0) && (zx < width) ? xf1[zz] : xf0[zz];               \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
-}
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            const AVFrame *src = y > z ? a : b;
 
-SLIDERIGHT_TRANSITION(8, uint8_t, 1)
-SLIDERIGHT_TRANSITION(16, uint16_t, 2)
+            memcpy(out->data[p] + y * out->linesize[p],
+                   src->data[p] + y * src->linesize[p], out->width * bpp);
+        }
+    }
+}
 
-#define SLIDEUP_TRANSITION(name, type, div)                                         \
-static void slideup##name##_transition(AVFilterContext *ctx,                        \
-                               const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                               float progress,                                      \
-                               int slice_start, int slice_end, int jobnr)           \
-{                                                                                   \
-    XFadeContext *s = ctx->priv;                                                    \
-    const int height = out->height;                                                 \
-    const int z = -progress * height;                                               \
-                                                                                    \
-    for (int p = 0; p < s->nb_planes; p++) {                                        \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);        \
-                                                                                    \
-        for (int y = slice_start; y < slice_end; y++) {                             \
-            const int zy = z + y;                                                   \
-            const int zz = zy % height + height * (zy < 0);                         \
-            const type *xf0 = (const type *)(a->data[p] + zz * a->linesize[p]);     \
-            const type *xf1 = (const type *)(b->data[p] + zz * b->linesize[p]);     \
-                                                                                    \
-            for (int x = 0; x < out->width; x++) {                                  \
-                dst[x] = (zy > 0) && (zy < height) ? xf1[x] : xf0[x];               \
-            }                                                                       \
-                                                                                    \
-            dst += out->linesize[p] / div;                                          \
-        }                                                                           \
-    }                                                                               \
+static void slideleft_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int width = out->width;
+    const int z = progress * width;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            const uint8_t *xf0 = a->data[p] + y * a->linesize[p];
+            const uint8_t *xf1 = b->data[p] + y * b->linesize[p];
+            uint8_t *dst = out->data[p] + y * out->linesize[p];
+
+            /* the end of a, then the first pixel of a, then b shifted left */
+            memcpy(dst, xf0 + (width - z) * bpp, z * bpp);
+            if (z < width) {
+                memcpy(dst + z * bpp, xf0, bpp);
+                memcpy(dst + (z + 1) * bpp, xf1 + bpp, (width - z - 1) * bpp);
+            }
+        }
+    }
 }
 
-SLIDEUP_TRANSITION(8, uint8_t, 1)
-SLIDEUP_TRANSITION(16, uint16_t, 2)
+static void slideright_transition(AVFilterContext *ctx,
+                                  const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                  float progress,
+                                  int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int width = out->width;
+    const int z = progress * width;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            const uint8_t *xf0 = a->data[p] + y * a->linesize[p];
+            const uint8_t *xf1 = b->data[p] + y * b->linesize[p];
+            uint8_t *dst = out->data[p] + y * out->linesize[p];
+
+            /* b shifted right, then the start of a */
+            if (z > 0) {
+                memcpy(dst, xf1 + z * bpp, (width - z) * bpp);
+                memcpy(dst + (width - z) * bpp, xf0, z * bpp);
+            } else {
+                memcpy(dst, xf0, bpp);
+                memcpy(dst + bpp, xf1 + bpp, (width - 1) * bpp);
+            }
+        }
+    }
+}
 
-#define SLIDEDOWN_TRANSITION(name, type, div)                                       \
-static void slidedown##name##_transition(AVFilterContext *ctx,                      \
-                                 const AVFrame *a, const AVFrame *b, AVFrame *out,  \
-                                 float progress,                                    \
-                                 int slice_start, int slice_end, int jobnr)         \
-{                                                                                   \
-    XFadeContext *s = ctx->priv;                                                    \
-    const int height = out->height;                                                 \
-    const int z = progress * height;                                                \
-                                                                                    \
-    for (int p = 0; p < s->nb_planes; p++) {                                        \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);        \
-                                                                                    \
-        for (int y = slice_start; y < slice_end; y++) {                             \
-            const int zy = z + y;                                                   \
-            const int zz = zy % height + height * (zy < 0);                         \
-            const type *xf0 = (const type *)(a->data[p] + zz * a->linesize[p]);     \
-            const type *xf1 = (const type *)(b->data[p] + zz * b->linesize[p]);     \
-                                                                                    \
-            for (int x = 0; x < out->width; x++) {                                  \
-                dst[x] = (zy > 0) && (zy < height) ? xf1[x] : xf0[x];               \
-            }                                                                       \
-                                                                                    \
-            dst += out->linesize[p] / div;                                          \
-        }                                                                           \
-    }                                                                               \
+static void slideup_transition(AVFilterContext *ctx,
+                               const AVFrame *a, const AVFrame *b, AVFrame *out,
+                               float progress,
+                               int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int height = out->height;
+    const int z = -progress * height;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            const int zy = z + y;
+            const int zz = (zy + height) % height;
+            const AVFrame *src = (zy > 0) && (zy < height) ? b : a;
+
+            memcpy(out->data[p] + y * out->linesize[p],
+                   src->data[p] + zz * src->linesize[p], out->width * bpp);
+        }
+    }
 }
 
-SLIDEDOWN_TRANSITION(8, uint8_t, 1)
-SLIDEDOWN_TRANSITION(16, uint16_t, 2)
+static void slidedown_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+    const int bpp = 1 + (s->depth > 8);
+    const int height = out->height;
+    const int z = progress * height;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            const int zy = z + y;
+            const int zz = zy % height;
+            const AVFrame *src = (zy > 0) && (zy < height) ? b : a;
+
+            memcpy(out->data[p] + y * out->linesize[p],
+                   src->data[p] + zz * src->linesize[p], out->width * bpp);
+        }
+    }
+}
 
 #define CIRCLECROP_TRANSITION(name, type, div)                                      \
 static void circlecrop##name##_transition(AVFilterContext *ctx,                     \
@@ -1023,31 +978,56 @@ static float frand(int x, int y)
     return r - floorf(r);
 }
 
-#define DISSOLVE_TRANSITION(name, type, div)                                         \
-static void dissolve##name##_transition(AVFilterContext *ctx,                        \
-                            const AVFrame *a, const AVFrame *b, AVFrame *out,        \
-                            float progress,                                          \
-                            int slice_start, int slice_end, int jobnr)               \
+#define DISSOLVE(name, type)                                                         \
+static void dissolve##name##_c(uint8_t *dstp, const uint8_t *ap, const uint8_t *bp,  \
+                               const float *noise, ptrdiff_t width, float progress)  \
 {                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int width = out->width;                                                    \
+    const type *a = (const type *)ap;                                                \
+    const type *b = (const type *)bp;                                                \
+    type *dst = (type *)dstp;                                                        \
                                                                                      \
-    for (int y = slice_start; y < slice_end; y++) {                                  \
-        for (int x = 0; x < width; x++) {                                            \
-            const float smooth = frand(x, y) * 2.f + progress * 2.f - 1.5f;          \
-            for (int p = 0; p < s->nb_planes; p++) {                                 \
-                const type *xf0 = (const type *)(a->data[p] + y * a->linesize[p]);   \
-                const type *xf1 = (const type *)(b->data[p] + y * b->linesize[p]);   \
-                type *dst = (type *)(out->data[p] + y * out->linesize[p]);           \
-                                                                                     \
-                dst[x] = smooth >= 0.5f ? xf0[x] : xf1[x];                           \
-            }                                                                        \
-        }                                                                            \
+    for (int x = 0; x < width; x++) {                                                \
+        const float smooth = noise[x] * 2.f + progress * 2.f - 1.5f;                 \
+        dst[x] = smooth >= 0.5f ? a[x] : b[x];                                       \
     }                                                                                \
 }
 
-DISSOLVE_TRANSITION(8, uint8_t, 1)
-DISSOLVE_TRANSITION(16, uint16_t, 2)
+DISSOLVE(8, uint8_t)
+DISSOLVE(16, uint16_t)
+
+static void dissolve_transition(AVFilterContext *ctx,
+                                const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                float progress,
+                                int slice_start, int slice_end, int jobnr)
+{
+    XFadeContext *s = ctx->priv;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        for (int y = slice_start; y < slice_end; y++) {
+            s->dsp.dissolve(out->data[p] + y * out->linesize[p],
+                            a->data[p] + y * a->linesize[p],
+                            b->data[p] + y * b->linesize[p],
+                            s->noise + y * s->noise_linesize,
+                            out->width, progress);
+        }
+    }
+}
+
+/* frand() is too slow to be evaluated for every pixel of every frame */
+static int init_noise(XFadeContext *s, int width, int height)
+{
+    av_freep(&s->noise);
+    s->noise_linesize = FFALIGN(width, 16);
+    s->noise = av_calloc(height, s->noise_linesize * sizeof(*s->noise));
+    if (!s->noise)
+        return AVERROR(ENOMEM);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            s->noise[y * s->noise_linesize + x] = frand(x, y);
+
+    return 0;
+}
 
 #define PIXELIZE_TRANSITION(name, type, div)                                         \
 static void pixelize##name##_transition(AVFilterContext *ctx,                        \
@@ -1666,6 +1646,17 @@ static double b1(void *priv, double x, double y) { return getpix(priv, x, y, 1,
 static double b2(void *priv, double x, double y) { return getpix(priv, x, y, 2, 1); }
 static double b3(void *priv, double x, double y) { return getpix(priv, x, y, 3, 1); }
 
+void ff_xfade_init(XFadeDSPContext *dsp, int depth)
+{
+    dsp->fade     = depth <= 8 ? fade8_c     : fade16_c;
+    dsp->dissolve = depth <= 8 ? dissolve8_c : dissolve16_c;
+
+    if (ARCH_AARCH64)
+        ff_xfade_init_aarch64(dsp, depth);
+    if (ARCH_X86)
+        ff_xfade_init_x86(dsp, depth);
+}
+
 static int config_output(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
@@ -1738,15 +1729,15 @@ static int config_output(AVFilterLink *outlink)
 
     switch (s->transition) {
     case CUSTOM:     s->transitionf = s->depth <= 8 ? custom8_transition     : custom16_transition;     break;
-    case FADE:       s->transitionf = s->depth <= 8 ? fade8_transition       : fade16_transition;       break;
-    case WIPELEFT:   s->transitionf = s->depth <= 8 ? wipeleft8_transition   : wipeleft16_transition;   break;
-    case WIPERIGHT:  s->transitionf = s->depth <= 8 ? wiperight8_transition  : wiperight16_transition;  break;
-    case WIPEUP:     s->transitionf = s->depth <= 8 ? wipeup8_transition     : wipeup16_transition;     break;
-    case WIPEDOWN:   s->transitionf = s->depth <= 8 ? wipedown8_transition   : wipedown16_transition;   break;
-    case SLIDELEFT:  s->transitionf = s->depth <= 8 ? slideleft8_transition  : slideleft16_transition;  break;
-    case SLIDERIGHT: s->transitionf = s->depth <= 8 ? slideright8_transition : slideright16_transition; break;
-    case SLIDEUP:    s->transitionf = s->depth <= 8 ? slideup8_transition    : slideup16_transition;    break;
-    case SLIDEDOWN:  s->transitionf = s->depth <= 8 ? slidedown8_transition  : slidedown16_transition;  break;
+    case FADE:       s->transitionf = fade_transition; break;
+    case WIPELEFT:   s->transitionf = wipeleft_transition; break;
+    case WIPERIGHT:  s->transitionf = wiperight_transition; break;
+    case WIPEUP:     s->transitionf = wipeup_transition; break;
+    case WIPEDOWN:   s->transitionf = wipedown_transition; break;
+    case SLIDELEFT:  s->transitionf = slideleft_transition; break;
+    case SLIDERIGHT: s->transitionf = slideright_transition; break;
+    case SLIDEUP:    s->transitionf = slideup_transition; break;
+    case SLIDEDOWN:  s->transitionf = slidedown_transition; break;
     case CIRCLECROP: s->transitionf = s->depth <= 8 ? circlecrop8_transition : circlecrop16_transition; break;
     case RECTCROP:   s->transitionf = s->depth <= 8 ? rectcrop8_transition   : rectcrop16_transition;   break;
     case DISTANCE:   s->transitionf = s->depth <= 8 ? distance8_transition   : distance16_transition;   break;
@@ -1763,7 +1754,7 @@ static int config_output(AVFilterLink *outlink)
     case VERTCLOSE:  s->transitionf = s->depth <= 8 ? vertclose8_transition  : vertclose16_transition;  break;
     case HORZOPEN:   s->transitionf = s->depth <= 8 ? horzopen8_transition   : horzopen16_transition;   break;
     case HORZCLOSE:  s->transitionf = s->depth <= 8 ? horzclose8_transition  : horzclose16_transition;  break;
-    case DISSOLVE:   s->transitionf = s->depth <= 8 ? dissolve8_transition   : dissolve16_transition;   break;
+    case DISSOLVE:   s->transitionf = dissolve_transition; break;
     case PIXELIZE:   s->transitionf = s->depth <= 8 ? pixelize8_transition   : pixelize16_transition;   break;
     case DIAGTL:     s->transitionf = s->depth <= 8 ? diagtl8_transition     : diagtl16_transition;     break;
     case DIAGTR:     s->transitionf = s->depth <= 8 ? diagtr8_transition     : diagtr16_transition;     break;
@@ -1783,6 +1774,14 @@ static int config_output(AVFilterLink *outlink)
     case SQUEEZEV:   s->transitionf = s->depth <= 8 ? squeezev8_transition   : squeezev16_transition;   break;
     }
 
+    ff_xfade_init(&s->dsp, s->depth);
+
+    if (s->transition == DISSOLVE) {
+        int ret = init_noise(s, outlink->w, outlink->h);
+        if (ret < 0)
+            return ret;
+    }
+
     if (s->transition == CUSTOM) {
         static const char *const func2_names[]    = {
             "a0", "a1", "a2", "a3",
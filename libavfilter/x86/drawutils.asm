@@ -0,0 +1,172 @@
+;*****************************************************************************
+;* x86-optimized functions for drawutils
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pd_0x1010101: times 8 dd 0x1010101
+pw_128:       times 16 dw 128
+
+SECTION .text
+
+; dst = (dst * (0x1010101 - a) + src * a) >> 24, with a = mask * alpha
+%macro BLEND 4 ; mask/result, dst pixels, tmp, register prefix
+    pmulld          %1, %4 %+ 0
+    psubd           %3, %4 %+ 2, %1
+    pmulld          %2, %3
+    pmulld          %1, %4 %+ 1
+    paddd           %1, %2
+    psrld           %1, 24
+%endmacro
+
+; void ff_draw_blend_row(uint8_t *dst, const uint8_t *mask, int w,
+;                        unsigned src, unsigned alpha)
+%macro BLEND_ROW 0
+cglobal draw_blend_row, 5, 6, 6, dst, mask, w, src, alpha, tmp
+    movd           xm0, alphad
+    movd           xm1, srcd
+%if cpuflag(avx2)
+    vpbroadcastd    m0, xm0
+    vpbroadcastd    m1, xm1
+%else
+    pshufd          m0, m0, 0
+    pshufd          m1, m1, 0
+%endif
+    mova            m2, [pd_0x1010101]
+    sub             wd, mmsize / 4
+    jl .tail
+
+.loop:
+    pmovzxbd        m3, [maskq]
+    pmovzxbd        m4, [dstq]
+    BLEND           m3, m4, m5, m
+%if mmsize == 32
+    vextracti128   xm4, m3, 1
+    packusdw       xm3, xm4
+    packuswb       xm3, xm3
+    movq        [dstq], xm3
+%else
+    packusdw        m3, m3
+    packuswb        m3, m3
+    movd        [dstq], m3
+%endif
+    add          maskq, mmsize / 4
+    add           dstq, mmsize / 4
+    sub             wd, mmsize / 4
+    jge .loop
+
+.tail:
+    add             wd, mmsize / 4
+    jz .end
+.tail_loop:
+    movzx         tmpd, byte [maskq]
+    movd           xm3, tmpd
+    movzx         tmpd, byte [dstq]
+    movd           xm4, tmpd
+    BLEND          xm3, xm4, xm5, xm
+    pextrb      [dstq], xm3, 0
+    inc          maskq
+    inc           dstq
+    dec             wd
+    jg .tail_loop
+.end:
+    RET
+%endmacro
+
+INIT_XMM sse4
+BLEND_ROW
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+BLEND_ROW
+%endif
+
+; dst = min(val + dst * trans / 255, 255), the division being rounded as
+; (t + (t >> 8)) >> 8 with t = dst * trans + 128
+%macro BLEND_LAYER 6 ; dst/result, trans, val, tmp, tmp, zero
+    punpckhbw       %4, %1, %6
+    punpcklbw       %1, %6
+    punpckhbw       %5, %2, %6
+    punpcklbw       %2, %6
+    pmullw          %1, %2
+    pmullw          %4, %5
+    paddw           %1, [pw_128]
+    paddw           %4, [pw_128]
+    psrlw           %2, %1, 8
+    psrlw           %5, %4, 8
+    paddw           %1, %2
+    paddw           %4, %5
+    psrlw           %1, 8
+    psrlw           %4, 8
+    packuswb        %1, %4
+    paddusb         %1, %3
+%endmacro
+
+; void ff_draw_blend_layer_row(uint8_t *dst, const uint8_t *val,
+;                              const uint8_t *trans, int w)
+%macro BLEND_LAYER_ROW 0
+cglobal draw_blend_layer_row, 4, 5, 6, dst, val, trans, w, tmp
+    pxor            m5, m5
+    sub             wd, mmsize
+    jl .tail
+
+.loop:
+    movu            m0, [dstq]
+    movu            m1, [transq]
+    movu            m2, [valq]
+    BLEND_LAYER     m0, m1, m2, m3, m4, m5
+    movu        [dstq], m0
+    add           dstq, mmsize
+    add           valq, mmsize
+    add         transq, mmsize
+    sub             wd, mmsize
+    jge .loop
+
+.tail:
+    add             wd, mmsize
+    jz .end
+    ; the byte store needs a register with a low byte on x86_32
+    mov           tmpd, wd
+    DEFINE_ARGS dst, val, trans, px, cnt
+.tail_loop:
+    movzx          pxd, byte [dstq]
+    movd           xm0, pxd
+    movzx          pxd, byte [transq]
+    movd           xm1, pxd
+    movzx          pxd, byte [valq]
+    movd           xm2, pxd
+    BLEND_LAYER    xm0, xm1, xm2, xm3, xm4, xm5
+    movd           pxd, xm0
+    mov         [dstq], pxb
+    inc           dstq
+    inc           valq
+    inc         transq
+    dec            cntd
+    jg .tail_loop
+.end:
+    RET
+%endmacro
+
+INIT_XMM sse2
+BLEND_LAYER_ROW
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+BLEND_LAYER_ROW
+%endif
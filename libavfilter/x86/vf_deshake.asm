@@ -0,0 +1,54 @@
+;*****************************************************************************
+;* x86-optimized functions for deshake filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION .text
+
+INIT_XMM sse2
+; void ff_deshake_block_minmax_sse2(const uint8_t *src, ptrdiff_t stride, int h,
+;                                   uint8_t *lowest, uint8_t *highest)
+cglobal deshake_block_minmax, 5, 5, 3, src, stride, h, lowest, highest
+    movu            m0, [srcq]
+    mova            m1, m0
+    add           srcq, strideq
+    dec             hd
+    jz .end
+.loop:
+    movu            m2, [srcq]
+    pminub          m0, m2
+    pmaxub          m1, m2
+    add           srcq, strideq
+    dec             hd
+    jg .loop
+.end:
+%assign shift 8
+%rep 4
+    psrldq          m2, m0, shift
+    pminub          m0, m2
+    psrldq          m2, m1, shift
+    pmaxub          m1, m2
+%assign shift shift/2
+%endrep
+    movd           r2d, m0
+    mov      [lowestq], r2b
+    movd           r2d, m1
+    mov     [highestq], r2b
+    RET
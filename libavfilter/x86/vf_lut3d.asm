@@ -0,0 +1,222 @@
+;*****************************************************************************
+;* x86-optimized functions for lut3d filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pd_3: times 8 dd 3
+ps_1: times 8 dd 1.0
+
+SECTION .text
+
+%if ARCH_X86_64 && HAVE_AVX2_EXTERNAL
+
+; m15 = lutsize - 1, m14 = lut offset of the next r, m13 = lut offset of the
+; next g; the lut offset of the next b is 3
+%macro LUT3D_INIT 0
+    mov          dstrq, [dstq]
+    mov          dstgq, [dstq + gprsize]
+    mov          dstbq, [dstq + gprsize * 2]
+    mov          srcrq, [srcq]
+    mov          srcgq, [srcq + gprsize]
+    mov          srcbq, [srcq + gprsize * 2]
+    lea           dstd, [lutsizeq + lutsizeq * 2]
+    movd          xm13, dstd
+    imul          dstd, lutsized
+    movd          xm14, dstd
+    dec       lutsized
+    movd          xm15, lutsized
+    vpbroadcastd   m13, xm13
+    vpbroadcastd   m14, xm14
+    vpbroadcastd   m15, xm15
+    movsxdifnidn widthq, widthd
+    shl         widthq, 2
+    add          dstrq, widthq
+    add          dstgq, widthq
+    add          dstbq, widthq
+    add          srcrq, widthq
+    add          srcgq, widthq
+    add          srcbq, widthq
+    neg         widthq
+%endmacro
+
+; Loads the coordinates of the next points, leaving the fractional parts in
+; m0-m2, the lut offset of the lower vertex in m3 and the offsets to the next
+; r, g and b vertices, 0 on the upper edge of the lut, in m6-m8.
+%macro LUT3D_LOAD 0
+    movu            m0, [srcrq + widthq]
+    movu            m1, [srcgq + widthq]
+    movu            m2, [srcbq + widthq]
+    cvttps2dq       m3, m0
+    cvttps2dq       m4, m1
+    cvttps2dq       m5, m2
+    cvtdq2ps        m6, m3
+    subps           m0, m6
+    cvtdq2ps        m6, m4
+    subps           m1, m6
+    cvtdq2ps        m6, m5
+    subps           m2, m6
+    pcmpgtd         m6, m15, m3
+    pcmpgtd         m7, m15, m4
+    pcmpgtd         m8, m15, m5
+    pand            m6, m14
+    pand            m7, m13
+    pand            m8, [pd_3]
+    pmulld          m3, m14
+    pmulld          m4, m13
+    pmulld          m5, [pd_3]
+    paddd           m3, m4
+    paddd           m3, m5
+%endmacro
+
+%macro GATHER 3 ; dst, offsets, component
+    pcmpeqd        m12, m12
+    vgatherdps      %1, [lutq + %2 * 4 + %3 * 4], m12
+%endmacro
+
+INIT_YMM avx2
+
+; void ff_lut3d_interp_tetrahedral_avx2(float *const dst[3], const float *const src[3],
+;                                       const float *lut, int lutsize, int width)
+;
+; The vertices of the tetrahedron are the lower vertex, the next vertex along
+; the axis with the largest fractional part, the next vertex along the two
+; largest, and the upper vertex. The weights of the vertices picked on ties
+; are 0, which avoids branching on the 6 orderings.
+cglobal lut3d_interp_tetrahedral, 5, 11, 16, dst, src, lut, lutsize, width, dstr, dstg, dstb, srcr, srcg, srcb
+    LUT3D_INIT
+
+.loop:
+    LUT3D_LOAD
+    paddd           m9, m6, m7
+    paddd           m9, m8              ; offset to the upper vertex
+
+    ; offset to the next vertex along the largest axis
+    cmpnltps        m4, m1, m2
+    blendvps       m10, m8, m7, m4
+    cmpnltps        m5, m0, m1
+    cmpnltps       m11, m0, m2
+    andps           m5, m11
+    blendvps       m10, m10, m6, m5
+
+    ; offset to the next vertex along the smallest axis
+    cmpleps         m4, m1, m2
+    blendvps       m11, m8, m7, m4
+    cmpleps         m5, m0, m1
+    cmpleps        m12, m0, m2
+    andps           m5, m12
+    blendvps       m11, m11, m6, m5
+
+    paddd          m10, m3
+    psubd          m11, m9, m11
+    paddd          m11, m3
+    paddd           m9, m3
+
+    maxps           m4, m0, m1
+    minps           m5, m0, m1
+    maxps           m6, m4, m2          ; largest
+    minps           m7, m5, m2          ; smallest
+    minps           m4, m2
+    maxps           m4, m5              ; middle
+    mova            m5, [ps_1]
+    subps           m5, m6
+    subps           m6, m4
+    subps           m4, m7
+
+%assign c 0
+%rep 3
+    GATHER          m0, m3, c
+    mulps           m0, m5
+    GATHER          m1, m10, c
+    fmaddps         m0, m1, m6, m0
+    GATHER          m1, m11, c
+    fmaddps         m0, m1, m4, m0
+    GATHER          m1, m9, c
+    fmaddps         m0, m1, m7, m0
+%if c == 0
+    movu   [dstrq + widthq], m0
+%elif c == 1
+    movu   [dstgq + widthq], m0
+%else
+    movu   [dstbq + widthq], m0
+%endif
+%assign c c+1
+%endrep
+
+    add         widthq, mmsize
+    jl .loop
+    RET
+
+%macro LERP 3 ; v0/dst, v1, f
+    subps           %2, %1
+    fmaddps         %1, %2, %3, %1
+%endmacro
+
+; void ff_lut3d_interp_trilinear_avx2(float *const dst[3], const float *const src[3],
+;                                     const float *lut, int lutsize, int width)
+cglobal lut3d_interp_trilinear, 5, 11, 16, dst, src, lut, lutsize, width, dstr, dstg, dstb, srcr, srcg, srcb
+    LUT3D_INIT
+
+.loop:
+    LUT3D_LOAD
+    paddd           m9, m3, m6          ; offset of c100
+    paddd          m10, m3, m7          ; offset of c010
+
+%assign c 0
+%rep 3
+    GATHER          m5, m3, c
+    GATHER          m6, m9, c
+    LERP            m5, m6, m0          ; c00
+    GATHER          m6, m10, c
+    paddd           m4, m9, m10
+    psubd           m4, m3
+    GATHER          m7, m4, c
+    LERP            m6, m7, m0          ; c10
+    LERP            m5, m6, m1          ; c0
+    paddd           m4, m3, m8
+    GATHER          m6, m4, c
+    paddd           m4, m9, m8
+    GATHER          m7, m4, c
+    LERP            m6, m7, m0          ; c01
+    paddd           m4, m10, m8
+    GATHER          m7, m4, c
+    paddd           m4, m9, m10
+    psubd           m4, m3
+    paddd           m4, m8
+    GATHER         m11, m4, c
+    LERP            m7, m11, m0         ; c11
+    LERP            m6, m7, m1          ; c1
+    LERP            m5, m6, m2          ; c
+%if c == 0
+    movu   [dstrq + widthq], m5
+%elif c == 1
+    movu   [dstgq + widthq], m5
+%else
+    movu   [dstbq + widthq], m5
+%endif
+%assign c c+1
+%endrep
+
+    add         widthq, mmsize
+    jl .loop
+    RET
+
+%endif
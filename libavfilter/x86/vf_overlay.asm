@@ -23,12 +23,12 @@
 
 %include "libavutil/x86/x86util.asm"
 
-SECTION_RODATA
+SECTION_RODATA 32
 
+pw_257:   times 16 dw 257
 pb_1:     times 16 db 1
 pw_128:   times  8 dw 128
 pw_255:   times  8 dw 255
-pw_257:   times  8 dw 257
 
 SECTION .text
 
@@ -142,3 +142,61 @@ cglobal overlay_row_20, 6, 7, 7, 0, d, da, s, a, w, r, x
     .end:
     mov    eax, xd
     RET
+
+; int ff_overlay_blend_layer_row(uint8_t *d, const uint16_t *val,
+;                                const uint8_t *trans, int w)
+;
+; d = ((d * trans + val) * 257) >> 16, returns the number of bytes processed
+%macro BLEND_LAYER_ROW 0
+cglobal overlay_blend_layer_row, 4, 5, 6, d, val, trans, w, x
+    movsxdifnidn wq, wd
+    xor          xq, xq
+    and          wq, ~(mmsize - 1)
+    jz .end
+    mova         m4, [pw_257]
+%if notcpuflag(avx2)
+    pxor         m5, m5
+%endif
+    .loop:
+%if cpuflag(avx2)
+        pmovzxbw    m0, [dq+xq]
+        pmovzxbw    m1, [dq+xq+mmsize/2]
+        pmovzxbw    m2, [transq+xq]
+        pmovzxbw    m3, [transq+xq+mmsize/2]
+%else
+        movu        m0, [dq+xq]
+        movu        m2, [transq+xq]
+        punpckhbw   m1, m0, m5
+        punpcklbw   m0, m5
+        punpckhbw   m3, m2, m5
+        punpcklbw   m2, m5
+%endif
+        pmullw      m0, m2
+        pmullw      m1, m3
+        movu        m2, [valq+2*xq]
+        movu        m3, [valq+2*xq+mmsize]
+        paddw       m0, m2
+        paddw       m1, m3
+        pmulhuw     m0, m4
+        pmulhuw     m1, m4
+        packuswb    m0, m1
+%if cpuflag(avx2)
+        vpermq      m0, m0, q3120
+%endif
+        movu   [dq+xq], m0
+        add         xq, mmsize
+        cmp         xq, wq
+        jl .loop
+
+    .end:
+    mov    eax, wd
+    RET
+%endmacro
+
+INIT_XMM sse2
+BLEND_LAYER_ROW
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+BLEND_LAYER_ROW
+%endif
@@ -32,6 +32,11 @@ int ff_overlay_row_20_sse4(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
 int ff_overlay_row_22_sse4(uint8_t *d, uint8_t *da, uint8_t *s, uint8_t *a,
                            int w, ptrdiff_t alinesize);
 
+int ff_overlay_blend_layer_row_sse2(uint8_t *d, const uint16_t *val,
+                                    const uint8_t *trans, int w);
+int ff_overlay_blend_layer_row_avx2(uint8_t *d, const uint16_t *val,
+                                    const uint8_t *trans, int w);
+
 av_cold void ff_overlay_init_x86(OverlayContext *s, int format, int pix_format,
                                  int alpha_format, int main_has_alpha)
 {
@@ -63,3 +68,13 @@ av_cold void ff_overlay_init_x86(OverlayContext *s, int format, int pix_format,
         s->blend_row[2] = ff_overlay_row_22_sse4;
     }
 }
+
+av_cold void ff_overlay_layer_init_x86(OverlayContext *s)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags))
+        s->blend_layer_row = ff_overlay_blend_layer_row_sse2;
+    if (EXTERNAL_AVX2_FAST(cpu_flags))
+        s->blend_layer_row = ff_overlay_blend_layer_row_avx2;
+}
@@ -0,0 +1,121 @@
+;*****************************************************************************
+;* x86-optimized functions for paletteuse filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pd_0to7: dd 0, 1, 2, 3, 4, 5, 6, 7
+pd_4:    times 4 dd 4
+pd_8:    times 8 dd 8
+
+SECTION .text
+
+; int ff_paletteuse_nearest(const int32_t *pal, int nb, int r, int g, int b)
+;
+; Each lane keeps the nearest entry among the ones it visits, the lowest one
+; on ties since later entries must be strictly nearer to replace it. The
+; lowest index among the lanes at the minimum distance is then returned.
+%macro NEAREST 0
+cglobal paletteuse_nearest, 5, 5, 8, pal, nb, r, g, b
+    movd           xm0, rd
+    movd           xm1, gd
+    movd           xm2, bd
+%if cpuflag(avx2)
+    vpbroadcastd    m0, xm0
+    vpbroadcastd    m1, xm1
+    vpbroadcastd    m2, xm2
+%else
+    pshufd          m0, m0, 0
+    pshufd          m1, m1, 0
+    pshufd          m2, m2, 0
+%endif
+    pcmpeqd         m3, m3
+    psrld           m3, 1               ; nearest distance
+    pxor            m4, m4              ; nearest entry
+    mova            m5, [pd_0to7]       ; current entry
+    movsxdifnidn   nbq, nbd
+    shl            nbq, 2
+    add           palq, nbq
+    neg            nbq
+
+.loop:
+    movu            m6, [palq + nbq]
+    psubd           m6, m0
+    pmulld          m6, m6
+    movu            m7, [palq + nbq + 4 * 256]
+    psubd           m7, m1
+    pmulld          m7, m7
+    paddd           m6, m7
+    movu            m7, [palq + nbq + 8 * 256]
+    psubd           m7, m2
+    pmulld          m7, m7
+    paddd           m6, m7
+    pcmpgtd         m7, m3, m6
+    pminsd          m3, m6
+    pand            m6, m5, m7
+    pandn           m7, m4
+    por             m4, m6, m7
+%if mmsize == 32
+    paddd           m5, [pd_8]
+%else
+    paddd           m5, [pd_4]
+%endif
+    add            nbq, mmsize
+    jl .loop
+
+    ; broadcast the minimum distance
+%if mmsize == 32
+    vextracti128   xm6, m3, 1
+    pminsd         xm6, xm3
+%else
+    mova            m6, m3
+%endif
+    pshufd         xm7, xm6, q1032
+    pminsd         xm6, xm7
+    pshufd         xm7, xm6, q2301
+    pminsd         xm6, xm7
+%if mmsize == 32
+    vpbroadcastd    m6, xm6
+%endif
+
+    ; lowest entry among the lanes at that distance
+    pcmpeqd         m6, m3
+    pcmpeqd         m7, m7
+    pxor            m6, m7
+    por             m4, m6
+%if mmsize == 32
+    vextracti128   xm6, m4, 1
+    pminud         xm4, xm6
+%endif
+    pshufd         xm6, xm4, q1032
+    pminud         xm4, xm6
+    pshufd         xm6, xm4, q2301
+    pminud         xm4, xm6
+    movd           eax, xm4
+    RET
+%endmacro
+
+INIT_XMM sse4
+NEAREST
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+NEAREST
+%endif
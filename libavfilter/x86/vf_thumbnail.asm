@@ -0,0 +1,68 @@
+;*****************************************************************************
+;* x86-optimized functions for thumbnail filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION .text
+
+; Counts the 4 bytes of the low dword of m0 in the 4 histograms, and shifts
+; the next dword in.
+%macro COUNT_DWORD 0
+    movd            ad, m0
+    psrldq          m0, 4
+%assign k 0
+%rep 3
+    mov             bd, ad
+    and             bd, 0xff
+    shr             ad, 8
+    inc dword [histq + bq * 4 + k * 1024]
+%assign k k+1
+%endrep
+    inc dword [histq + aq * 4 + 3 * 1024]
+%endmacro
+
+INIT_XMM sse2
+
+; int ff_thumbnail_histogram_row_sse2(int *hist, const uint8_t *src, int len)
+;
+; The increments are scalar, as there is no conflict-free scatter; loading 16
+; bytes at once and spreading them over 4 histograms keeps the loads and the
+; store-to-load dependencies between equal neighbouring bytes off the critical
+; path. Returns the number of bytes processed.
+cglobal thumbnail_histogram_row, 3, 6, 1, hist, src, len, x, a, b
+    movsxdifnidn lenq, lend
+    and          lenq, ~15
+    mov            xq, lenq
+    jz .end
+    add          srcq, lenq
+    neg            xq
+
+.loop:
+    movu            m0, [srcq + xq]
+    COUNT_DWORD
+    COUNT_DWORD
+    COUNT_DWORD
+    COUNT_DWORD
+    add             xq, 16
+    jl .loop
+
+.end:
+    mov            eax, lend
+    RET
@@ -0,0 +1,183 @@
+;*****************************************************************************
+;* x86-optimized functions for xfade filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;******************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+ps_0p5: times 8 dd 0.5
+ps_1:   times 8 dd 1.0
+ps_1p5: times 8 dd 1.5
+
+SECTION .text
+
+; progress is passed in xmm0 on UNIX64 and on the stack otherwise
+%macro LOAD_PROGRESS 1 ; argument index
+%if UNIX64
+    VBROADCASTSS    m0, xm0
+%else
+    VBROADCASTSS    m0, r%1m
+%endif
+%endmacro
+
+; Each iteration handles mmsize / 2 pixels, the row is processed from its end
+; with a negative pixel counter.
+%macro XFADE_INIT 1 ; depth
+%if %1 == 8
+    add           dstq, widthq
+    add             aq, widthq
+    add             bq, widthq
+%else
+    lea           dstq, [dstq + widthq * 2]
+    lea             aq, [aq + widthq * 2]
+    lea             bq, [bq + widthq * 2]
+%endif
+    mov             xq, widthq
+    neg             xq
+%endmacro
+
+; the products are rounded separately and the sum truncated like in the C code
+; void ff_xfade_fade(8|16)(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+;                          ptrdiff_t width, float progress)
+%macro FADE 1 ; depth
+cglobal xfade_fade%1, 4, 5, 6, dst, a, b, width, x
+    LOAD_PROGRESS 4
+    mova            m1, [ps_1]
+    subps           m1, m0
+    XFADE_INIT      %1
+
+.loop:
+%if %1 == 8
+    pmovzxbd        m2, [aq + xq]
+    pmovzxbd        m3, [aq + xq + mmsize / 4]
+    pmovzxbd        m4, [bq + xq]
+    pmovzxbd        m5, [bq + xq + mmsize / 4]
+%else
+    pmovzxwd        m2, [aq + xq * 2]
+    pmovzxwd        m3, [aq + xq * 2 + mmsize / 2]
+    pmovzxwd        m4, [bq + xq * 2]
+    pmovzxwd        m5, [bq + xq * 2 + mmsize / 2]
+%endif
+    cvtdq2ps        m2, m2
+    cvtdq2ps        m3, m3
+    cvtdq2ps        m4, m4
+    cvtdq2ps        m5, m5
+    mulps           m2, m0
+    mulps           m3, m0
+    mulps           m4, m1
+    mulps           m5, m1
+    addps           m2, m4
+    addps           m3, m5
+    cvttps2dq       m2, m2
+    cvttps2dq       m3, m3
+%if %1 == 8
+    packssdw        m2, m3
+%if mmsize == 32
+    vpermq          m2, m2, q3120
+    vextracti128   xm3, m2, 1
+    packuswb       xm2, xm3
+    movu   [dstq + xq], xm2
+%else
+    packuswb        m2, m2
+    movq   [dstq + xq], m2
+%endif
+%else
+    packusdw        m2, m3
+%if mmsize == 32
+    vpermq          m2, m2, q3120
+%endif
+    movu [dstq + xq * 2], m2
+%endif
+    add             xq, mmsize / 2
+    jl .loop
+    RET
+%endmacro
+
+; void ff_xfade_dissolve(8|16)(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+;                              const float *noise, ptrdiff_t width, float progress)
+%macro DISSOLVE 1 ; depth
+cglobal xfade_dissolve%1, 5, 6, 6, dst, a, b, noise, width, x
+    LOAD_PROGRESS 5
+    addps           m0, m0
+    mova            m1, [ps_1p5]
+    mova            m2, [ps_0p5]
+    lea         noiseq, [noiseq + widthq * 4]
+    XFADE_INIT      %1
+
+.loop:
+    movu            m3, [noiseq + xq * 4]
+    movu            m4, [noiseq + xq * 4 + mmsize]
+    addps           m3, m3
+    addps           m4, m4
+    addps           m3, m0
+    addps           m4, m0
+    subps           m3, m1
+    subps           m4, m1
+    cmpnltps        m3, m2
+    cmpnltps        m4, m2
+    packssdw        m3, m4
+%if mmsize == 32
+    vpermq          m3, m3, q3120
+%endif
+%if %1 == 8
+%if mmsize == 32
+    vextracti128   xm4, m3, 1
+    packsswb       xm3, xm4
+    movu           xm4, [aq + xq]
+    movu           xm5, [bq + xq]
+    pand           xm4, xm3
+    pandn          xm3, xm5
+    por            xm3, xm4
+    movu   [dstq + xq], xm3
+%else
+    packsswb        m3, m3
+    movq            m4, [aq + xq]
+    movq            m5, [bq + xq]
+    pand            m4, m3
+    pandn           m3, m5
+    por             m3, m4
+    movq   [dstq + xq], m3
+%endif
+%else
+    movu            m4, [aq + xq * 2]
+    movu            m5, [bq + xq * 2]
+    pand            m4, m3
+    pandn           m3, m5
+    por             m3, m4
+    movu [dstq + xq * 2], m3
+%endif
+    add             xq, mmsize / 2
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse4
+FADE 8
+FADE 16
+DISSOLVE 8
+DISSOLVE 16
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+FADE 8
+FADE 16
+DISSOLVE 8
+DISSOLVE 16
+%endif
@@ -0,0 +1,47 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_XFADE_H
+#define AVFILTER_XFADE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Row functions of the xfade filter. width is in pixels; the SIMD versions
+ * may read and write up to 15 pixels past it, so rows must be padded.
+ */
+typedef struct XFadeDSPContext {
+    /**
+     * dst[x] = a[x] * progress + b[x] * (1 - progress)
+     */
+    void (*fade)(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                 ptrdiff_t width, float progress);
+
+    /**
+     * dst[x] = noise[x] * 2 + progress * 2 - 1.5 >= 0.5 ? a[x] : b[x]
+     */
+    void (*dissolve)(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                     const float *noise, ptrdiff_t width, float progress);
+} XFadeDSPContext;
+
+void ff_xfade_init(XFadeDSPContext *dsp, int depth);
+void ff_xfade_init_aarch64(XFadeDSPContext *dsp, int depth);
+void ff_xfade_init_x86(XFadeDSPContext *dsp, int depth);
+
+#endif /* AVFILTER_XFADE_H */
@@ -349,6 +349,15 @@ typedef struct AVIOContext {
      * Try to buffer at least this amount of data before flushing it
      */
     int min_packet_size;
+
+    /**
+     * Pool of the large buffers returned by ffio_alloc_packet_buffer(),
+     * only used by the contexts opened by libavformat.
+     * Internal, not meant to be used from outside of AVIOContext.
+     */
+    int use_packet_pool;
+    struct AVBufferPool *packet_pool;
+    int packet_pool_size;
 } AVIOContext;
 
 /**
@@ -22,6 +22,7 @@
 #include "avio.h"
 #include "url.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -108,6 +109,18 @@ int ffio_ensure_seekback(AVIOContext *s, int64_t buf_size);
 
 int ffio_limit(AVIOContext *s, int size);
 
+/**
+ * Allocate a buffer for reading size bytes from s, followed by
+ * AV_INPUT_BUFFER_PADDING_SIZE zeroed bytes.
+ *
+ * Large buffers are taken from a pool of the context, so that reading
+ * packets of a high bitrate stream does not allocate and fault in new
+ * memory for each packet.
+ *
+ * @return the buffer, which may be larger than requested, or NULL
+ */
+AVBufferRef *ffio_alloc_packet_buffer(AVIOContext *s, int size);
+
 void ffio_init_checksum(AVIOContext *s,
                         unsigned long (*update_checksum)(unsigned long c, const uint8_t *p, unsigned int len),
                         unsigned long checksum);
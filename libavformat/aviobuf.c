@@ -20,6 +20,7 @@
  */
 
 #include "libavutil/bprint.h"
+#include "libavutil/buffer.h"
 #include "libavutil/crc.h"
 #include "libavutil/dict.h"
 #include "libavutil/intreadwrite.h"
@@ -154,6 +155,8 @@ AVIOContext *avio_alloc_context(
 
 void avio_context_free(AVIOContext **ps)
 {
+    if (*ps)
+        av_buffer_pool_uninit(&(*ps)->packet_pool);
     av_freep(ps);
 }
 
@@ -970,12 +973,47 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
     }
     (*s)->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
     (*s)->av_class = &ff_avio_class;
+    (*s)->use_packet_pool = 1;
     return 0;
 fail:
     av_freep(&buffer);
     return AVERROR(ENOMEM);
 }
 
+/* Smaller buffers are cheap enough to get from the heap. */
+#define PACKET_POOL_MIN_SIZE (256 * 1024)
+
+AVBufferRef *ffio_alloc_packet_buffer(AVIOContext *s, int size)
+{
+    AVBufferRef *buf = NULL;
+
+    if ((unsigned)size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return NULL;
+
+    /* The pool only grows, with some headroom: packets much smaller than
+     * its buffers, such as the non key frames of a long GOP stream, are
+     * allocated separately instead of wasting them. */
+    if (s->use_packet_pool && size >= PACKET_POOL_MIN_SIZE &&
+        size + AV_INPUT_BUFFER_PADDING_SIZE >= s->packet_pool_size / 2) {
+        if (size + AV_INPUT_BUFFER_PADDING_SIZE > s->packet_pool_size) {
+            int64_t pool_size = FFALIGN(size + AV_INPUT_BUFFER_PADDING_SIZE +
+                                        (int64_t)(size >> 3), 1 << 16);
+            av_buffer_pool_uninit(&s->packet_pool);
+            s->packet_pool_size = FFMIN(pool_size, INT_MAX);
+            s->packet_pool = av_buffer_pool_init(s->packet_pool_size, NULL);
+        }
+        if (s->packet_pool)
+            buf = av_buffer_pool_get(s->packet_pool);
+    }
+    if (!buf)
+        buf = av_buffer_alloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!buf)
+        return NULL;
+
+    memset(buf->data + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    return buf;
+}
+
 URLContext* ffio_geturlcontext(AVIOContext *s)
 {
     if (!s)
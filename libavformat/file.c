@@ -35,8 +35,14 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 #include "os_support.h"
 #include "url.h"
+#if HAVE_LINUX_IO_URING_H
+#include "file_uring.h"
+#endif
 
 /* Some systems may not have S_ISFIFO */
 #ifndef S_ISFIFO
@@ -74,6 +80,16 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int use_mmap;
+    uint8_t *map;       ///< mapping of the whole file with mmap=1, or NULL
+    int64_t map_size;
+    int64_t map_pos;
+    int use_uring;
+    int uring_depth;
+    int uring_block_size;
+#if HAVE_LINUX_IO_URING_H
+    FileURing *uring;
+#endif
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -84,6 +100,10 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Read regular files through a memory mapping", offsetof(FileContext, use_mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring", "Read ahead or write behind regular files with io_uring", offsetof(FileContext, use_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_depth", "set the number of io_uring requests in flight", offsetof(FileContext, uring_depth), AV_OPT_TYPE_INT, { .i64 = 8 }, 1, 256, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring_block_size", "set the size of the io_uring requests", offsetof(FileContext, uring_block_size), AV_OPT_TYPE_INT, { .i64 = 262144 }, 4096, 1 << 26, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -111,6 +131,18 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->map) {
+        size = FFMIN(size, c->map_size - c->map_pos);
+        if (size <= 0)
+            return AVERROR_EOF;
+        memcpy(buf, c->map + c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring)
+        return ff_file_uring_read(c->uring, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -124,6 +156,10 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring)
+        return ff_file_uring_write(c->uring, buf, size);
+#endif
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -243,6 +279,39 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_MMAP
+    /* A file being written to can grow past the mapping, and reading pages
+     * truncated after the mapping raises SIGBUS, so only map on request. */
+    if (c->use_mmap && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !fstat(fd, &st) && S_ISREG(st.st_mode) &&
+        st.st_size > 0 && st.st_size <= SIZE_MAX) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+#endif
+            c->map      = map;
+            c->map_size = st.st_size;
+            c->map_pos  = 0;
+        } else {
+            av_log(h, AV_LOG_VERBOSE, "Cannot map %s, reading it: %s\n",
+                   filename, av_err2str(AVERROR(errno)));
+        }
+    }
+#endif
+
+#if HAVE_LINUX_IO_URING_H
+    if (c->use_uring && !c->map && !c->follow &&
+        (flags & AVIO_FLAG_READ_WRITE) != AVIO_FLAG_READ_WRITE &&
+        !fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        int ret = ff_file_uring_init(&c->uring, fd, !!(flags & AVIO_FLAG_WRITE),
+                                     c->uring_depth, c->uring_block_size);
+        if (ret < 0)
+            av_log(h, AV_LOG_VERBOSE, "Cannot use io_uring for %s: %s\n",
+                   filename, av_err2str(ret));
+    }
+#endif
+
     return 0;
 }
 
@@ -252,6 +321,43 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+    if (c->map) {
+        switch (whence) {
+        case AVSEEK_SIZE:
+            return c->map_size;
+        case SEEK_CUR:
+            pos += c->map_pos;
+            break;
+        case SEEK_END:
+            pos += c->map_size;
+            break;
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        c->map_pos = pos;
+        return pos;
+    }
+
+#if HAVE_LINUX_IO_URING_H
+    if (c->uring) {
+        if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+            struct stat st;
+            if ((ret = ff_file_uring_flush(c->uring)) < 0)
+                return ret;
+            if (fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            if (whence == AVSEEK_SIZE)
+                return st.st_size;
+            pos += st.st_size;
+        } else if (whence == SEEK_CUR) {
+            pos += ff_file_uring_tell(c->uring);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return ff_file_uring_seek(c->uring, pos);
+    }
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -266,7 +372,17 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    return close(c->fd);
+    int ret = 0;
+#if HAVE_MMAP
+    if (c->map)
+        munmap(c->map, c->map_size);
+#endif
+#if HAVE_LINUX_IO_URING_H
+    ret = ff_file_uring_close(&c->uring);
+#endif
+    if (close(c->fd) < 0 && !ret)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 static int file_open_dir(URLContext *h)
@@ -0,0 +1,453 @@
+/*
+ * io_uring backend for the file protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "file_uring.h"
+
+typedef struct FileURingSlot {
+    uint8_t *buf;
+    int64_t offset; ///< file offset of buf[0]
+    int len;        ///< bytes read or to write, or a negative errno
+    int pos;        ///< bytes returned by a read or queued by a write
+    int busy;       ///< a request on buf is in flight
+    struct iovec iov;
+} FileURingSlot;
+
+struct FileURing {
+    int ring_fd;
+    int fd;
+    int write;
+    int fixed;      ///< buffers are registered, use the _FIXED opcodes
+
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    atomic_uint *sq_tail, *cq_head, *cq_tail;
+    unsigned sq_mask, cq_mask;
+    unsigned *sq_array;
+    struct io_uring_cqe *cqes;
+
+    uint8_t *bufs;
+    FileURingSlot *slots;
+    int nb_slots;
+    int block_size;
+    int head;            ///< slot being read from or filled
+    int64_t next_offset; ///< offset of the next read to queue
+    int error;           ///< first error of a queued write or read
+};
+
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete)
+{
+    int ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                      min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? AVERROR(errno) : ret;
+}
+
+static int uring_submit(FileURing *r, int i, int len)
+{
+    FileURingSlot *s = &r->slots[i];
+    unsigned tail = atomic_load_explicit(r->sq_tail, memory_order_relaxed);
+    unsigned idx  = tail & r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    int ret;
+
+    memset(sqe, 0, sizeof(*sqe));
+    if (r->fixed) {
+        sqe->opcode    = r->write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->addr      = (uintptr_t)s->buf;
+        sqe->len       = len;
+        sqe->buf_index = i;
+    } else {
+        s->iov.iov_base = s->buf;
+        s->iov.iov_len  = len;
+        sqe->opcode     = r->write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->addr       = (uintptr_t)&s->iov;
+        sqe->len        = 1;
+    }
+    sqe->fd        = r->fd;
+    sqe->off       = s->offset;
+    sqe->user_data = i;
+    r->sq_array[idx] = idx;
+    atomic_store_explicit(r->sq_tail, tail + 1, memory_order_release);
+
+    ret = uring_enter(r->ring_fd, 1, 0);
+    if (ret <= 0) {
+        /* the kernel did not consume the entry */
+        atomic_store_explicit(r->sq_tail, tail, memory_order_release);
+        return ret < 0 ? ret : AVERROR(EIO);
+    }
+    s->len  = len;
+    s->busy = 1;
+    return 0;
+}
+
+static void uring_complete_write(FileURing *r, FileURingSlot *s, int res)
+{
+    int done = res;
+
+    if (res < 0) {
+        if (!r->error)
+            r->error = AVERROR(-res);
+        return;
+    }
+    /* Finish short writes synchronously, they are not expected on
+     * regular files. */
+    while (done < s->len) {
+        ssize_t ret = pwrite(r->fd, s->buf + done, s->len - done, s->offset + done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0) {
+            if (!r->error)
+                r->error = ret < 0 ? AVERROR(errno) : AVERROR(EIO);
+            return;
+        }
+        done += ret;
+    }
+}
+
+/* Wait for at least one request to complete. */
+static int uring_reap(FileURing *r)
+{
+    for (;;) {
+        unsigned head = atomic_load_explicit(r->cq_head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(r->cq_tail, memory_order_acquire);
+        int ret;
+
+        if (head != tail) {
+            struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+            FileURingSlot *s = &r->slots[cqe->user_data];
+            int res = cqe->res;
+
+            atomic_store_explicit(r->cq_head, head + 1, memory_order_release);
+            s->busy = 0;
+            if (r->write)
+                uring_complete_write(r, s, res);
+            else
+                s->len = res;
+            return 0;
+        }
+
+        ret = uring_enter(r->ring_fd, 0, 1);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static int uring_wait(FileURing *r, int i)
+{
+    while (r->slots[i].busy) {
+        int ret = uring_reap(r);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+static int uring_drain(FileURing *r)
+{
+    int i, ret;
+
+    for (i = 0; i < r->nb_slots; i++)
+        if ((ret = uring_wait(r, i)) < 0)
+            return ret;
+    return 0;
+}
+
+/* Drop the data read ahead and queue reads of all the slots from offset. */
+static int uring_restart_read(FileURing *r, int64_t offset)
+{
+    int i, ret;
+
+    if ((ret = uring_drain(r)) < 0)
+        return r->error = ret;
+    r->head        = 0;
+    r->next_offset = offset;
+    r->error       = 0;
+    for (i = 0; i < r->nb_slots; i++) {
+        FileURingSlot *s = &r->slots[i];
+        s->offset = r->next_offset;
+        s->pos    = 0;
+        r->next_offset += r->block_size;
+        if ((ret = uring_submit(r, i, r->block_size)) < 0)
+            return r->error = ret;
+    }
+    return 0;
+}
+
+int ff_file_uring_read(FileURing *r, uint8_t *buf, int size)
+{
+    FileURingSlot *s = &r->slots[r->head];
+    int ret;
+
+    if (r->error)
+        return r->error;
+    if ((ret = uring_wait(r, r->head)) < 0)
+        return ret;
+    if (s->len < 0) {
+        ret = AVERROR(-s->len);
+        uring_restart_read(r, s->offset + s->pos);
+        return ret;
+    }
+    if (!s->len)
+        return AVERROR_EOF;
+
+    size = FFMIN(size, s->len - s->pos);
+    memcpy(buf, s->buf + s->pos, size);
+    s->pos += size;
+
+    if (s->pos == s->len) {
+        if (s->len < r->block_size) {
+            /* Short read, most likely at the end of the file: the reads
+             * queued after it do not follow the data returned. */
+            uring_restart_read(r, s->offset + s->len);
+        } else {
+            s->offset = r->next_offset;
+            s->pos    = 0;
+            r->next_offset += r->block_size;
+            if ((ret = uring_submit(r, r->head, r->block_size)) < 0)
+                r->error = ret;
+            r->head = (r->head + 1) % r->nb_slots;
+        }
+    }
+    return size;
+}
+
+/* Queue the write of the slot being filled and make the next one current. */
+static int uring_queue_write(FileURing *r)
+{
+    FileURingSlot *s = &r->slots[r->head];
+    int64_t offset = s->offset + s->pos;
+    int ret;
+
+    if (!s->pos)
+        return 0;
+    if ((ret = uring_submit(r, r->head, s->pos)) < 0)
+        return ret;
+    r->head = (r->head + 1) % r->nb_slots;
+    s = &r->slots[r->head];
+    if ((ret = uring_wait(r, r->head)) < 0)
+        return ret;
+    s->offset = offset;
+    s->pos    = 0;
+    return r->error;
+}
+
+int ff_file_uring_write(FileURing *r, const uint8_t *buf, int size)
+{
+    FileURingSlot *s = &r->slots[r->head];
+    int ret;
+
+    if (r->error)
+        return r->error;
+
+    size = FFMIN(size, r->block_size - s->pos);
+    memcpy(s->buf + s->pos, buf, size);
+    s->pos += size;
+    if (s->pos == r->block_size && (ret = uring_queue_write(r)) < 0)
+        return ret;
+    return size;
+}
+
+int ff_file_uring_flush(FileURing *r)
+{
+    int ret;
+
+    if (!r->write)
+        return 0;
+    if ((ret = uring_queue_write(r)) < 0)
+        return ret;
+    if ((ret = uring_drain(r)) < 0)
+        return ret;
+    return r->error;
+}
+
+int64_t ff_file_uring_tell(FileURing *r)
+{
+    FileURingSlot *s = &r->slots[r->head];
+    return s->offset + s->pos;
+}
+
+int64_t ff_file_uring_seek(FileURing *r, int64_t pos)
+{
+    FileURingSlot *s = &r->slots[r->head];
+    int ret;
+
+    if (r->write) {
+        /* Writes to overlapping ranges may complete in any order, so wait
+         * for the queued ones before writing elsewhere. */
+        if ((ret = ff_file_uring_flush(r)) < 0)
+            return ret;
+        s = &r->slots[r->head];
+        s->offset = pos;
+        s->pos    = 0;
+        return pos;
+    }
+
+    if (pos == ff_file_uring_tell(r))
+        return pos;
+    if (!s->busy && s->len > 0 && pos >= s->offset && pos < s->offset + s->len) {
+        s->pos = pos - s->offset;
+        return pos;
+    }
+    if ((ret = uring_restart_read(r, pos)) < 0)
+        return ret;
+    return pos;
+}
+
+static void uring_free(FileURing *r)
+{
+    if (r->ring_fd >= 0) {
+        if (r->slots)
+            uring_drain(r);
+        close(r->ring_fd);
+    }
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring && r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+    if (r->sq_ring)
+        munmap(r->sq_ring, r->sq_ring_size);
+    av_freep(&r->slots);
+    av_freep(&r->bufs);
+    av_free(r);
+}
+
+int ff_file_uring_close(FileURing **pr)
+{
+    FileURing *r = *pr;
+    int ret;
+
+    if (!r)
+        return 0;
+    ret = ff_file_uring_flush(r);
+    uring_free(r);
+    *pr = NULL;
+    return ret;
+}
+
+int ff_file_uring_init(FileURing **pr, int fd, int write, int depth, int block_size)
+{
+    struct io_uring_params p = { 0 };
+    struct iovec *iov;
+    FileURing *r;
+    void *map;
+    int i, ret;
+
+    r = av_mallocz(sizeof(*r));
+    if (!r)
+        return AVERROR(ENOMEM);
+    r->fd         = fd;
+    r->write      = write;
+    r->nb_slots   = depth;
+    r->block_size = block_size;
+
+    r->ring_fd = syscall(__NR_io_uring_setup, depth, &p);
+    if (r->ring_fd < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        r->sq_ring_size = r->cq_ring_size = FFMAX(r->sq_ring_size, r->cq_ring_size);
+#endif
+    map = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_SQ_RING);
+    if (map == MAP_FAILED)
+        goto fail_errno;
+    r->sq_ring = map;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else
+#endif
+    {
+        map = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_CQ_RING);
+        if (map == MAP_FAILED)
+            goto fail_errno;
+        r->cq_ring = map;
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    map = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, r->ring_fd, IORING_OFF_SQES);
+    if (map == MAP_FAILED)
+        goto fail_errno;
+    r->sqes = map;
+
+    r->sq_tail  = (atomic_uint *)((uint8_t *)r->sq_ring + p.sq_off.tail);
+    r->sq_mask  = *(unsigned *)((uint8_t *)r->sq_ring + p.sq_off.ring_mask);
+    r->sq_array =  (unsigned *)((uint8_t *)r->sq_ring + p.sq_off.array);
+    r->cq_head  = (atomic_uint *)((uint8_t *)r->cq_ring + p.cq_off.head);
+    r->cq_tail  = (atomic_uint *)((uint8_t *)r->cq_ring + p.cq_off.tail);
+    r->cq_mask  = *(unsigned *)((uint8_t *)r->cq_ring + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)((uint8_t *)r->cq_ring + p.cq_off.cqes);
+
+    r->bufs  = av_malloc_array(depth, block_size);
+    r->slots = av_calloc(depth, sizeof(*r->slots));
+    iov      = av_calloc(depth, sizeof(*iov));
+    if (!r->bufs || !r->slots || !iov) {
+        av_free(iov);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (i = 0; i < depth; i++) {
+        r->slots[i].buf = r->bufs + (size_t)i * block_size;
+        iov[i].iov_base = r->slots[i].buf;
+        iov[i].iov_len  = block_size;
+    }
+    /* Registering pins the buffers, which can exceed RLIMIT_MEMLOCK; the
+     * vectored opcodes work on unregistered buffers. */
+    r->fixed = !syscall(__NR_io_uring_register, r->ring_fd,
+                        IORING_REGISTER_BUFFERS, iov, depth);
+    av_free(iov);
+
+    if (!write && (ret = uring_restart_read(r, 0)) < 0)
+        goto fail;
+
+    *pr = r;
+    return 0;
+
+fail_errno:
+    ret = AVERROR(errno);
+fail:
+    uring_free(r);
+    return ret;
+}
@@ -0,0 +1,68 @@
+/*
+ * io_uring backend for the file protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_FILE_URING_H
+#define AVFORMAT_FILE_URING_H
+
+#include <stdint.h>
+
+/**
+ * Reads ahead or writes behind a file descriptor with io_uring, keeping up
+ * to depth requests of block_size bytes in flight. Reads return the data
+ * in file order, writes are queued and their errors reported by a later
+ * call.
+ */
+typedef struct FileURing FileURing;
+
+/**
+ * Set up the ring for fd, reading from or writing to offset 0.
+ *
+ * @return 0 on success, a negative error code if io_uring is unavailable
+ */
+int ff_file_uring_init(FileURing **r, int fd, int write, int depth, int block_size);
+
+int ff_file_uring_read(FileURing *r, uint8_t *buf, int size);
+
+int ff_file_uring_write(FileURing *r, const uint8_t *buf, int size);
+
+/**
+ * @return the current position, as seen by the caller
+ */
+int64_t ff_file_uring_tell(FileURing *r);
+
+/**
+ * Move to the absolute position pos.
+ *
+ * @return pos, or a negative error code
+ */
+int64_t ff_file_uring_seek(FileURing *r, int64_t pos);
+
+/**
+ * Wait for all the queued writes to complete.
+ */
+int ff_file_uring_flush(FileURing *r);
+
+/**
+ * Flush the queued writes and free the ring, the file descriptor is left
+ * open.
+ */
+int ff_file_uring_close(FileURing **r);
+
+#endif /* AVFORMAT_FILE_URING_H */
@@ -33,6 +33,7 @@
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
 #include "libavutil/dict.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 #include "avformat.h"
 #include "internal.h"
@@ -42,6 +43,7 @@
 #define INITIAL_BUFFER_SIZE 32768
 
 #define MAX_FIELD_LEN 64
+#define MAX_PREFETCH_THREADS 4
 #define MAX_CHARACTERISTICS_LEN 512
 
 #define MPEG_TIME_BASE 90000
@@ -77,6 +79,28 @@ struct segment {
     struct segment *init_section;
 };
 
+/*
+ * Segment downloaded ahead by the prefetch thread of a playlist. The url and
+ * range are copied from the segment at scheduling time, since the segment
+ * list may change on playlist reloads. The other fields are only accessed
+ * with the prefetch lock of the playlist held.
+ */
+struct prefetch_job {
+    int64_t seq_no;
+    char *url;
+    int64_t url_offset;
+    int64_t size;
+
+    uint8_t *data;
+    unsigned int data_size;
+    unsigned int data_alloc;
+    unsigned int read_pos;      /* position of the demuxer in data */
+    int started;
+    int done;
+    int error;
+    int cancel;                 /* dropped from the queue while downloading */
+};
+
 struct rendition;
 
 enum PlaylistType {
@@ -160,6 +184,22 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Segments downloaded ahead by the prefetch threads, in order. The first
+     * one is read instead of input when prefetch_cur is set. */
+    struct prefetch_job **prefetch_jobs;
+    int n_prefetch_jobs;
+    struct prefetch_job *prefetch_cur;
+    int64_t prefetch_bytes;
+    AVDictionary *prefetch_opts;
+#if HAVE_THREADS
+    pthread_t prefetch_threads[MAX_PREFETCH_THREADS];
+    int n_prefetch_threads;
+    pthread_mutex_t prefetch_lock;
+    pthread_cond_t prefetch_cond;
+    int prefetch_started;
+    int prefetch_abort;
+#endif
 };
 
 /*
@@ -212,6 +252,8 @@ typedef struct HLSContext {
     int http_persistent;
     int http_multiple;
     int http_seekable;
+    int prefetch_segments;
+    int64_t prefetch_size;
     AVIOContext *playlist_pb;
 } HLSContext;
 
@@ -243,11 +285,77 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+#if HAVE_THREADS
+static void free_prefetch_job(struct playlist *pls, struct prefetch_job *job)
+{
+    pls->prefetch_bytes -= job->data_size;
+    av_freep(&job->url);
+    av_freep(&job->data);
+    av_free(job);
+}
+
+/* Drop the queued segments, the lock must be held. */
+static void prefetch_flush_locked(struct playlist *pls)
+{
+    int i;
+
+    for (i = 0; i < pls->n_prefetch_jobs; i++) {
+        struct prefetch_job *job = pls->prefetch_jobs[i];
+        /* the prefetch thread downloading a segment frees it */
+        if (job->started && !job->done)
+            job->cancel = 1;
+        else
+            free_prefetch_job(pls, job);
+    }
+    pls->n_prefetch_jobs = 0;
+    pls->prefetch_cur = NULL;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+}
+
+static void prefetch_flush(struct playlist *pls)
+{
+    if (!pls->prefetch_started)
+        return;
+    pthread_mutex_lock(&pls->prefetch_lock);
+    prefetch_flush_locked(pls);
+    pthread_mutex_unlock(&pls->prefetch_lock);
+}
+
+static void prefetch_stop(struct playlist *pls)
+{
+    int i;
+
+    if (pls->prefetch_started) {
+        pthread_mutex_lock(&pls->prefetch_lock);
+        pls->prefetch_abort = 1;
+        prefetch_flush_locked(pls);
+        pthread_mutex_unlock(&pls->prefetch_lock);
+        for (i = 0; i < pls->n_prefetch_threads; i++)
+            pthread_join(pls->prefetch_threads[i], NULL);
+        pls->n_prefetch_threads = 0;
+        pthread_cond_destroy(&pls->prefetch_cond);
+        pthread_mutex_destroy(&pls->prefetch_lock);
+        pls->prefetch_started = 0;
+    }
+    av_freep(&pls->prefetch_jobs);
+    av_dict_free(&pls->prefetch_opts);
+}
+#else
+static void prefetch_flush(struct playlist *pls)
+{
+}
+
+static void prefetch_stop(struct playlist *pls)
+{
+}
+#endif
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
+        prefetch_stop(pls);
         free_segment_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
@@ -621,8 +729,22 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
+/*
+ * Open url through the io_open callback of s, or directly with int_cb as
+ * interrupt callback if set. The latter requires the default io_open.
+ */
+static int io_open_read(AVFormatContext *s, AVIOContext **pb, const char *url,
+                        AVDictionary **opts, const AVIOInterruptCB *int_cb)
+{
+    if (int_cb)
+        return ffio_open_whitelist(pb, url, AVIO_FLAG_READ, int_cb, opts,
+                                   s->protocol_whitelist, s->protocol_blacklist);
+    return s->io_open(s, pb, url, AVIO_FLAG_READ, opts);
+}
+
 static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
+                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out,
+                    const AVIOInterruptCB *int_cb)
 {
     HLSContext *c = s->priv_data;
     AVDictionary *tmp = NULL;
@@ -684,10 +806,10 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
                     url, av_err2str(ret));
             av_dict_copy(&tmp, *opts, 0);
             av_dict_copy(&tmp, opts2, 0);
-            ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+            ret = io_open_read(s, pb, url, &tmp, int_cb);
         }
     } else {
-        ret = s->io_open(s, pb, url, AVIO_FLAG_READ, &tmp);
+        ret = io_open_read(s, pb, url, &tmp, int_cb);
     }
     if (ret >= 0) {
         // update cookies on http response with setcookies.
@@ -1012,11 +1134,287 @@ static struct segment *next_segment(struct playlist *pls)
     return pls->segments[n];
 }
 
+#if HAVE_THREADS
+/* State of a prefetch thread, used by the interrupt callback of its I/O. */
+struct prefetch_worker {
+    struct playlist *pls;
+    struct prefetch_job *job;   /* segment being downloaded, if any */
+};
+
+/*
+ * Abort the blocking I/O of a prefetch thread when the playlist is closed or
+ * the segment is dropped from the queue, or when the caller interrupts.
+ */
+static int prefetch_interrupt_cb(void *opaque)
+{
+    struct prefetch_worker *w = opaque;
+    struct playlist *pls = w->pls;
+    HLSContext *c = pls->parent->priv_data;
+    int abort;
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    abort = pls->prefetch_abort || (w->job && w->job->cancel);
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    return abort || ff_check_interrupt(c->interrupt_callback);
+}
+
+/**
+ * Download a segment into job->data on the prefetch thread. The connection
+ * in *pb is kept open across segments for persistent HTTP connections.
+ */
+static int prefetch_download(struct playlist *pls, struct prefetch_job *job,
+                             AVIOContext **pb, AVDictionary **avio_opts,
+                             const AVIOInterruptCB *int_cb,
+                             uint8_t *buf, int buf_size)
+{
+    HLSContext *c = pls->parent->priv_data;
+    AVDictionary *opts = NULL;
+    int64_t left = job->size;
+    int ret, is_http = 0;
+
+    if (c->http_persistent)
+        av_dict_set(&opts, "multiple_requests", "1", 0);
+    if (job->size >= 0) {
+        av_dict_set_int(&opts, "offset", job->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", job->url_offset + job->size, 0);
+    }
+
+    av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch of url '%s', offset %"PRId64", playlist %d\n",
+           job->url, job->url_offset, pls->index);
+
+    ret = open_url(pls->parent, pb, job->url, avio_opts, opts, &is_http, int_cb);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    /* see open_input() */
+    if (!is_http && job->url_offset) {
+        int64_t seekret = avio_seek(*pb, job->url_offset, SEEK_SET);
+        if (seekret < 0) {
+            ff_format_io_close(pls->parent, pb);
+            return seekret;
+        }
+    }
+
+    while (left) {
+        int len = avio_read(*pb, buf, left > 0 ? FFMIN(left, buf_size) : buf_size);
+        uint8_t *data;
+
+        if (len <= 0) {
+            ret = len == AVERROR_EOF ? 0 : len;
+            break;
+        }
+        if (left > 0)
+            left -= len;
+
+        pthread_mutex_lock(&pls->prefetch_lock);
+        /* the segment read by the demuxer is never held by the byte budget */
+        while (!job->cancel && pls->prefetch_jobs[0] != job &&
+               pls->prefetch_bytes >= c->prefetch_size)
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+        if (job->cancel) {
+            ret = AVERROR_EXIT;
+        } else if (!(data = av_fast_realloc(job->data, &job->data_alloc,
+                                            job->data_size + len))) {
+            ret = AVERROR(ENOMEM);
+        } else {
+            job->data = data;
+            memcpy(job->data + job->data_size, buf, len);
+            job->data_size      += len;
+            pls->prefetch_bytes += len;
+            pthread_cond_broadcast(&pls->prefetch_cond);
+        }
+        pthread_mutex_unlock(&pls->prefetch_lock);
+        if (ret < 0)
+            break;
+    }
+
+    if (!is_http || !c->http_persistent || ret < 0)
+        ff_format_io_close(pls->parent, pb);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    struct playlist *pls = arg;
+    struct prefetch_worker w = { pls };
+    AVIOInterruptCB int_cb = { prefetch_interrupt_cb, &w };
+    AVIOContext *pb = NULL;
+    AVDictionary *avio_opts = NULL;
+    uint8_t *buf = av_malloc(INITIAL_BUFFER_SIZE);
+    int i;
+
+    /* open_url() updates the options, e.g. with new cookies */
+    av_dict_copy(&avio_opts, pls->prefetch_opts, 0);
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    while (!pls->prefetch_abort) {
+        struct prefetch_job *job = NULL;
+        int ret;
+
+        for (i = 0; i < pls->n_prefetch_jobs && !job; i++)
+            if (!pls->prefetch_jobs[i]->started)
+                job = pls->prefetch_jobs[i];
+        if (!job) {
+            pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+            continue;
+        }
+        job->started = 1;
+        w.job = job;
+        pthread_mutex_unlock(&pls->prefetch_lock);
+
+        ret = buf ? prefetch_download(pls, job, &pb, &avio_opts, &int_cb,
+                                      buf, INITIAL_BUFFER_SIZE) :
+                    AVERROR(ENOMEM);
+
+        pthread_mutex_lock(&pls->prefetch_lock);
+        w.job      = NULL;
+        job->done  = 1;
+        job->error = ret;
+        if (job->cancel)
+            free_prefetch_job(pls, job);
+        pthread_cond_broadcast(&pls->prefetch_cond);
+    }
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    ff_format_io_close(pls->parent, &pb);
+    av_dict_free(&avio_opts);
+    av_free(buf);
+    return NULL;
+}
+
+/**
+ * Queue the current segment and up to prefetch_segments following ones for
+ * download, and set prefetch_cur if the current one can be read from there.
+ * Encrypted segments are opened by the demuxer as usual, as are all the
+ * following ones until the next call.
+ */
+static int prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    int64_t seq_no;
+    int ret = 0;
+
+    if (!pls->prefetch_started) {
+        /* one connection per segment downloaded concurrently */
+        int nb_threads = FFMIN(c->prefetch_segments + 1, MAX_PREFETCH_THREADS);
+
+        if ((ret = pthread_mutex_init(&pls->prefetch_lock, NULL)))
+            return AVERROR(ret);
+        if ((ret = pthread_cond_init(&pls->prefetch_cond, NULL))) {
+            pthread_mutex_destroy(&pls->prefetch_lock);
+            return AVERROR(ret);
+        }
+        pls->prefetch_started = 1;
+        av_dict_copy(&pls->prefetch_opts, c->avio_opts, 0);
+
+        while (pls->n_prefetch_threads < nb_threads) {
+            ret = pthread_create(&pls->prefetch_threads[pls->n_prefetch_threads],
+                                 NULL, prefetch_thread, pls);
+            if (ret)
+                break;
+            pls->n_prefetch_threads++;
+        }
+        if (!pls->n_prefetch_threads) {
+            prefetch_stop(pls);
+            return AVERROR(ret);
+        }
+        ret = 0;
+    }
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    /* after a seek or skipped segments */
+    if (pls->n_prefetch_jobs && pls->prefetch_jobs[0]->seq_no != pls->cur_seq_no)
+        prefetch_flush_locked(pls);
+
+    seq_no = pls->n_prefetch_jobs ?
+             pls->prefetch_jobs[pls->n_prefetch_jobs - 1]->seq_no + 1 : pls->cur_seq_no;
+    for (; pls->n_prefetch_jobs <= c->prefetch_segments &&
+           seq_no < pls->start_seq_no + pls->n_segments; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct prefetch_job *job;
+
+        if (seg->key_type != KEY_NONE)
+            break;
+        if (!(job = av_mallocz(sizeof(*job))) || !(job->url = av_strdup(seg->url))) {
+            av_freep(&job);
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        job->seq_no     = seq_no;
+        job->url_offset = seg->url_offset;
+        job->size       = seg->size;
+        if ((ret = av_dynarray_add_nofree(&pls->prefetch_jobs, &pls->n_prefetch_jobs, job)) < 0) {
+            free_prefetch_job(pls, job);
+            break;
+        }
+    }
+
+    if (pls->n_prefetch_jobs && pls->prefetch_jobs[0]->seq_no == pls->cur_seq_no)
+        pls->prefetch_cur = pls->prefetch_jobs[0];
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    return ret;
+}
+
+static int read_from_prefetch(struct playlist *pls, uint8_t *buf, int buf_size)
+{
+    struct prefetch_job *job = pls->prefetch_cur;
+    int ret;
+
+    pthread_mutex_lock(&pls->prefetch_lock);
+    while (job->read_pos == job->data_size && !job->done)
+        pthread_cond_wait(&pls->prefetch_cond, &pls->prefetch_lock);
+    if (job->read_pos < job->data_size) {
+        ret = FFMIN(buf_size, job->data_size - job->read_pos);
+        memcpy(buf, job->data + job->read_pos, ret);
+        job->read_pos += ret;
+    } else {
+        ret = job->error < 0 ? job->error : AVERROR_EOF;
+        if (job->error < 0 && !job->data_size)
+            av_log(pls->parent, AV_LOG_WARNING, "Failed to open segment %"PRId64" of playlist %d\n",
+                   job->seq_no, pls->index);
+    }
+    pthread_mutex_unlock(&pls->prefetch_lock);
+
+    return ret;
+}
+
+/* Free the segment read by the demuxer. */
+static void prefetch_release(struct playlist *pls)
+{
+    pthread_mutex_lock(&pls->prefetch_lock);
+    free_prefetch_job(pls, pls->prefetch_jobs[0]);
+    memmove(pls->prefetch_jobs, pls->prefetch_jobs + 1,
+            --pls->n_prefetch_jobs * sizeof(*pls->prefetch_jobs));
+    pls->prefetch_cur = NULL;
+    pthread_cond_broadcast(&pls->prefetch_cond);
+    pthread_mutex_unlock(&pls->prefetch_lock);
+}
+#else
+static int prefetch_schedule(HLSContext *c, struct playlist *pls)
+{
+    return 0;
+}
+
+static int read_from_prefetch(struct playlist *pls, uint8_t *buf, int buf_size)
+{
+    return AVERROR_BUG;
+}
+
+static void prefetch_release(struct playlist *pls)
+{
+}
+#endif
+
 static int read_from_url(struct playlist *pls, struct segment *seg,
                          uint8_t *buf, int buf_size)
 {
     int ret;
 
+    if (pls->prefetch_cur)
+        return read_from_prefetch(pls, buf, buf_size);
+
      /* limit read if the segment was only a part of a file */
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
@@ -1246,12 +1644,12 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
            seg->url, seg->url_offset, pls->index);
 
     if (seg->key_type == KEY_NONE) {
-        ret = open_url(pls->parent, in, seg->url, &c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, seg->url, &c->avio_opts, opts, &is_http, NULL);
     } else if (seg->key_type == KEY_AES_128) {
         char iv[33], key[33], url[MAX_URL_SIZE];
         if (strcmp(seg->key, pls->key_url)) {
             AVIOContext *pb = NULL;
-            if (open_url(pls->parent, &pb, seg->key, &c->avio_opts, opts, NULL) == 0) {
+            if (open_url(pls->parent, &pb, seg->key, &c->avio_opts, opts, NULL, NULL) == 0) {
                 ret = avio_read(pb, pls->key, sizeof(pls->key));
                 if (ret != sizeof(pls->key)) {
                     av_log(pls->parent, AV_LOG_ERROR, "Unable to read key file %s\n",
@@ -1275,7 +1673,7 @@ static int open_input(HLSContext *c, struct playlist *pls, struct segment *seg,
         av_dict_set(&opts, "key", key, 0);
         av_dict_set(&opts, "iv", iv, 0);
 
-        ret = open_url(pls->parent, in, url, &c->avio_opts, opts, &is_http);
+        ret = open_url(pls->parent, in, url, &c->avio_opts, opts, &is_http, NULL);
         if (ret < 0) {
             goto cleanup;
         }
@@ -1436,7 +1834,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->prefetch_cur) || (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1507,7 +1905,12 @@ reload:
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->prefetch_segments > 0 && (ret = prefetch_schedule(c, v)) < 0)
+            return ret;
+
+        if (v->prefetch_cur) {
+            ret = 0;
+        } else if (c->http_multiple == 1 && v->input_next_requested) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
@@ -1527,7 +1930,7 @@ reload:
         just_opened = 1;
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && !v->prefetch_cur) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1537,7 +1940,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !v->input_next_requested && !v->prefetch_cur &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1570,7 +1973,9 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->prefetch_cur) {
+        prefetch_release(v);
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -1871,6 +2276,13 @@ static int hls_read_header(AVFormatContext *s)
     if ((ret = save_avio_options(s)) < 0)
         goto fail;
 
+    /* the prefetch threads open the segments concurrently on their own */
+    if (c->prefetch_segments > 0 && !ff_format_io_is_default(s)) {
+        av_log(s, AV_LOG_WARNING,
+               "Prefetching requires the default io_open and io_close callbacks, disabling it\n");
+        c->prefetch_segments = 0;
+    }
+
     /* XXX: Some HLS servers don't like being sent the range header,
        in this case, need to  setting http_seekable = 0 to disable
        the range header */
@@ -2094,6 +2506,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             }
             av_log(s, AV_LOG_INFO, "Now receiving playlist %d, segment %"PRId64"\n", i, pls->cur_seq_no);
         } else if (first && !cur_needed && pls->needed) {
+            prefetch_flush(pls);
             ff_format_io_close(pls->parent, &pls->input);
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
@@ -2334,6 +2747,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
     for (i = 0; i < c->n_playlists; i++) {
         /* Reset reading */
         struct playlist *pls = c->playlists[i];
+        prefetch_flush(pls);
         ff_format_io_close(pls->parent, &pls->input);
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
@@ -2399,6 +2813,10 @@ static const AVOption hls_options[] = {
         OFFSET(http_multiple), AV_OPT_TYPE_BOOL, {.i64 = -1}, -1, 1, FLAGS},
     {"http_seekable", "Use HTTP partial requests, 0 = disable, 1 = enable, -1 = auto",
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead in the background",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"prefetch_size", "Maximum number of bytes downloaded ahead per playlist",
+        OFFSET(prefetch_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -91,6 +91,14 @@ typedef struct HLSSegment {
     double discont_program_date_time;
 } HLSSegment;
 
+typedef struct HLSPart {
+    int64_t sequence; /* media sequence number of the parent segment */
+    double duration;  /* in seconds */
+    int64_t pos;
+    int64_t size;
+    int independent;
+} HLSPart;
+
 typedef enum HLSFlags {
     // Generate a single media file and use byte ranges in the playlist.
     HLS_SINGLE_FILE = (1 << 0),
@@ -149,6 +157,14 @@ typedef struct VariantStream {
     int discontinuity;
     int reference_stream_index;
 
+    AVIOContext *out_part; /* segment file written part by part */
+    int part_file_open;
+    HLSPart *parts;        /* parts of the current and last few segments */
+    int nb_parts;
+    int64_t part_start_pts;
+    int part_independent;
+    double parts_duration; /* duration of the parts of the current segment */
+
     HLSSegment *segments;
     HLSSegment *last_segment;
     HLSSegment *old_segments;
@@ -198,6 +214,7 @@ typedef struct HLSContext {
 
     int64_t time;          // Set by a private option.
     int64_t init_time;     // Set by a private option.
+    int64_t part_time;     // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
 #if FF_API_HLS_WRAP
@@ -560,6 +577,110 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
+static int write_init_segment(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return 0;
+}
+
+/* Write the fragment buffered so far as the next part of the segment file,
+ * which is opened on the first part and stays open until the segment ends. */
+static int flush_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    HLSPart *part;
+    int64_t pos = 0;
+    int ret, range_length;
+
+    if (!vs->init_range_length) {
+        av_write_frame(oc, NULL); /* write the moov */
+        if ((ret = write_init_segment(s, vs)) < 0)
+            return ret;
+    }
+    if (!vs->part_file_open) {
+        AVDictionary *options = NULL;
+
+        set_http_options(s, &options, hls);
+        ret = hlsenc_io_open(s, &vs->out_part, oc->url, &options);
+        av_dict_free(&options);
+        if (ret < 0) {
+            av_log(s, AV_LOG_ERROR, "Failed to open file '%s'\n", oc->url);
+            return ret;
+        }
+        vs->part_file_open = 1;
+        write_styp(vs->out_part);
+    } else if (vs->nb_parts) {
+        part = &vs->parts[vs->nb_parts - 1];
+        pos  = part->pos + part->size;
+    }
+
+    av_write_frame(oc, NULL);
+    range_length = avio_close_dyn_buf(oc->pb, &vs->temp_buffer);
+    oc->pb = NULL;
+    avio_write(vs->out_part, vs->temp_buffer, range_length);
+    avio_flush(vs->out_part);
+    av_freep(&vs->temp_buffer);
+    if ((ret = avio_open_dyn_buf(&oc->pb)) < 0)
+        return ret;
+
+    ret = av_reallocp_array(&vs->parts, vs->nb_parts + 1, sizeof(*vs->parts));
+    if (ret < 0) {
+        vs->nb_parts = 0;
+        return ret;
+    }
+    part = &vs->parts[vs->nb_parts++];
+    part->sequence    = vs->sequence;
+    part->duration    = duration;
+    part->pos         = pos;
+    part->size        = avio_tell(vs->out_part) - pos;
+    part->independent = vs->part_independent;
+    vs->parts_duration += duration;
+
+    return 0;
+}
+
+static int close_part_file(AVFormatContext *s, VariantStream *vs)
+{
+    int ret;
+
+    if (!vs->part_file_open)
+        return 0;
+    vs->size = avio_tell(vs->out_part);
+    ret = hlsenc_io_close(s, &vs->out_part, vs->avf->url);
+    vs->part_file_open = 0;
+    vs->parts_duration = 0;
+    return ret;
+}
+
+/* Only the parts of the last three segments are listed in the playlist. */
+static void trim_parts(VariantStream *vs)
+{
+    int i;
+
+    for (i = 0; i < vs->nb_parts && vs->parts[i].sequence < vs->sequence - 3; i++)
+        ;
+    memmove(vs->parts, vs->parts + i, (vs->nb_parts - i) * sizeof(*vs->parts));
+    vs->nb_parts -= i;
+}
+
 #if HAVE_DOS_PATHS
 #define SEPARATOR '\\'
 #else
@@ -938,6 +1059,10 @@ static int hls_mux_init(AVFormatContext *s, VariantStream *vs)
     if (hls->segment_type == SEGMENT_TYPE_FMP4) {
         av_dict_set(&options, "fflags", "-autobsf", 0);
         av_dict_set(&options, "movflags", "+frag_custom+dash+delay_moov", AV_DICT_APPEND);
+        /* HLS does not use sidx, and with one per part mp4 would rewrite the
+         * pts of the first sample of parts that do not start a GOP */
+        if (hls->part_time > 0)
+            av_dict_set(&options, "movflags", "+skip_sidx", AV_DICT_APPEND);
     } else {
         /* We only require one PAT/PMT per segment. */
         char period[21];
@@ -1557,6 +1682,8 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int64_t en_sequence = vs->sequence - vs->nb_entries;
+    int part_idx = 0;
 
     hls->version = 3;
     if (byterange_mode) {
@@ -1595,6 +1722,8 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
                                  target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
+    if (hls->part_time > 0)
+        ff_hls_write_part_info(vs->out, hls->part_time / (double)AV_TIME_BASE);
 
     if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
@@ -1619,6 +1748,14 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
+        for (; part_idx < vs->nb_parts && vs->parts[part_idx].sequence <= en_sequence; part_idx++) {
+            HLSPart *part = &vs->parts[part_idx];
+            if (part->sequence == en_sequence)
+                ff_hls_write_part(vs->out, part->duration, hls->baseurl, en->filename,
+                                  part->size, part->pos, part->independent);
+        }
+        en_sequence++;
+
         ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
@@ -1632,6 +1769,22 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (hls->part_time > 0 && !last) {
+        /* the parts of the segment being written, and the next one */
+        const char *filename = hls->use_localtime_mkdir ? vs->avf->url : av_basename(vs->avf->url);
+        int64_t next_pos = 0;
+
+        for (; part_idx < vs->nb_parts; part_idx++) {
+            HLSPart *part = &vs->parts[part_idx];
+            if (part->sequence != vs->sequence)
+                continue;
+            ff_hls_write_part(vs->out, part->duration, hls->baseurl, filename,
+                              part->size, part->pos, part->independent);
+            next_pos = part->pos + part->size;
+        }
+        ff_hls_write_preload_hint(vs->out, hls->baseurl, filename, next_pos);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -2512,19 +2665,9 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                ret = write_init_segment(s, vs);
+                if (ret < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2533,7 +2676,14 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             }
         }
 
-        if (hls->flags & HLS_SINGLE_FILE) {
+        if (hls->part_time > 0) {
+            ret = flush_part(s, vs, (double)(pkt->pts - vs->part_start_pts) * st->time_base.num / st->time_base.den);
+            if (ret >= 0)
+                ret = close_part_file(s, vs);
+            if (ret < 0)
+                return ret;
+            vs->part_start_pts = AV_NOPTS_VALUE;
+        } else if (hls->flags & HLS_SINGLE_FILE) {
             ret = flush_dynbuf(vs, &range_length);
             av_freep(&vs->temp_buffer);
             if (ret < 0) {
@@ -2622,7 +2772,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
+        // with parts, the playlist is written once the next segment has a name, for the preload hint
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !hls->part_time) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
                 ff_format_io_close(s, &vs->out);
@@ -2668,6 +2819,27 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             return ret;
         }
 
+        if (hls->part_time > 0) {
+            trim_parts(vs);
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+    } else if (hls->part_time > 0 && is_ref_pkt && vs->part_start_pts != AV_NOPTS_VALUE &&
+               pkt->pts > vs->part_start_pts &&
+               av_compare_ts(pkt->pts + pkt->duration - vs->part_start_pts, st->time_base,
+                             hls->part_time, AV_TIME_BASE_Q) > 0) {
+        /* end the part before this packet would make it longer than the target */
+        ret = flush_part(s, vs, (double)(pkt->pts - vs->part_start_pts) * st->time_base.num / st->time_base.den);
+        if (ret < 0)
+            return ret;
+        vs->part_start_pts = AV_NOPTS_VALUE;
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+            return ret;
+    }
+
+    if (hls->part_time > 0 && is_ref_pkt && vs->part_start_pts == AV_NOPTS_VALUE) {
+        vs->part_start_pts   = pkt->pts;
+        vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
     }
 
     vs->packets_written++;
@@ -2707,6 +2879,8 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        ff_format_io_close(s, &vs->out_part);
+        av_freep(&vs->parts);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
@@ -2776,6 +2950,12 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 }
             }
         }
+        if (hls->part_time > 0) {
+            ret = flush_part(s, vs, vs->duration + vs->dpp - vs->parts_duration);
+            if (ret >= 0)
+                ret = close_part_file(s, vs);
+            goto failed;
+        }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2834,6 +3014,8 @@ failed:
 
         /* after av_write_trailer, then duration + 1 duration per packet */
         hls_append_segment(s, hls, vs, vs->duration + vs->dpp, vs->start_pos, vs->size);
+        if (hls->part_time > 0)
+            trim_parts(vs);
 
         sls_flag_file_rename(hls, vs, old_filename);
 
@@ -2954,6 +3136,25 @@ static int hls_init(AVFormatContext *s)
                "enabled together. Disabling 'independent_segments' flag\n");
     }
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time requires fmp4 segments\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->part_time >= hls->time ||
+            (hls->init_time > 0 && hls->part_time >= hls->init_time)) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must be shorter than the segments\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->max_seg_size > 0 ||
+            hls->flags & (HLS_SINGLE_FILE | HLS_TEMP_FILE |
+                          HLS_SECOND_LEVEL_SEGMENT_DURATION | HLS_SECOND_LEVEL_SEGMENT_SIZE)) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time cannot be used with hls_segment_size, "
+                   "single_file, temp_file or second level segment duration and size\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2964,6 +3165,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_pts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
         vs->initial_prog_date_time = initial_program_date_time;
 
@@ -3115,6 +3317,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
+    {"hls_part_time", "set partial segment length for low-latency HLS", OFFSET(part_time), AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_ts_options","set hls mpegts list of options for the container format used for hls", OFFSET(format_options), AV_OPT_TYPE_DICT, {.str = NULL},  0, 0,    E},
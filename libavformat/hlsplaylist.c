@@ -186,6 +186,42 @@ int ff_hls_write_file_entry(AVIOContext *out, int insert_discont,
     return 0;
 }
 
+void ff_hls_write_part_info(AVIOContext *out, double part_target)
+{
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%f\n", 3 * part_target);
+    avio_printf(out, "#EXT-X-PART-INF:PART-TARGET=%f\n", part_target);
+}
+
+void ff_hls_write_part(AVIOContext *out, double duration,
+                       const char *baseurl /* Ignored if NULL */,
+                       const char *filename, int64_t size, int64_t pos,
+                       int independent)
+{
+    if (!out || !filename)
+        return;
+    avio_printf(out, "#EXT-X-PART:DURATION=%f,URI=\"%s%s\"", duration,
+                baseurl ? baseurl : "", filename);
+    avio_printf(out, ",BYTERANGE=\"%"PRId64"@%"PRId64"\"", size, pos);
+    if (independent)
+        avio_printf(out, ",INDEPENDENT=YES");
+    avio_printf(out, "\n");
+}
+
+void ff_hls_write_preload_hint(AVIOContext *out,
+                               const char *baseurl /* Ignored if NULL */,
+                               const char *filename, int64_t pos)
+{
+    if (!out || !filename)
+        return;
+    avio_printf(out, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s%s\"",
+                baseurl ? baseurl : "", filename);
+    if (pos)
+        avio_printf(out, ",BYTERANGE-START=%"PRId64, pos);
+    avio_printf(out, "\n");
+}
+
 void ff_hls_write_end_list(AVIOContext *out)
 {
     if (!out)
@@ -808,6 +808,14 @@ int ff_format_output_open(AVFormatContext *s, const char *url, AVDictionary **op
  */
 void ff_format_io_close(AVFormatContext *s, AVIOContext **pb);
 
+/**
+ * Check whether s opens and closes files with the default io_open and
+ * io_close callbacks, i.e. without any callback set by the caller.
+ *
+ * @return 1 if the default callbacks are used, 0 otherwise
+ */
+int ff_format_io_is_default(const AVFormatContext *s);
+
 /**
  * Utility function to check if the file uses http or https protocol
  *
@@ -155,6 +155,21 @@ typedef struct MOVIndexRange {
     int64_t end;
 } MOVIndexRange;
 
+/**
+ * Position of a sample in the sample tables, used to demux without
+ * building the AVIndex.
+ */
+typedef struct MOVSampleCursor {
+    unsigned int sample;        ///< sample number in the track
+    unsigned int chunk;
+    unsigned int chunk_sample;  ///< number of the sample in its chunk
+    unsigned int stsc_index;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    int64_t pos;
+    int64_t dts;                ///< dts in the media timeline
+} MOVSampleCursor;
+
 typedef struct MOVStreamContext {
     AVIOContext *pb;
     int pb_is_copied;
@@ -193,6 +208,24 @@ typedef struct MOVStreamContext {
     int64_t current_index;
     MOVIndexRange* index_ranges;
     MOVIndexRange* current_index_range;
+
+    /* Samples looked up in the sample tables instead of the AVIndex, see
+     * mov_lazy_index_init(). The samples demuxed are the lazy_count ones
+     * starting at lazy_start, indexed like the AVIndex entries would be. */
+    int lazy_index;
+    unsigned int lazy_start;
+    int lazy_count;
+    int64_t lazy_dts_offset;    ///< offset from the media timeline to the sample dts
+    int lazy_key_off;           ///< 1 if stss sample numbers start at 1
+    int lazy_all_keyframes;     ///< all samples are keyframes when stss is absent
+    int lazy_discard_head;      ///< number of leading samples discarded by the edit list
+    int *lazy_discards;         ///< sorted indexes of the other discarded samples
+    int lazy_nb_discards;
+    int64_t *stsc_first_sample; ///< first sample of each stsc entry
+    int64_t *stts_first_sample; ///< first sample of each stts entry
+    int64_t *stts_first_dts;    ///< media dts of the first sample of each stts entry
+    MOVSampleCursor cursor;     ///< position of current_sample
+    AVIndexEntry lazy_entry;    ///< current_sample, as the AVIndex entry would be
     unsigned int bytes_per_frame;
     unsigned int samples_per_frame;
     int dv_audio_container;
@@ -267,6 +300,7 @@ typedef struct MOVContext {
     int use_absolute_path;
     int ignore_editlist;
     int advanced_editlist;
+    int lazy_index;
     int ignore_chapters;
     int seek_individually;
     int64_t next_root_atom; ///< offset of the next root atom
@@ -277,6 +311,8 @@ typedef struct MOVContext {
     int moov_retry;
     int use_mfra_for;
     int has_looked_for_mfra;
+    int walk_sidx;
+    int sidx_walked;        ///< all the sidx boxes were read by mov_walk_sidx()
     MOVFragmentIndex frag_index;
     int atom_depth;
     unsigned int aax_mode;  ///< 'aax' file has been detected
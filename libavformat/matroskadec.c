@@ -1045,10 +1045,10 @@ static int ebml_read_binary(AVIOContext *pb, int length,
 {
     int ret;
 
-    ret = av_buffer_realloc(&bin->buf, length + AV_INPUT_BUFFER_PADDING_SIZE);
-    if (ret < 0)
-        return ret;
-    memset(bin->buf->data + length, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    av_buffer_unref(&bin->buf);
+    bin->buf = ffio_alloc_packet_buffer(pb, length);
+    if (!bin->buf)
+        return AVERROR(ENOMEM);
 
     bin->data = bin->buf->data;
     bin->size = length;
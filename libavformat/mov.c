@@ -3382,6 +3382,203 @@ static int64_t add_ctts_entry(MOVStts** ctts_data, unsigned int* ctts_count, uns
     return *ctts_count;
 }
 
+/* Return the last index i < count with array[i] <= value, or 0. */
+static unsigned int mov_lazy_search_table(const int64_t *array, unsigned int count,
+                                          int64_t value)
+{
+    unsigned int a = 0, b = count;
+
+    while (b - a > 1) {
+        unsigned int m = (a + b) >> 1;
+        if (array[m] <= value)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static unsigned int mov_lazy_sample_size(const MOVStreamContext *sc, unsigned int sample)
+{
+    return sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[sample];
+}
+
+/* Media dts of a sample, as mov_build_index() computes it. */
+static int64_t mov_lazy_sample_dts(const MOVStreamContext *sc, unsigned int sample)
+{
+    unsigned int i = mov_lazy_search_table(sc->stts_first_sample, sc->stts_count, sample);
+
+    return sc->stts_first_dts[i] +
+           (sample - sc->stts_first_sample[i]) * (int64_t)sc->stts_data[i].duration;
+}
+
+static int mov_lazy_is_keyframe(const MOVStreamContext *sc, unsigned int sample)
+{
+    int64_t key = (int64_t)sample + sc->lazy_key_off;
+    unsigned int a = 0, b = sc->keyframe_count;
+
+    if (sc->keyframe_absent)
+        return sc->lazy_all_keyframes || !sample;
+    if (!sc->keyframe_count)
+        return 1;
+    /* the keyframes are strictly increasing, see mov_lazy_index_init() */
+    while (a < b) {
+        unsigned int m = (a + b) >> 1;
+        if (sc->keyframes[m] < key)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a < sc->keyframe_count && sc->keyframes[a] == key;
+}
+
+/* Whether the sample at the given index is discarded by the edit list. */
+static int mov_lazy_is_discarded(const MOVStreamContext *sc, int index)
+{
+    int a = 0, b = sc->lazy_nb_discards;
+
+    if (index < sc->lazy_discard_head)
+        return 1;
+    while (a < b) {
+        int m = (a + b) >> 1;
+        if (sc->lazy_discards[m] < index)
+            a = m + 1;
+        else
+            b = m;
+    }
+    return a < sc->lazy_nb_discards && sc->lazy_discards[a] == index;
+}
+
+static void mov_lazy_cursor_set(const MOVStreamContext *sc, MOVSampleCursor *c,
+                                unsigned int sample)
+{
+    unsigned int i = mov_lazy_search_table(sc->stsc_first_sample, sc->stsc_count, sample);
+    int64_t offset = sample - sc->stsc_first_sample[i];
+
+    c->sample       = sample;
+    c->stsc_index   = i;
+    c->chunk        = (i ? sc->stsc_data[i].first - 1 : 0) + offset / sc->stsc_data[i].count;
+    c->chunk_sample = offset % sc->stsc_data[i].count;
+    c->pos          = sc->chunk_offsets[c->chunk];
+    if (sc->stsz_sample_size > 0) {
+        c->pos += c->chunk_sample * (int64_t)sc->stsz_sample_size;
+    } else {
+        for (i = sample - c->chunk_sample; i < sample; i++)
+            c->pos += sc->sample_sizes[i];
+    }
+
+    i = mov_lazy_search_table(sc->stts_first_sample, sc->stts_count, sample);
+    c->stts_index  = i;
+    c->stts_sample = sample - sc->stts_first_sample[i];
+    c->dts         = sc->stts_first_dts[i] + c->stts_sample * (int64_t)sc->stts_data[i].duration;
+}
+
+/* Move to the next sample, in the same way as mov_build_index() does. */
+static void mov_lazy_cursor_next(const MOVStreamContext *sc, MOVSampleCursor *c)
+{
+    c->pos += mov_lazy_sample_size(sc, c->sample);
+    c->dts += sc->stts_data[c->stts_index].duration;
+    if (++c->stts_sample == sc->stts_data[c->stts_index].count &&
+        c->stts_index + 1 < sc->stts_count) {
+        c->stts_index++;
+        c->stts_sample = 0;
+    }
+    c->sample++;
+    if (++c->chunk_sample == sc->stsc_data[c->stsc_index].count) {
+        c->chunk++;
+        c->chunk_sample = 0;
+        while (mov_stsc_index_valid(c->stsc_index, sc->stsc_count) &&
+               c->chunk + 1 == sc->stsc_data[c->stsc_index + 1].first)
+            c->stsc_index++;
+        if (c->chunk < sc->chunk_count)
+            c->pos = sc->chunk_offsets[c->chunk];
+    }
+}
+
+static void mov_lazy_update_entry(MOVStreamContext *sc)
+{
+    AVIndexEntry *e = &sc->lazy_entry;
+
+    if (sc->current_sample < 0 || sc->current_sample >= sc->lazy_count)
+        return;
+    e->pos          = sc->cursor.pos;
+    e->timestamp    = sc->cursor.dts + sc->lazy_dts_offset;
+    e->size         = mov_lazy_sample_size(sc, sc->cursor.sample);
+    e->min_distance = 0;
+    e->flags        = mov_lazy_is_keyframe(sc, sc->cursor.sample) ? AVINDEX_KEYFRAME : 0;
+    if (mov_lazy_is_discarded(sc, sc->current_sample))
+        e->flags |= AVINDEX_DISCARD_FRAME;
+}
+
+/**
+ * Same as ff_index_search_timestamp(), over the nb samples starting at start,
+ * with timestamps offset by dts_offset.
+ */
+static int mov_lazy_search_timestamp(const MOVStreamContext *sc, unsigned int start,
+                                     int nb, int64_t dts_offset, int with_discard,
+                                     int64_t wanted_timestamp, int flags)
+{
+    int a, b, m;
+    int64_t timestamp;
+
+#define TIMESTAMP(i) (mov_lazy_sample_dts(sc, start + (i)) + dts_offset)
+    a = -1;
+    b = nb;
+
+    if (b && TIMESTAMP(b - 1) < wanted_timestamp)
+        a = b - 1;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+
+        while (with_discard && mov_lazy_is_discarded(sc, m) && m < b && m < nb - 1) {
+            m++;
+            if (m == b && TIMESTAMP(m) >= wanted_timestamp) {
+                m = b - 1;
+                break;
+            }
+        }
+
+        timestamp = TIMESTAMP(m);
+        if (timestamp >= wanted_timestamp)
+            b = m;
+        if (timestamp <= wanted_timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+
+    if (!(flags & AVSEEK_FLAG_ANY))
+        while (m >= 0 && m < nb && !mov_lazy_is_keyframe(sc, start + m))
+            m += (flags & AVSEEK_FLAG_BACKWARD) ? -1 : 1;
+#undef TIMESTAMP
+
+    if (m == nb)
+        return -1;
+    return m;
+}
+
+/**
+ * Find the ctts entry of the given sample.
+ * Returns 1 if found, 0 if the sample is past the end of the ctts.
+ */
+static int mov_get_ctts_position(const MOVStreamContext *sc, int64_t sample,
+                                 int *ctts_index, int *ctts_sample)
+{
+    int64_t time_sample = 0;
+    unsigned int i;
+
+    for (i = 0; i < sc->ctts_count; i++) {
+        int64_t next = time_sample + sc->ctts_data[i].count;
+        if (next > sample) {
+            *ctts_index  = i;
+            *ctts_sample = sample - time_sample;
+            return 1;
+        }
+        time_sample = next;
+    }
+    return 0;
+}
+
 #define MAX_REORDER_DELAY 16
 static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
 {
@@ -3398,15 +3595,29 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
 
     if (st->codecpar->video_delay <= 0 && msc->ctts_data &&
         st->codecpar->codec_id == AV_CODEC_ID_H264) {
+        int nb_entries = st->nb_index_entries;
+        MOVSampleCursor cursor;
+
+        if (msc->lazy_index) {
+            nb_entries = msc->lazy_count;
+            if (!mov_get_ctts_position(msc, msc->lazy_start, &ctts_ind, &ctts_sample))
+                ctts_ind = msc->ctts_count;
+            mov_lazy_cursor_set(msc, &cursor, msc->lazy_start);
+        }
         st->codecpar->video_delay = 0;
-        for (ind = 0; ind < st->nb_index_entries && ctts_ind < msc->ctts_count; ++ind) {
+        for (ind = 0; ind < nb_entries && ctts_ind < msc->ctts_count; ++ind) {
             // Point j to the last elem of the buffer and insert the current pts there.
             j = buf_start;
             buf_start = (buf_start + 1);
             if (buf_start == MAX_REORDER_DELAY + 1)
                 buf_start = 0;
 
-            pts_buf[j] = st->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
+            if (msc->lazy_index) {
+                pts_buf[j] = cursor.dts + msc->lazy_dts_offset + msc->ctts_data[ctts_ind].duration;
+                mov_lazy_cursor_next(msc, &cursor);
+            } else {
+                pts_buf[j] = st->index_entries[ind].timestamp + msc->ctts_data[ctts_ind].duration;
+            }
 
             // The timestamps that are already in the sorted buffer, and are greater than the
             // current pts, are exactly the timestamps that need to be buffered to output PTS
@@ -3439,8 +3650,23 @@ static void mov_estimate_video_delay(MOVContext *c, AVStream* st)
     }
 }
 
+static void mov_lazy_seek_cursor(MOVStreamContext *sc)
+{
+    if (sc->current_sample >= 0 && sc->current_sample < sc->lazy_count)
+        mov_lazy_cursor_set(sc, &sc->cursor, sc->lazy_start + sc->current_sample);
+    mov_lazy_update_entry(sc);
+}
+
 static void mov_current_sample_inc(MOVStreamContext *sc)
 {
+    if (sc->lazy_index) {
+        if (sc->current_sample >= 0 && sc->current_sample < sc->lazy_count)
+            mov_lazy_cursor_next(sc, &sc->cursor);
+        sc->current_sample++;
+        sc->current_index++;
+        mov_lazy_update_entry(sc);
+        return;
+    }
     sc->current_sample++;
     sc->current_index++;
     if (sc->index_ranges &&
@@ -3455,6 +3681,10 @@ static void mov_current_sample_dec(MOVStreamContext *sc)
 {
     sc->current_sample--;
     sc->current_index--;
+    if (sc->lazy_index) {
+        mov_lazy_seek_cursor(sc);
+        return;
+    }
     if (sc->index_ranges &&
         sc->current_index < sc->current_index_range->start &&
         sc->current_index_range > sc->index_ranges) {
@@ -3469,6 +3699,11 @@ static void mov_current_sample_set(MOVStreamContext *sc, int current_sample)
 
     sc->current_sample = current_sample;
     sc->current_index = current_sample;
+    if (sc->lazy_index) {
+        sc->current_index += sc->lazy_start;
+        mov_lazy_seek_cursor(sc);
+        return;
+    }
     if (!sc->index_ranges) {
         return;
     }
@@ -3971,7 +4206,9 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                     av_log(mov->fc, AV_LOG_TRACE, "AVIndex stream %d, sample %u, offset %"PRIx64", dts %"PRId64", "
                             "size %u, distance %u, keyframe %d\n", st->index, current_sample,
                             current_offset, current_dts, sample_size, distance, keyframe);
-                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100)
+                    /* already done by mov_lazy_index_init() */
+                    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && st->nb_index_entries < 100 &&
+                        !sc->lazy_index)
                         ff_rfps_add_frame(mov->fc, st, current_dts);
                 }
 
@@ -4127,6 +4364,378 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     mov_estimate_video_delay(mov, st);
 }
 
+/**
+ * Emulate find_prev_closest_index() over the sample tables.
+ */
+static int64_t mov_lazy_find_prev_closest(const MOVStreamContext *sc, int total,
+                                          int64_t ctts_total, int64_t timestamp_pts,
+                                          int flag)
+{
+    int64_t index, i;
+
+    if (sc->dts_shift > 0)
+        timestamp_pts -= sc->dts_shift;
+
+    index = mov_lazy_search_timestamp(sc, 0, total, 0, 0, timestamp_pts,
+                                      flag | AVSEEK_FLAG_BACKWARD);
+
+    if (index >= 0) {
+        for (i = index; i > 0 && mov_lazy_sample_dts(sc, i) == mov_lazy_sample_dts(sc, i - 1); i--) {
+            if ((flag & AVSEEK_FLAG_ANY) || mov_lazy_is_keyframe(sc, i - 1))
+                index = i - 1;
+        }
+    }
+
+    if (sc->ctts_data && index >= 0 && index < ctts_total) {
+        int ctts_index = 0, ctts_sample = 0;
+
+        mov_get_ctts_position(sc, index, &ctts_index, &ctts_sample);
+        while (index >= 0) {
+            if (mov_lazy_sample_dts(sc, index) + sc->ctts_data[ctts_index].duration <= timestamp_pts &&
+                mov_lazy_is_keyframe(sc, index))
+                break;
+            index--;
+            if (ctts_sample) {
+                ctts_sample--;
+            } else if (ctts_index) {
+                ctts_index--;
+                ctts_sample = sc->ctts_data[ctts_index].count - 1;
+            }
+        }
+    }
+    return index;
+}
+
+/**
+ * Emulate mov_fix_index() for a single edit, possibly preceded by an empty
+ * one, without touching the stream. The in-edit samples are the ones between
+ * *start and *end, with timestamps offset by *dts_offset from the media
+ * timeline.
+ * Returns 0 on success, a negative value if mov_fix_index() must be used.
+ */
+static int mov_lazy_edit(MOVContext *mov, AVStream *st, int total,
+                         int64_t media_time, int64_t edit_duration,
+                         int64_t empty_duration, int *skip_samples)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int is_audio = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+    int skip_partial = is_audio && st->codecpar->codec_id != AV_CODEC_ID_VORBIS;
+    int64_t ctts_total = 0, counter, timestamp, start, s;
+    int64_t min_corrected_pts = -1, dts_offset = 0;
+    int ctts_index = 0, ctts_sample = 0, has_ctts = 0;
+    int started = 0, found_keyframe_after_edit = 0;
+    int nb_discard_head = 0, end = total;
+    int *discards = NULL, nb_discards = 0;
+    unsigned int discards_size = 0;
+    MOVSampleCursor cursor;
+    unsigned int i;
+
+    for (i = 0; i < sc->ctts_count; i++)
+        ctts_total += sc->ctts_data[i].count;
+    ctts_total = FFMIN(ctts_total, sc->sample_count);
+
+    counter = empty_duration - sc->dts_shift;
+    *skip_samples = 0;
+
+    timestamp = media_time;
+    if (is_audio)
+        timestamp = FFMAX(timestamp - sc->time_scale, sc->stts_first_dts[0]);
+    start = mov_lazy_find_prev_closest(sc, total, ctts_total, timestamp, 0);
+    if (start < 0)
+        start = mov_lazy_find_prev_closest(sc, total, ctts_total, timestamp, AVSEEK_FLAG_ANY);
+    if (start < 0)
+        start = 0;
+
+    if (sc->ctts_data)
+        has_ctts = mov_get_ctts_position(sc, start, &ctts_index, &ctts_sample);
+
+    mov_lazy_cursor_set(sc, &cursor, start);
+    for (s = start; s < total; s++, mov_lazy_cursor_next(sc, &cursor)) {
+        int64_t frame_duration = s + 1 < total ?
+                                 sc->stts_data[cursor.stts_index].duration : edit_duration;
+        int64_t curr_ctts = 0, curr_cts;
+        int discard = 0;
+
+        if (has_ctts && s < ctts_total) {
+            curr_ctts = sc->ctts_data[ctts_index].duration;
+            if (++ctts_sample == sc->ctts_data[ctts_index].count) {
+                ctts_index++;
+                ctts_sample = 0;
+            }
+        }
+        curr_cts = cursor.dts + sc->dts_shift + curr_ctts;
+
+        if (curr_cts < media_time || curr_cts >= edit_duration + media_time) {
+            if (skip_partial && curr_cts < media_time &&
+                curr_cts + frame_duration > media_time) {
+                int packet_skip_samples = media_time - curr_cts;
+                if (started)
+                    goto fail;
+                *skip_samples += packet_skip_samples;
+                counter -= packet_skip_samples;
+                started = 1;
+                dts_offset = counter - cursor.dts;
+            } else {
+                discard = 1;
+                if (!started) {
+                    nb_discard_head++;
+                    if (skip_partial)
+                        *skip_samples += frame_duration;
+                }
+            }
+        } else {
+            if (min_corrected_pts < 0)
+                min_corrected_pts = counter + curr_ctts + sc->dts_shift;
+            else
+                min_corrected_pts = FFMIN(min_corrected_pts, counter + curr_ctts + sc->dts_shift);
+            if (!started) {
+                started = 1;
+                dts_offset = counter - cursor.dts;
+            }
+        }
+
+        if (discard && started) {
+            int *tmp;
+            if (nb_discards >= INT_MAX / sizeof(*discards) - 1)
+                goto fail;
+            tmp = av_fast_realloc(discards, &discards_size,
+                                  (nb_discards + 1) * sizeof(*discards));
+            if (!tmp)
+                goto fail;
+            discards = tmp;
+            discards[nb_discards++] = s - start;
+        }
+
+        if (started)
+            counter += frame_duration;
+
+        if (curr_cts + frame_duration >= edit_duration + media_time &&
+            (mov_lazy_is_keyframe(sc, s) || is_audio)) {
+            // wait for the trailing B-frames of the last keyframe, as mov_fix_index() does
+            if (sc->ctts_data && !is_audio && !found_keyframe_after_edit) {
+                found_keyframe_after_edit = 1;
+                continue;
+            }
+            end = s + 1;
+            break;
+        }
+    }
+    if (!started)
+        goto fail;
+
+    min_corrected_pts -= empty_duration;
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && min_corrected_pts > 0)
+        dts_offset -= min_corrected_pts;
+
+    sc->min_corrected_pts = min_corrected_pts;
+    sc->lazy_start        = start;
+    sc->lazy_count        = end - start;
+    sc->lazy_dts_offset   = dts_offset;
+    sc->lazy_discard_head = nb_discard_head;
+    sc->lazy_discards     = discards;
+    sc->lazy_nb_discards  = nb_discards;
+    st->start_time = empty_duration;
+    st->duration = FFMIN(st->duration, empty_duration + edit_duration);
+    return 0;
+
+fail:
+    av_free(discards);
+    return AVERROR_PATCHWELCOME;
+}
+
+/**
+ * Set up demuxing the track straight from its sample tables instead of
+ * building the AVIndex, which takes tens of bytes per sample. This is only
+ * done for tables and edit lists simple enough to be looked up directly; the
+ * packets and stream parameters are the same as with mov_build_index().
+ * Returns 1 if the track uses the lazy index, 0 if the AVIndex must be built.
+ */
+static int mov_lazy_index_init(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int is_audio = st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO;
+    int64_t media_time = 0, edit_duration = 0, empty_duration = 0;
+    int64_t total = 0, dts;
+    uint64_t stream_size = 0;
+    int skip_samples = 0, ctts_index, ctts_sample;
+    unsigned int i;
+
+    if (!mov->lazy_index || st->nb_index_entries ||
+        (!is_audio && st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) ||
+        !sc->sample_count || !sc->chunk_count || !sc->stsc_count || !sc->stts_count ||
+        sc->sample_count >= UINT_MAX / sizeof(*st->index_entries) ||
+        (is_audio && sc->stts_count == 1 && sc->stts_data[0].duration == 1) ||
+        sc->stps_count ||
+        (sc->rap_group_count && sc->rap_group) ||
+        (sc->stsz_sample_size <= 0 && !sc->sample_sizes) ||
+        (sc->stsz_sample_size > 0 && sc->sample_size > 0 &&
+         sc->stsz_sample_size != sc->sample_size))
+        return 0;
+
+    if (sc->elst_count) {
+        const MOVElst *e = sc->elst_data;
+
+        if (!mov->advanced_editlist || mov->time_scale <= 0)
+            return 0;
+        if (sc->elst_count == 2 && e[0].time == -1) {
+            empty_duration = av_rescale(e[0].duration, sc->time_scale, mov->time_scale);
+            e++;
+        } else if (sc->elst_count != 1) {
+            return 0;
+        }
+        if (e->time < 0 || (is_audio && sc->ctts_data))
+            return 0;
+        media_time    = e->time;
+        edit_duration = av_rescale(e->duration, sc->time_scale, mov->time_scale);
+    }
+
+    for (i = 0; i < sc->stsc_count; i++) {
+        int64_t first = i ? sc->stsc_data[i].first - 1 : 0;
+        int64_t last  = mov_stsc_index_valid(i, sc->stsc_count) ?
+                        FFMIN(sc->stsc_data[i + 1].first - 1, sc->chunk_count) : sc->chunk_count;
+        if (sc->stsc_data[i].count <= 0 ||
+            (sc->pseudo_stream_id != -1 && sc->stsc_data[i].id - 1 != sc->pseudo_stream_id) ||
+            (i && (sc->stsc_data[i].first < 2 ||
+                   sc->stsc_data[i].first <= sc->stsc_data[i - 1].first)))
+            return 0;
+        if (last > first)
+            total += (last - first) * sc->stsc_data[i].count;
+    }
+    if (!total || total > sc->sample_count)
+        return 0;
+
+    for (i = 0; i < sc->stts_count; i++) {
+        if (sc->stts_data[i].duration < 0 ||
+            (!sc->stts_data[i].count && i + 1 < sc->stts_count))
+            return 0;
+    }
+
+    if (sc->keyframe_count && sc->keyframes[0] < 0)
+        return 0;
+    for (i = 1; i < sc->keyframe_count; i++) {
+        if (sc->keyframes[i] <= sc->keyframes[i - 1])
+            return 0;
+    }
+
+    if (sc->stsz_sample_size > 0) {
+        if (sc->stsz_sample_size > 0x3FFFFFFF)
+            return 0;
+        stream_size = total * sc->stsz_sample_size;
+    } else {
+        for (i = 0; i < total; i++) {
+            if (sc->sample_sizes[i] > 0x3FFFFFFF)
+                return 0;
+            stream_size += sc->sample_sizes[i];
+        }
+    }
+
+    sc->stsc_first_sample = av_malloc_array(sc->stsc_count, sizeof(*sc->stsc_first_sample));
+    sc->stts_first_sample = av_malloc_array(sc->stts_count, sizeof(*sc->stts_first_sample));
+    sc->stts_first_dts    = av_malloc_array(sc->stts_count, sizeof(*sc->stts_first_dts));
+    if (!sc->stsc_first_sample || !sc->stts_first_sample || !sc->stts_first_dts)
+        goto fail;
+
+    total = 0;
+    for (i = 0; i < sc->stsc_count; i++) {
+        int64_t first = i ? sc->stsc_data[i].first - 1 : 0;
+        int64_t last  = mov_stsc_index_valid(i, sc->stsc_count) ?
+                        FFMIN(sc->stsc_data[i + 1].first - 1, sc->chunk_count) : sc->chunk_count;
+        sc->stsc_first_sample[i] = total;
+        if (last > first)
+            total += (last - first) * sc->stsc_data[i].count;
+    }
+    dts = -sc->dts_shift;
+    for (i = 0; i < sc->stts_count; i++) {
+        sc->stts_first_sample[i] = i ? sc->stts_first_sample[i - 1] + sc->stts_data[i - 1].count : 0;
+        sc->stts_first_dts[i]    = dts;
+        dts += sc->stts_data[i].count * (int64_t)sc->stts_data[i].duration;
+    }
+    sc->lazy_key_off       = sc->keyframe_count && sc->keyframes[0] > 0;
+    sc->lazy_all_keyframes = is_audio;
+    sc->lazy_start         = 0;
+    sc->lazy_count         = total;
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        for (i = 0; i < FFMIN(total, 99); i++)
+            ff_rfps_add_frame(mov->fc, st, mov_lazy_sample_dts(sc, i));
+    }
+    if (st->duration > 0)
+        st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+
+    if (sc->elst_count) {
+        if (empty_duration || media_time)
+            sc->time_offset = media_time - (uint64_t)empty_duration;
+        if (mov_lazy_edit(mov, st, total, media_time, edit_duration,
+                          empty_duration, &skip_samples) < 0)
+            goto fail;
+        if (is_audio)
+            st->internal->skip_samples = skip_samples;
+        sc->start_pad = st->internal->skip_samples;
+    }
+
+    av_log(mov->fc, AV_LOG_DEBUG, "st: %d using the sample tables as index, %d samples from %u\n",
+           st->index, sc->lazy_count, sc->lazy_start);
+    sc->lazy_index = 1;
+    sc->ctts_index = sc->ctts_count;
+    sc->ctts_sample = 0;
+    if (sc->ctts_data && mov_get_ctts_position(sc, sc->lazy_start, &ctts_index, &ctts_sample)) {
+        sc->ctts_index  = ctts_index;
+        sc->ctts_sample = ctts_sample;
+    }
+    mov_current_sample_set(sc, 0);
+
+    if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        st->start_time = sc->lazy_entry.timestamp + sc->dts_shift;
+        if (sc->ctts_data && sc->ctts_index < sc->ctts_count)
+            st->start_time += sc->ctts_data[sc->ctts_index].duration;
+    }
+
+    mov_estimate_video_delay(mov, st);
+    return 1;
+
+fail:
+    av_freep(&sc->stsc_first_sample);
+    av_freep(&sc->stts_first_sample);
+    av_freep(&sc->stts_first_dts);
+    return 0;
+}
+
+/**
+ * Build the AVIndex of a track using the lazy index, for the code that needs
+ * all the samples at hand.
+ */
+static void mov_lazy_index_disable(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t bit_rate = st->codecpar->bit_rate;
+    int skip_samples = st->internal->skip_samples;
+    int current_sample = sc->current_sample;
+
+    if (!sc->lazy_index)
+        return;
+
+    mov_build_index(mov, st);
+    st->codecpar->bit_rate = bit_rate;
+    st->internal->skip_samples = skip_samples;
+
+    sc->lazy_index = 0;
+    av_freep(&sc->lazy_discards);
+    av_freep(&sc->stsc_first_sample);
+    av_freep(&sc->stts_first_sample);
+    av_freep(&sc->stts_first_dts);
+    av_freep(&sc->chunk_offsets);
+    av_freep(&sc->sample_sizes);
+    av_freep(&sc->keyframes);
+    av_freep(&sc->stts_data);
+    av_freep(&sc->stps_data);
+    av_freep(&sc->elst_data);
+    av_freep(&sc->rap_group);
+
+    mov_current_sample_set(sc, current_sample);
+    if (sc->ctts_data)
+        mov_get_ctts_position(sc, current_sample, &sc->ctts_index, &sc->ctts_sample);
+}
+
 static int test_same_origin(const char *src, const char *ref) {
     char src_proto[64];
     char ref_proto[64];
@@ -4285,7 +4894,8 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
 
     avpriv_set_pts_info(st, 64, 1, sc->time_scale);
 
-    mov_build_index(c, st);
+    if (!mov_lazy_index_init(c, st))
+        mov_build_index(c, st);
 
     if (sc->dref_id-1 < sc->drefs_count && sc->drefs[sc->dref_id-1].path) {
         MOVDref *dref = &sc->drefs[sc->dref_id - 1];
@@ -4355,6 +4965,9 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             st->need_parsing = AVSTREAM_PARSE_FULL;
     }
+    /* The lazy index looks the samples up in the tables. */
+    if (sc->lazy_index)
+        return 0;
     /* Do not need those anymore. */
     av_freep(&sc->chunk_offsets);
     av_freep(&sc->sample_sizes);
@@ -4812,6 +5425,8 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
 
+    mov_lazy_index_disable(c, st);
+
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
     //
@@ -5060,16 +5675,48 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     return 0;
 }
 
-static int mov_read_sidx(MOVContext *c, AVIOContext *pb, MOVAtom atom)
+#define MOV_MAX_SIDX_DEPTH 4
+
+/**
+ * Read the header of the box at the given offset, leaving pb at its payload.
+ */
+static int mov_read_box_header(AVIOContext *pb, int64_t offset, MOVAtom *a)
+{
+    int64_t size;
+
+    if (avio_seek(pb, offset, SEEK_SET) != offset)
+        return AVERROR_INVALIDDATA;
+    size    = avio_rb32(pb);
+    a->type = avio_rl32(pb);
+    if (size == 1) {
+        size = avio_rb64(pb) - 8;
+    } else if (!size) {
+        size = avio_size(pb) - offset;
+    }
+    if (avio_feof(pb))
+        return AVERROR_EOF;
+    if (size < 8)
+        return AVERROR_INVALIDDATA;
+    a->size = size - 8;
+    return 0;
+}
+
+/**
+ * Parse a sidx box and add the fragments it references to the fragment
+ * index. Hierarchical sidx boxes are followed down to the ones referencing
+ * the media.
+ * Returns 1 and the end offset of the referenced data in *end if the sidx
+ * was used, 0 if it was ignored, or a negative error code.
+ */
+static int mov_parse_sidx(MOVContext *c, AVIOContext *pb, MOVAtom atom,
+                          int depth, int64_t *end)
 {
-    int64_t stream_size = avio_size(pb);
     int64_t offset = av_sat_add64(avio_tell(pb), atom.size), pts, timestamp;
-    uint8_t version, is_complete;
+    uint8_t version;
     int64_t offadd;
-    unsigned i, j, track_id, item_count;
+    unsigned i, track_id, item_count;
     AVStream *st = NULL;
-    AVStream *ref_st = NULL;
-    MOVStreamContext *sc, *ref_sc = NULL;
+    MOVStreamContext *sc;
     AVRational timescale;
 
     version = avio_r8(pb);
@@ -5122,17 +5769,36 @@ static int mov_read_sidx(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         MOVFragmentStreamInfo * frag_stream_info;
         uint32_t size = avio_rb32(pb);
         uint32_t duration = avio_rb32(pb);
-        if (size & 0x80000000) {
-            avpriv_request_sample(c->fc, "sidx reference_type 1");
-            return AVERROR_PATCHWELCOME;
-        }
         avio_rb32(pb); // sap_flags
-        timestamp = av_rescale_q(pts, timescale, st->time_base);
+        if (size & 0x80000000) {
+            int64_t pos = avio_tell(pb), child_end;
+            MOVAtom child;
+            int ret;
+
+            size &= 0x7FFFFFFF;
+            if (depth >= MOV_MAX_SIDX_DEPTH || !(pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+                avpriv_request_sample(c->fc, "sidx reference_type 1");
+                return AVERROR_PATCHWELCOME;
+            }
+            ret = mov_read_box_header(pb, offset, &child);
+            if (ret >= 0 && child.type != MKTAG('s','i','d','x'))
+                ret = AVERROR_INVALIDDATA;
+            if (ret >= 0)
+                ret = mov_parse_sidx(c, pb, child, depth + 1, &child_end);
+            if (ret < 0) {
+                av_log(c->fc, AV_LOG_ERROR, "Invalid sidx reference at 0x%"PRIx64"\n", offset);
+                return ret;
+            }
+            if (avio_seek(pb, pos, SEEK_SET) != pos)
+                return AVERROR_INVALIDDATA;
+        } else {
+            timestamp = av_rescale_q(pts, timescale, st->time_base);
 
-        index = update_frag_index(c, offset);
-        frag_stream_info = get_frag_stream_info(&c->frag_index, index, track_id);
-        if (frag_stream_info)
-            frag_stream_info->sidx_pts = timestamp;
+            index = update_frag_index(c, offset);
+            frag_stream_info = get_frag_stream_info(&c->frag_index, index, track_id);
+            if (frag_stream_info)
+                frag_stream_info->sidx_pts = timestamp;
+        }
 
         if (av_sat_add64(offset, size) != offset + (uint64_t)size ||
             av_sat_add64(pts, duration) != pts + (uint64_t)duration
@@ -5142,25 +5808,120 @@ static int mov_read_sidx(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         pts += duration;
     }
 
-    st->duration = sc->track_end = pts;
+    if (!depth)
+        st->duration = sc->track_end = pts;
 
     sc->has_sidx = 1;
+    *end = offset;
+
+    return 1;
+}
+
+/**
+ * Read the sidx boxes following the one ending at pos, jumping over the
+ * fragments they reference instead of parsing them. This indexes the files
+ * with one sidx per segment the same way as the ones with a global sidx.
+ * Returns 1 if all the fragments up to the end of the file are referenced,
+ * in which case *end is set to the end of the last one, 0 otherwise.
+ */
+static int mov_walk_sidx(MOVContext *c, AVIOContext *pb, int64_t pos, int64_t *end)
+{
+    int64_t stream_size = avio_size(pb);
+    int64_t original_pos = avio_tell(pb);
+    int64_t ref_end = *end;
+    int ret = 0;
+
+    while (pos < stream_size) {
+        MOVAtom a;
+        int64_t box_end;
+
+        if (ff_check_interrupt(&c->fc->interrupt_callback)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if ((ret = mov_read_box_header(pb, pos, &a)) < 0)
+            break;
+        box_end = av_sat_add64(avio_tell(pb), a.size);
+
+        if (a.type == MKTAG('s','i','d','x')) {
+            int64_t sidx_end;
+            if ((ret = mov_parse_sidx(c, pb, a, 0, &sidx_end)) < 0)
+                break;
+            if (ret)
+                ref_end = FFMAX(ref_end, sidx_end);
+            pos = box_end;
+        } else if (a.type == MKTAG('m','o','o','f') || a.type == MKTAG('m','d','a','t')) {
+            // a fragment no sidx references, it must be parsed
+            if (pos >= ref_end) {
+                ret = 0;
+                break;
+            }
+            pos = ref_end;
+        } else {
+            pos = box_end;
+        }
+    }
+
+    if (avio_seek(pb, original_pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    if (ret < 0 && ret != AVERROR_EOF) {
+        if (ret == AVERROR_EXIT)
+            return ret;
+        av_log(c->fc, AV_LOG_WARNING, "Stopped walking the sidx boxes at 0x%"PRIx64"\n", pos);
+        return 0;
+    }
+    if (pos < stream_size)
+        return 0;
+    *end = ref_end;
+    return 1;
+}
+
+static int mov_read_sidx(MOVContext *c, AVIOContext *pb, MOVAtom atom)
+{
+    int64_t stream_size = avio_size(pb);
+    int64_t box_end = av_sat_add64(avio_tell(pb), atom.size);
+    int64_t offset;
+    uint8_t is_complete;
+    unsigned i, j;
+    AVStream *st;
+    AVStream *ref_st = NULL;
+    MOVStreamContext *sc, *ref_sc = NULL;
+    int ret;
+
+    // already read when walking the sidx boxes
+    if (c->sidx_walked)
+        return 0;
+
+    ret = mov_parse_sidx(c, pb, atom, 0, &offset);
+    if (ret <= 0)
+        return ret;
 
     // See if the remaining bytes are just an mfra which we can ignore.
     is_complete = offset == stream_size;
     if (!is_complete && (pb->seekable & AVIO_SEEKABLE_NORMAL) && stream_size > 0 ) {
-        int64_t ret;
+        int64_t ret64;
         int64_t original_pos = avio_tell(pb);
         if (!c->have_read_mfra_size) {
-            if ((ret = avio_seek(pb, stream_size - 4, SEEK_SET)) < 0)
-                return ret;
+            if ((ret64 = avio_seek(pb, stream_size - 4, SEEK_SET)) < 0)
+                return ret64;
             c->mfra_size = avio_rb32(pb);
             c->have_read_mfra_size = 1;
-            if ((ret = avio_seek(pb, original_pos, SEEK_SET)) < 0)
-                return ret;
+            if ((ret64 = avio_seek(pb, original_pos, SEEK_SET)) < 0)
+                return ret64;
         }
         if (offset == stream_size - c->mfra_size)
             is_complete = 1;
+
+        if (!is_complete && c->walk_sidx && !c->frag_index.complete) {
+            ret = mov_walk_sidx(c, pb, box_end, &offset);
+            if (ret < 0)
+                return ret;
+            if (ret) {
+                av_log(c->fc, AV_LOG_DEBUG, "Indexed %d fragments from the sidx boxes\n",
+                       c->frag_index.nb_items);
+                c->sidx_walked = is_complete = 1;
+            }
+        }
     }
 
     if (is_complete) {
@@ -7246,6 +8007,7 @@ static void mov_read_chapters(AVFormatContext *s)
 
         sc = st->priv_data;
         cur_pos = avio_tell(sc->pb);
+        mov_lazy_index_disable(mov, st);
 
         if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             st->disposition |= AV_DISPOSITION_ATTACHED_PIC | AV_DISPOSITION_TIMED_THUMBNAILS;
@@ -7436,6 +8198,10 @@ static int mov_read_close(AVFormatContext *s)
         av_freep(&sc->rap_group);
         av_freep(&sc->display_matrix);
         av_freep(&sc->index_ranges);
+        av_freep(&sc->lazy_discards);
+        av_freep(&sc->stsc_first_sample);
+        av_freep(&sc->stts_first_sample);
+        av_freep(&sc->stts_first_dts);
 
         if (sc->extradata)
             for (j = 0; j < sc->stsd_count; j++)
@@ -7827,6 +8593,26 @@ fail:
     return err;
 }
 
+static AVIndexEntry *mov_get_current_sample(AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->lazy_index)
+        return sc->current_sample >= 0 && sc->current_sample < sc->lazy_count ?
+               &sc->lazy_entry : NULL;
+    return sc->current_sample < st->nb_index_entries ?
+           &st->index_entries[sc->current_sample] : NULL;
+}
+
+static int64_t mov_get_sample_timestamp(AVStream *st, int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (sc->lazy_index)
+        return mov_lazy_sample_dts(sc, sc->lazy_start + sample) + sc->lazy_dts_offset;
+    return st->index_entries[sample].timestamp;
+}
+
 static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
 {
     AVIndexEntry *sample = NULL;
@@ -7835,8 +8621,8 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avst->nb_index_entries) {
-            AVIndexEntry *current_sample = &avst->index_entries[msc->current_sample];
+        AVIndexEntry *current_sample = mov_get_current_sample(avst);
+        if (msc->pb && current_sample) {
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -7944,7 +8730,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc;
-    AVIndexEntry *sample;
+    AVIndexEntry *sample, lazy_sample;
     AVStream *st = NULL;
     int64_t current_index;
     int ret;
@@ -7959,6 +8745,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         goto retry;
     }
     sc = st->priv_data;
+    if (sc->lazy_index) {
+        /* the lazy index entry moves to the next sample below */
+        lazy_sample = *sample;
+        sample = &lazy_sample;
+    }
     /* must be done just before reading, to avoid infinite loop on sample */
     current_index = sc->current_index;
     mov_current_sample_inc(sc);
@@ -8039,8 +8830,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < st->nb_index_entries) ?
-            st->index_entries[sc->current_sample].timestamp : st->duration;
+        AVIndexEntry *next_sample = mov_get_current_sample(st);
+        int64_t next_dts = next_sample ? next_sample->timestamp : st->duration;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -8089,7 +8880,7 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp)
 {
     MOVContext *mov = s->priv_data;
-    int index;
+    int index, sample, ret;
 
     if (!mov->frag_index.complete)
         return 0;
@@ -8097,10 +8888,25 @@ static int mov_seek_fragment(AVFormatContext *s, AVStream *st, int64_t timestamp
     index = search_frag_timestamp(&mov->frag_index, st, timestamp);
     if (index < 0)
         index = 0;
-    if (!mov->frag_index.item[index].headers_read)
-        return mov_switch_root(s, -1, index);
-    if (index + 1 < mov->frag_index.nb_items)
-        mov->next_root_atom = mov->frag_index.item[index + 1].moof_offset;
+
+    // A fragment does not have to start with a keyframe, read the previous
+    // ones until the keyframe the seek lands on is in the index.
+    for (;;) {
+        int64_t moof_offset = mov->frag_index.item[index].moof_offset;
+
+        if (!mov->frag_index.item[index].headers_read) {
+            if ((ret = mov_switch_root(s, -1, index)) < 0)
+                return ret;
+        } else if (index + 1 < mov->frag_index.nb_items) {
+            mov->next_root_atom = mov->frag_index.item[index + 1].moof_offset;
+        }
+        if (!index)
+            break;
+        sample = av_index_search_timestamp(st, timestamp, AVSEEK_FLAG_BACKWARD);
+        if (sample >= 0 && st->index_entries[sample].pos >= moof_offset)
+            break;
+        index--;
+    }
 
     return 0;
 }
@@ -8119,27 +8925,23 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     if (ret < 0)
         return ret;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
+    if (sc->lazy_index)
+        sample = mov_lazy_search_timestamp(sc, sc->lazy_start, sc->lazy_count,
+                                           sc->lazy_dts_offset, 1, timestamp, flags);
+    else
+        sample = av_index_search_timestamp(st, timestamp, flags);
     av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-    if (sample < 0 && st->nb_index_entries && timestamp < st->index_entries[0].timestamp)
+    if (sample < 0 && (sc->lazy_index ? sc->lazy_count : st->nb_index_entries) &&
+        timestamp < mov_get_sample_timestamp(st, 0))
         sample = 0;
     if (sample < 0) /* not sure what to do */
         return AVERROR_INVALIDDATA;
     mov_current_sample_set(sc, sample);
     av_log(s, AV_LOG_TRACE, "stream %d, found sample %d\n", st->index, sc->current_sample);
     /* adjust ctts index */
-    if (sc->ctts_data) {
-        time_sample = 0;
-        for (i = 0; i < sc->ctts_count; i++) {
-            int next = time_sample + sc->ctts_data[i].count;
-            if (next > sc->current_sample) {
-                sc->ctts_index = i;
-                sc->ctts_sample = sc->current_sample - time_sample;
-                break;
-            }
-            time_sample = next;
-        }
-    }
+    if (sc->ctts_data)
+        mov_get_ctts_position(sc, (sc->lazy_index ? sc->lazy_start : 0) + sc->current_sample,
+                              &sc->ctts_index, &sc->ctts_sample);
 
     /* adjust stsd index */
     if (sc->chunk_count) {
@@ -8162,8 +8964,8 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
 static int64_t mov_get_skip_samples(AVStream *st, int sample)
 {
     MOVStreamContext *sc = st->priv_data;
-    int64_t first_ts = st->index_entries[0].timestamp;
-    int64_t ts = st->index_entries[sample].timestamp;
+    int64_t first_ts = mov_get_sample_timestamp(st, 0);
+    int64_t ts = mov_get_sample_timestamp(st, sample);
     int64_t off;
 
     if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
@@ -8192,7 +8994,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = st->index_entries[sample].timestamp;
+        int64_t seek_timestamp = mov_get_sample_timestamp(st, sample);
         st->internal->skip_samples = mov_get_skip_samples(st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
@@ -8245,8 +9047,16 @@ static const AVOption mov_options[] = {
         "Modify the AVIndex according to the editlists. Use this option to decode in the order specified by the edits.",
         OFFSET(advanced_editlist), AV_OPT_TYPE_BOOL, {.i64 = 1},
         0, 1, FLAGS},
+    {"lazy_index",
+        "Look the samples up in the sample tables instead of building an index",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"ignore_chapters", "", OFFSET(ignore_chapters), AV_OPT_TYPE_BOOL, {.i64 = 0},
         0, 1, FLAGS},
+    {"walk_sidx",
+        "Index the fragments from the chain of per-segment sidx boxes instead of parsing them",
+        OFFSET(walk_sidx), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"use_mfra_for",
         "use mfra for fragment timestamps",
         OFFSET(use_mfra_for), AV_OPT_TYPE_INT, {.i64 = FF_MOV_FLAG_MFRA_AUTO},
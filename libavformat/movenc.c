@@ -62,6 +62,8 @@ static const AVOption options[] = {
     { "movflags", "MOV muxer flags", offsetof(MOVMuxContext, flags), AV_OPT_TYPE_FLAGS, {.i64 = 0}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "rtphint", "Add RTP hint tracks", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_RTP_HINT}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "moov_size", "maximum moov size so it can be placed at the begin", offsetof(MOVMuxContext, reserved_moov_size), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "reserve_moov", "With faststart, reserve the estimated moov size at the begin instead of moving the data in a second pass", offsetof(MOVMuxContext, reserve_moov), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_ENCODING_PARAM, 0 },
+    { "reserve_moov_duration", "Duration the moov size is estimated for when the stream durations are unknown", offsetof(MOVMuxContext, reserve_moov_duration), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM, 0 },
     { "empty_moov", "Make the initial moov atom empty", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_EMPTY_MOOV}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_keyframe", "Fragment at video keyframes", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_KEYFRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
     { "frag_every_frame", "Fragment at every frame", 0, AV_OPT_TYPE_CONST, {.i64 = FF_MOV_FLAG_FRAG_EVERY_FRAME}, INT_MIN, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM, "movflags" },
@@ -6418,6 +6420,64 @@ static int mov_create_dvd_sub_decoder_specific_info(MOVTrack *track,
     return 0;
 }
 
+/*
+ * Estimate an upper bound of the moov size from the expected duration and
+ * sample rate of each stream, counting per sample the stsz entry, a ctts
+ * entry and a sync sample entry for video, and a 64 bit chunk offset
+ * which also covers non constant sample durations in stts.
+ * Returns 0 if the duration of a stream is unknown.
+ */
+static int64_t estimate_moov_size(AVFormatContext *s)
+{
+    MOVMuxContext *mov = s->priv_data;
+    int64_t size = 16384;
+    int i;
+
+    for (i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        AVCodecParameters *par = st->codecpar;
+        AVRational rate;
+        int64_t duration, nb_samples;
+        int entry_size;
+
+        if (st->duration > 0)
+            duration = av_rescale_q(st->duration, st->time_base, AV_TIME_BASE_Q);
+        else
+            duration = mov->reserve_moov_duration;
+        if (duration <= 0)
+            return 0;
+
+        switch (par->codec_type) {
+        case AVMEDIA_TYPE_VIDEO:
+            rate = st->avg_frame_rate;
+            if (rate.num <= 0 || rate.den <= 0)
+                rate = st->r_frame_rate;
+            if (rate.num <= 0 || rate.den <= 0)
+                rate = (AVRational){ 60, 1 };
+            entry_size = 4 + 8 + 4 + 8;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            rate = (AVRational){ par->sample_rate,
+                                 par->frame_size > 0 ? par->frame_size : 1024 };
+            if (rate.num <= 0)
+                rate = (AVRational){ 50, 1 };
+            entry_size = 4 + 8;
+            break;
+        default:
+            rate = (AVRational){ 10, 1 };
+            entry_size = 4 + 8 + 8;
+            break;
+        }
+
+        nb_samples = av_rescale(duration, rate.num, (int64_t)rate.den * AV_TIME_BASE) + 1;
+        size += 4096 + par->extradata_size + nb_samples * entry_size;
+        if (size > INT_MAX)
+            return size;
+    }
+
+    return size + size / 10;
+}
+
 static int mov_init(AVFormatContext *s)
 {
     MOVMuxContext *mov = s->priv_data;
@@ -6473,6 +6533,14 @@ static int mov_init(AVFormatContext *s)
 
     if (mov->flags & FF_MOV_FLAG_FASTSTART) {
         mov->reserved_moov_size = -1;
+        if (mov->reserve_moov && !(mov->flags & FF_MOV_FLAG_FRAGMENT)) {
+            int64_t size = estimate_moov_size(s);
+            if (size > 0 && size <= INT_MAX)
+                mov->reserved_moov_size = size;
+            else
+                av_log(s, AV_LOG_VERBOSE, "Unable to estimate the moov size, "
+                       "reserving no space for it\n");
+        }
     }
 
     if (mov->use_editlist < 0) {
@@ -6844,7 +6912,7 @@ static int mov_write_header(AVFormatContext *s)
             !mov->max_fragment_duration && !mov->max_fragment_size)
             mov->flags |= FF_MOV_FLAG_FRAG_KEYFRAME;
     } else {
-        if (mov->flags & FF_MOV_FLAG_FASTSTART)
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0)
             mov->reserved_header_pos = avio_tell(pb);
         mov_write_mdat_tag(pb, mov);
     }
@@ -7108,9 +7176,25 @@ static int mov_write_trailer(AVFormatContext *s)
             ffio_wfourcc(pb, "mdat");
             avio_wb64(pb, mov->mdat_size + 16);
         }
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size > 0) {
+            int moov_size = get_moov_size(s);
+            if (moov_size < 0)
+                return moov_size;
+            if (moov_size + 8 > mov->reserved_moov_size) {
+                /* Turn the reserved space into a free atom and move the data
+                 * after it as if nothing was reserved. */
+                av_log(s, AV_LOG_VERBOSE, "Estimated moov size %d is too small, "
+                       "needed %d\n", mov->reserved_moov_size, moov_size + 8);
+                avio_seek(pb, mov->reserved_header_pos, SEEK_SET);
+                avio_wb32(pb, mov->reserved_moov_size);
+                ffio_wfourcc(pb, "free");
+                mov->reserved_header_pos += mov->reserved_moov_size;
+                mov->reserved_moov_size   = -1;
+            }
+        }
         avio_seek(pb, mov->reserved_moov_size > 0 ? mov->reserved_header_pos : moov_pos, SEEK_SET);
 
-        if (mov->flags & FF_MOV_FLAG_FASTSTART) {
+        if (mov->flags & FF_MOV_FLAG_FASTSTART && mov->reserved_moov_size < 0) {
             av_log(s, AV_LOG_INFO, "Starting second pass: moving the moov atom to the beginning of the file\n");
             res = shift_data(s);
             if (res < 0)
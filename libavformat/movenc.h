@@ -209,6 +209,8 @@ typedef struct MOVMuxContext {
 
     int reserved_moov_size; ///< 0 for disabled, -1 for automatic, size otherwise
     int64_t reserved_header_pos;
+    int reserve_moov;
+    int64_t reserve_moov_duration;
 
     char *major_brand;
 
@@ -163,6 +163,11 @@ struct MpegTSContext {
     int resync_size;
     int merge_pmt_versions;
 
+    /** program numbers to demux, all of them if none */
+    char *programs;
+    int *sel_programs;
+    int nb_sel_programs;
+
     /******************************************/
     /* private mpegts data */
     /* scan context */
@@ -198,6 +203,8 @@ static const AVOption options[] = {
      {.i64 = 0}, 0, 1, 0 },
     {"skip_clear", "skip clearing programs", offsetof(MpegTSContext, skip_clear), AV_OPT_TYPE_BOOL,
      {.i64 = 0}, 0, 1, 0 },
+    {"programs", "only demux the programs with these numbers, separated by commas", offsetof(MpegTSContext, programs), AV_OPT_TYPE_STRING,
+     {.str = NULL}, 0, 0, AV_OPT_FLAG_DECODING_PARAM },
     { NULL },
 };
 
@@ -279,6 +286,42 @@ static struct Program * get_program(MpegTSContext *ts, unsigned int programid)
     return NULL;
 }
 
+static int program_selected(MpegTSContext *ts, int programid)
+{
+    int i;
+    if (!ts->nb_sel_programs)
+        return 1;
+    for (i = 0; i < ts->nb_sel_programs; i++)
+        if (ts->sel_programs[i] == programid)
+            return 1;
+    return 0;
+}
+
+static int parse_programs(AVFormatContext *s, MpegTSContext *ts)
+{
+    const char *p = ts->programs;
+
+    while (*p) {
+        char *end;
+        long id = strtol(p, &end, 0);
+        int ret;
+
+        if (end == p || id <= 0 || id > 0xffff || (*end && *end != ',')) {
+            av_log(s, AV_LOG_ERROR, "Invalid program list '%s'\n", ts->programs);
+            return AVERROR(EINVAL);
+        }
+        ret = av_reallocp_array(&ts->sel_programs, ts->nb_sel_programs + 1,
+                                sizeof(*ts->sel_programs));
+        if (ret < 0) {
+            ts->nb_sel_programs = 0;
+            return ret;
+        }
+        ts->sel_programs[ts->nb_sel_programs++] = id;
+        p = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
 static void clear_avprogram(MpegTSContext *ts, unsigned int programid)
 {
     AVProgram *prg = NULL;
@@ -576,22 +619,25 @@ static int analyze(const uint8_t *buf, int size, int packet_size,
 {
     int stat[TS_MAX_PACKET_SIZE];
     int stat_all = 0;
-    int i;
+    const uint8_t *p, *end = buf + size - 3;
     int best_score = 0;
 
+    if (size <= 3)
+        return 0;
+
     memset(stat, 0, packet_size * sizeof(*stat));
 
-    for (i = 0; i < size - 3; i++) {
-        if (buf[i] == 0x47) {
-            int pid = AV_RB16(buf+1) & 0x1FFF;
-            int asc = buf[i + 3] & 0x30;
-            if (!probe || pid == 0x1FFF || asc) {
-                int x = i % packet_size;
-                stat[x]++;
-                stat_all++;
-                if (stat[x] > best_score) {
-                    best_score = stat[x];
-                }
+    /* memchr() is vectorized by the C library, most bytes are skipped
+     * without being looked at one by one */
+    for (p = buf; p < end && (p = memchr(p, 0x47, end - p)); p++) {
+        int pid = AV_RB16(buf+1) & 0x1FFF;
+        int asc = p[3] & 0x30;
+        if (!probe || pid == 0x1FFF || asc) {
+            int x = (p - buf) % packet_size;
+            stat[x]++;
+            stat_all++;
+            if (stat[x] > best_score) {
+                best_score = stat[x];
             }
         }
     }
@@ -2316,6 +2362,8 @@ static void pmt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
 
     if (ts->skip_unknown_pmt && !prg)
         return;
+    if (!prg && !program_selected(ts, h->id))
+        return;
     if (prg && prg->nb_pids && prg->pids[0] != ts->current_pid)
         return;
     if (!ts->skip_clear)
@@ -2533,6 +2581,8 @@ static void pat_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
         } else {
             MpegTSFilter *fil = ts->pids[pmt_pid];
             struct Program *prg;
+            if (!program_selected(ts, sid))
+                continue;
             program = av_new_program(ts->stream, sid);
             if (program) {
                 program->program_num = sid;
@@ -2691,7 +2741,7 @@ static void sdt_cb(MpegTSFilter *filter, const uint8_t *section, int section_len
                 if (!provider_name)
                     break;
                 name = getstr8(&p, p_end);
-                if (name) {
+                if (name && program_selected(ts, sid)) {
                     AVProgram *program = av_new_program(ts->stream, sid);
                     if (program) {
                         av_dict_set(&program->metadata, "service_name", name, 0);
@@ -2857,7 +2907,7 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 {
     MpegTSContext *ts = s->priv_data;
     AVIOContext *pb = s->pb;
-    int c, i;
+    int i, len;
     uint64_t pos = avio_tell(pb);
     int64_t back = FFMIN(seekback, pos);
 
@@ -2869,25 +2919,38 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 
     avio_seek(pb, -back, SEEK_CUR);
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
-            int new_packet_size, ret;
+    for (i = 0; i < ts->resync_size; i += len) {
+        const uint8_t *sync;
+        int new_packet_size, ret;
+
+        len = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+        if (!len) {
+            /* refill the buffer */
+            avio_r8(pb);
+            if (avio_feof(pb))
+                return AVERROR_EOF;
             avio_seek(pb, -1, SEEK_CUR);
-            pos = avio_tell(pb);
-            ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
-            if (ret < 0)
-                return ret;
-            new_packet_size = get_packet_size(s);
-            if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
-                av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
-                ts->raw_packet_size = new_packet_size;
-            }
-            avio_seek(pb, pos, SEEK_SET);
-            return 0;
+            continue;
+        }
+        /* look for the sync byte in all the buffered data at once */
+        sync = memchr(pb->buf_ptr, 0x47, len);
+        if (!sync) {
+            avio_skip(pb, len);
+            continue;
         }
+        avio_skip(pb, sync - pb->buf_ptr);
+
+        pos = avio_tell(pb);
+        ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
+        if (ret < 0)
+            return ret;
+        new_packet_size = get_packet_size(s);
+        if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
+            av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
+            ts->raw_packet_size = new_packet_size;
+        }
+        avio_seek(pb, pos, SEEK_SET);
+        return 0;
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
@@ -3081,6 +3144,12 @@ static int mpegts_read_header(AVFormatContext *s)
     ts->stream     = s;
     ts->auto_guess = 0;
 
+    if (ts->programs) {
+        int ret = parse_programs(s, ts);
+        if (ret < 0)
+            return ret;
+    }
+
     if (s->iformat == &ff_mpegts_demuxer) {
         /* normal demux */
 
@@ -3092,9 +3161,10 @@ static int mpegts_read_header(AVFormatContext *s)
         mpegts_open_section_filter(ts, EIT_PID, eit_cb, ts, 1);
 
         handle_packets(ts, probesize / ts->raw_packet_size);
-        /* if could not find service, enable auto_guess */
+        /* if could not find service, enable auto_guess; with a program
+         * selection the streams of the other programs would be picked up */
 
-        ts->auto_guess = 1;
+        ts->auto_guess = !ts->nb_sel_programs;
 
         av_log(ts->stream, AV_LOG_TRACE, "tuning done\n");
 
@@ -3249,6 +3319,9 @@ static void mpegts_free(MpegTSContext *ts)
     for (i = 0; i < FF_ARRAY_ELEMS(ts->pools); i++)
         av_buffer_pool_uninit(&ts->pools[i]);
 
+    av_freep(&ts->sel_programs);
+    ts->nb_sel_programs = 0;
+
     for (i = 0; i < NB_PID_MAX; i++)
         if (ts->pids[i])
             mpegts_close_filter(ts, ts->pids[i]);
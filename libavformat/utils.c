@@ -287,9 +287,19 @@ static int append_packet_chunked(AVIOContext *s, AVPacket *pkt, int size)
                 read_size = FFMIN(read_size, SANE_CHUNK_SIZE);
         }
 
-        ret = av_grow_packet(pkt, read_size);
-        if (ret < 0)
-            break;
+        if (!pkt->buf && !prev_size) {
+            pkt->buf = ffio_alloc_packet_buffer(s, read_size);
+            if (!pkt->buf) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            pkt->data = pkt->buf->data;
+            pkt->size = read_size;
+        } else {
+            ret = av_grow_packet(pkt, read_size);
+            if (ret < 0)
+                break;
+        }
 
         ret = avio_read(s, pkt->data + prev_size, read_size);
         if (ret != read_size) {
@@ -545,6 +545,13 @@ typedef struct AVFrame {
  * A flag to mark the frames which need to be decoded, but shouldn't be output.
  */
 #define AV_FRAME_FLAG_DISCARD   (1 << 2)
+/**
+ * The frame has the same content as the previous frame of the same stream,
+ * e.g. because it was duplicated to change the frame rate. Its consumers may
+ * reuse the result of processing the previous frame instead of processing it
+ * again.
+ */
+#define AV_FRAME_FLAG_DUPLICATE (1 << 3)
 /**
  * @}
  */
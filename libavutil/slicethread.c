@@ -18,12 +18,36 @@
 
 #include <stdatomic.h>
 #include "slicethread.h"
+#include "threadpool.h"
 #include "mem.h"
 #include "thread.h"
 #include "avassert.h"
 
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
+/**
+ * Process-wide pool of worker threads.
+ *
+ * Slice thread contexts created while the pool exists do not have workers of
+ * their own. Each execution instead queues the context in pending, ordered by
+ * priority, and idle pool workers join the first queued context that still has
+ * unclaimed jobs and a free thread slot. Jobs are claimed from the per-context
+ * job counter, so whichever threads join split the work among themselves.
+ */
+typedef struct SharedPool {
+    pthread_t       *threads;
+    int             nb_threads;
+    int             refcount;       ///< protected by shared_pool_lock
+
+    pthread_mutex_t mutex;          ///< protects everything below
+    pthread_cond_t  cond;
+    AVSliceThread   *pending;
+    int             finished;
+} SharedPool;
+
+static AVMutex shared_pool_lock = AV_MUTEX_INITIALIZER;
+static SharedPool *shared_pool;
+
 typedef struct WorkerContext {
     AVSliceThread   *ctx;
     pthread_mutex_t mutex;
@@ -48,6 +72,14 @@ struct AVSliceThread {
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
+
+    /* shared pool mode, protected by pool->mutex */
+    SharedPool      *pool;
+    AVSliceThread   *next;          ///< next context in pool->pending
+    int             queued;
+    int             priority;
+    int             nb_joined;      ///< threads that took a thread number
+    int             nb_running;     ///< threads still running jobs
 };
 
 static int run_jobs(AVSliceThread *ctx)
@@ -91,15 +123,236 @@ static void *attribute_align_arg thread_worker(void *v)
     }
 }
 
+static void pool_run_jobs(AVSliceThread *ctx, int threadnr)
+{
+    unsigned nb_jobs = ctx->nb_jobs;
+    unsigned current_job;
+
+    while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs)
+        ctx->worker_func(ctx->priv, current_job, threadnr, nb_jobs, ctx->nb_active_threads);
+}
+
+static void pool_dequeue(SharedPool *pool, AVSliceThread *ctx)
+{
+    AVSliceThread **p = &pool->pending;
+
+    while (*p != ctx)
+        p = &(*p)->next;
+    *p = ctx->next;
+    ctx->next   = NULL;
+    ctx->queued = 0;
+}
+
+static AVSliceThread *pool_pick(SharedPool *pool)
+{
+    AVSliceThread *ctx = pool->pending, *next;
+
+    for (; ctx; ctx = next) {
+        next = ctx->next;
+        /* every job is taken, nothing left to join */
+        if (atomic_load_explicit(&ctx->current_job, memory_order_relaxed) >= ctx->nb_jobs)
+            pool_dequeue(pool, ctx);
+        else if (ctx->nb_joined < ctx->nb_active_threads)
+            return ctx;
+    }
+    return NULL;
+}
+
+static void *attribute_align_arg pool_worker(void *v)
+{
+    SharedPool *pool = v;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->finished) {
+        AVSliceThread *ctx = pool_pick(pool);
+        int threadnr;
+
+        if (!ctx) {
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+            continue;
+        }
+
+        threadnr = ctx->nb_joined++;
+        ctx->nb_running++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        pool_run_jobs(ctx, threadnr);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (!--ctx->nb_running)
+            pthread_cond_signal(&ctx->done_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+static void pool_execute(AVSliceThread *ctx, int execute_main)
+{
+    SharedPool *pool = ctx->pool;
+    int run_main = ctx->main_func && execute_main;
+    AVSliceThread **p;
+    int i;
+
+    atomic_store_explicit(&ctx->current_job, 0, memory_order_relaxed);
+
+    pthread_mutex_lock(&pool->mutex);
+    /* the calling thread takes the first thread number unless it is busy
+     * with main_func */
+    ctx->nb_joined  = !run_main;
+    ctx->nb_running = !run_main;
+    if (ctx->nb_joined < ctx->nb_active_threads) {
+        for (p = &pool->pending; *p && (*p)->priority >= ctx->priority; p = &(*p)->next)
+            ;
+        ctx->next   = *p;
+        ctx->queued = 1;
+        *p = ctx;
+        for (i = ctx->nb_joined; i < ctx->nb_active_threads; i++)
+            pthread_cond_signal(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (run_main)
+        ctx->main_func(ctx->priv);
+    else
+        pool_run_jobs(ctx, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    if (!run_main)
+        ctx->nb_running--;
+    while (ctx->nb_running ||
+           atomic_load_explicit(&ctx->current_job, memory_order_acquire) < ctx->nb_jobs)
+        pthread_cond_wait(&ctx->done_cond, &pool->mutex);
+    if (ctx->queued)
+        pool_dequeue(pool, ctx);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void pool_free(SharedPool *pool)
+{
+    int i;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->finished = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->nb_threads; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    av_freep(&pool->threads);
+    av_free(pool);
+}
+
+static SharedPool *pool_ref(void)
+{
+    SharedPool *pool;
+
+    ff_mutex_lock(&shared_pool_lock);
+    if ((pool = shared_pool))
+        pool->refcount++;
+    ff_mutex_unlock(&shared_pool_lock);
+    return pool;
+}
+
+static void pool_unref(SharedPool *pool)
+{
+    int last;
+
+    ff_mutex_lock(&shared_pool_lock);
+    last = !--pool->refcount;
+    ff_mutex_unlock(&shared_pool_lock);
+    if (last)
+        pool_free(pool);
+}
+
+int av_threadpool_init_shared(int nb_threads)
+{
+    SharedPool *pool;
+    int ret;
+
+    if (nb_threads < 0)
+        return AVERROR(EINVAL);
+    if (!nb_threads)
+        nb_threads = av_cpu_count();
+
+    pool = av_mallocz(sizeof(*pool));
+    if (!pool)
+        return AVERROR(ENOMEM);
+    pool->threads = av_calloc(nb_threads, sizeof(*pool->threads));
+    if (!pool->threads) {
+        av_free(pool);
+        return AVERROR(ENOMEM);
+    }
+    pool->refcount = 1;
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    for (; pool->nb_threads < nb_threads; pool->nb_threads++) {
+        if ((ret = pthread_create(&pool->threads[pool->nb_threads], NULL, pool_worker, pool))) {
+            pool_free(pool);
+            return AVERROR(ret);
+        }
+    }
+
+    ff_mutex_lock(&shared_pool_lock);
+    if (!shared_pool) {
+        shared_pool = pool;
+        pool = NULL;
+    }
+    ff_mutex_unlock(&shared_pool_lock);
+
+    if (pool) {
+        pool_free(pool);
+        return AVERROR(EEXIST);
+    }
+    return 0;
+}
+
+void av_threadpool_uninit_shared(void)
+{
+    SharedPool *pool;
+
+    ff_mutex_lock(&shared_pool_lock);
+    pool = shared_pool;
+    shared_pool = NULL;
+    ff_mutex_unlock(&shared_pool_lock);
+
+    if (pool)
+        pool_unref(pool);
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
                               int nb_threads)
 {
     AVSliceThread *ctx;
+    SharedPool *pool;
     int nb_workers, i;
 
     av_assert0(nb_threads >= 0);
+    if (nb_threads != 1 && (pool = pool_ref())) {
+        if (!nb_threads)
+            nb_threads = pool->nb_threads + 1;
+        *pctx = ctx = av_mallocz(sizeof(*ctx));
+        if (!ctx) {
+            pool_unref(pool);
+            return AVERROR(ENOMEM);
+        }
+        ctx->pool        = pool;
+        ctx->priv        = priv;
+        ctx->worker_func = worker_func;
+        ctx->main_func   = main_func;
+        ctx->nb_threads  = nb_threads;
+        atomic_init(&ctx->first_job, 0);
+        atomic_init(&ctx->current_job, 0);
+        pthread_cond_init(&ctx->done_cond, NULL);
+        return nb_threads;
+    }
+
     if (!nb_threads) {
         int nb_cpus = av_cpu_count();
         if (nb_cpus > 1)
@@ -168,6 +421,10 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
     av_assert0(nb_jobs > 0);
     ctx->nb_jobs           = nb_jobs;
     ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    if (ctx->pool) {
+        pool_execute(ctx, execute_main);
+        return;
+    }
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
     atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
     nb_workers             = ctx->nb_active_threads;
@@ -205,6 +462,13 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
         return;
 
     ctx = *pctx;
+    if (ctx->pool) {
+        pool_unref(ctx->pool);
+        pthread_cond_destroy(&ctx->done_cond);
+        av_freep(pctx);
+        return;
+    }
+
     nb_workers = ctx->nb_threads;
     if (!ctx->main_func)
         nb_workers--;
@@ -231,6 +495,11 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
     av_freep(pctx);
 }
 
+void avpriv_slicethread_set_priority(AVSliceThread *ctx, int priority)
+{
+    ctx->priority = priority;
+}
+
 #else /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
 
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
@@ -252,4 +521,18 @@ void avpriv_slicethread_free(AVSliceThread **pctx)
     av_assert0(!pctx || !*pctx);
 }
 
+void avpriv_slicethread_set_priority(AVSliceThread *ctx, int priority)
+{
+    av_assert0(0);
+}
+
+int av_threadpool_init_shared(int nb_threads)
+{
+    return AVERROR(ENOSYS);
+}
+
+void av_threadpool_uninit_shared(void)
+{
+}
+
 #endif /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
@@ -43,6 +43,15 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
  */
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main);
 
+/**
+ * Set the priority of the jobs of this context. When the context runs on the
+ * shared thread pool (see av_threadpool_init_shared()), idle pool threads
+ * serve contexts with a higher priority first. Otherwise it has no effect.
+ * @param ctx slice threading context
+ * @param priority priority, 0 by default
+ */
+void avpriv_slicethread_set_priority(AVSliceThread *ctx, int priority);
+
 /**
  * Destroy slice threading context.
  * @param pctx pointer to context
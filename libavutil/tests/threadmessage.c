@@ -0,0 +1,161 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Checks that messages go through a queue in order and that errors are
+ * reported once the queue is drained, with and without
+ * AV_THREAD_MESSAGE_QUEUE_SPSC.
+ *
+ * When given a message count, measures the throughput of one sender and one
+ * receiver in both modes instead:
+ *   threadmessage <nb_messages> [<queue_size>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadmessage.h"
+#include "libavutil/time.h"
+
+typedef struct Message {
+    unsigned seq;
+    void *payload;
+} Message;
+
+typedef struct SenderData {
+    AVThreadMessageQueue *mq;
+    unsigned nb_messages;
+} SenderData;
+
+static void *sender(void *arg)
+{
+    SenderData *sd = arg;
+    unsigned i;
+    int ret = 0;
+
+    for (i = 0; i < sd->nb_messages; i++) {
+        Message msg = { .seq = i, .payload = sd };
+
+        if ((ret = av_thread_message_queue_send(sd->mq, &msg, 0)) < 0)
+            break;
+    }
+    av_thread_message_queue_set_err_recv(sd->mq, ret < 0 ? ret : AVERROR_EOF);
+    return NULL;
+}
+
+static int run(unsigned flags, unsigned queue_size, unsigned nb_messages,
+               int64_t *elapsed)
+{
+    AVThreadMessageQueue *mq;
+    SenderData sd;
+    pthread_t thread;
+    Message msg;
+    unsigned received = 0;
+    int64_t start;
+    int ret;
+
+    ret = av_thread_message_queue_alloc2(&mq, queue_size, sizeof(msg), flags);
+    if (ret < 0)
+        return ret;
+
+    if (av_thread_message_queue_recv(mq, &msg, AV_THREAD_MESSAGE_NONBLOCK) != AVERROR(EAGAIN) ||
+        av_thread_message_queue_nb_elems(mq) != 0) {
+        fprintf(stderr, "empty queue misbehaves\n");
+        ret = AVERROR_BUG;
+        goto end;
+    }
+
+    sd.mq          = mq;
+    sd.nb_messages = nb_messages;
+    start = av_gettime_relative();
+    if ((ret = pthread_create(&thread, NULL, sender, &sd))) {
+        ret = AVERROR(ret);
+        goto end;
+    }
+    while ((ret = av_thread_message_queue_recv(mq, &msg, 0)) >= 0) {
+        if (msg.seq != received || msg.payload != &sd) {
+            fprintf(stderr, "got message %u, expected %u\n", msg.seq, received);
+            ret = AVERROR_BUG;
+            break;
+        }
+        received++;
+    }
+    if (ret != AVERROR_EOF)
+        av_thread_message_queue_set_err_send(mq, ret);
+    pthread_join(thread, NULL);
+    *elapsed = av_gettime_relative() - start;
+
+    if (ret == AVERROR_EOF && received != nb_messages) {
+        fprintf(stderr, "received %u messages out of %u\n", received, nb_messages);
+        ret = AVERROR_BUG;
+    }
+    if (ret == AVERROR_EOF)
+        ret = 0;
+
+end:
+    av_thread_message_queue_free(&mq);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        unsigned flags;
+    } modes[] = {
+        { "locked", 0                            },
+        { "spsc",   AV_THREAD_MESSAGE_QUEUE_SPSC },
+    };
+    unsigned nb_messages = argc > 1 ? strtoul(argv[1], NULL, 0) : 0;
+    unsigned queue_size  = argc > 2 ? strtoul(argv[2], NULL, 0) : 8;
+    int64_t elapsed;
+    int i, ret;
+
+    if (!nb_messages) {
+        static const unsigned sizes[] = { 1, 3, 8 };
+        int j;
+
+        for (i = 0; i < FF_ARRAY_ELEMS(modes); i++) {
+            for (j = 0; j < FF_ARRAY_ELEMS(sizes); j++) {
+                ret = run(modes[i].flags, sizes[j], 10000, &elapsed);
+                if (ret < 0) {
+                    fprintf(stderr, "%s queue of size %u failed: %s\n",
+                            modes[i].name, sizes[j], av_err2str(ret));
+                    return 1;
+                }
+            }
+        }
+        return 0;
+    }
+
+    for (i = 0; i < FF_ARRAY_ELEMS(modes); i++) {
+        ret = run(modes[i].flags, queue_size, nb_messages, &elapsed);
+        if (ret < 0) {
+            fprintf(stderr, "%s: %s\n", modes[i].name, av_err2str(ret));
+            return 1;
+        }
+        printf("%-6s queue_size:%u messages:%u time:%"PRId64"us rate:%.0f msg/s\n",
+               modes[i].name, queue_size, nb_messages, elapsed,
+               nb_messages * 1000000.0 / FFMAX(elapsed, 1));
+    }
+    return 0;
+}
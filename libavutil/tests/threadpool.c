@@ -0,0 +1,116 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Runs slice jobs of several contexts from several threads on the shared
+ * thread pool and checks that every job runs exactly once and that the
+ * thread numbers handed to concurrently running jobs are distinct.
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+#include "libavutil/common.h"
+#include "libavutil/error.h"
+#include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
+#include "libavutil/threadpool.h"
+
+#define NB_CONTEXTS   3
+#define NB_THREADS    3
+#define NB_JOBS      17
+#define NB_EXECUTES 200
+
+typedef struct Context {
+    AVSliceThread *thread;
+    pthread_t tid;
+    int nb_threads;
+    atomic_int runs[NB_JOBS];
+    atomic_int busy[NB_THREADS + 1];
+    atomic_int errors;
+} Context;
+
+static void worker(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    Context *c = priv;
+
+    if (threadnr < 0 || threadnr >= c->nb_threads || nb_jobs != NB_JOBS ||
+        atomic_fetch_add(&c->busy[threadnr], 1)) {
+        atomic_fetch_add(&c->errors, 1);
+        return;
+    }
+    atomic_fetch_add(&c->runs[jobnr], 1);
+    atomic_fetch_sub(&c->busy[threadnr], 1);
+}
+
+static void *submit(void *arg)
+{
+    Context *c = arg;
+    int i;
+
+    for (i = 0; i < NB_EXECUTES; i++)
+        avpriv_slicethread_execute(c->thread, NB_JOBS, 0);
+    return NULL;
+}
+
+int main(void)
+{
+    Context ctx[NB_CONTEXTS] = { 0 };
+    int i, j, ret;
+
+    if ((ret = av_threadpool_init_shared(2)) < 0) {
+        fprintf(stderr, "pool creation failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    if (av_threadpool_init_shared(2) != AVERROR(EEXIST))
+        return 1;
+
+    for (i = 0; i < NB_CONTEXTS; i++) {
+        ret = avpriv_slicethread_create(&ctx[i].thread, &ctx[i], worker, NULL, NB_THREADS);
+        if (ret != NB_THREADS)
+            return 1;
+        ctx[i].nb_threads = ret;
+        avpriv_slicethread_set_priority(ctx[i].thread, i);
+    }
+    /* the pool stays alive until its last user is gone */
+    av_threadpool_uninit_shared();
+
+    for (i = 0; i < NB_CONTEXTS; i++)
+        if (pthread_create(&ctx[i].tid, NULL, submit, &ctx[i]))
+            return 1;
+    for (i = 0; i < NB_CONTEXTS; i++)
+        pthread_join(ctx[i].tid, NULL);
+
+    ret = 0;
+    for (i = 0; i < NB_CONTEXTS; i++) {
+        for (j = 0; j < NB_JOBS; j++) {
+            if (atomic_load(&ctx[i].runs[j]) != NB_EXECUTES) {
+                fprintf(stderr, "context %d job %d ran %d times\n",
+                        i, j, atomic_load(&ctx[i].runs[j]));
+                ret = 1;
+            }
+        }
+        if (atomic_load(&ctx[i].errors)) {
+            fprintf(stderr, "context %d: %d bad job calls\n", i, atomic_load(&ctx[i].errors));
+            ret = 1;
+        }
+        avpriv_slicethread_free(&ctx[i].thread);
+    }
+
+    return ret;
+}
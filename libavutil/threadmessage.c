@@ -18,20 +18,39 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+#include <string.h>
+
+#include "common.h"
+#include "cpu.h"
 #include "fifo.h"
 #include "threadmessage.h"
 #include "thread.h"
 
+/* number of polls of the ring before a SPSC thread goes to sleep */
+#define SPSC_SPIN_COUNT 1024
+
 struct AVThreadMessageQueue {
 #if HAVE_THREADS
     AVFifoBuffer *fifo;
     pthread_mutex_t lock;
     pthread_cond_t cond_recv;
     pthread_cond_t cond_send;
-    int err_send;
-    int err_recv;
+    atomic_int err_send;
+    atomic_int err_recv;
     unsigned elsize;
     void (*free_func)(void *msg);
+
+    /* AV_THREAD_MESSAGE_QUEUE_SPSC: lock-free ring used instead of fifo */
+    int spsc;
+    uint8_t *ring;
+    unsigned nelem;
+    unsigned mask;
+    int spin_count;
+    atomic_uint head;   /* read position, only advanced by the receiver */
+    atomic_uint tail;   /* write position, only advanced by the sender */
+    atomic_int recv_waiting;
+    atomic_int send_waiting;
 #else
     int dummy;
 #endif
@@ -40,13 +59,31 @@ struct AVThreadMessageQueue {
 int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize)
+{
+    return av_thread_message_queue_alloc2(mq, nelem, elsize, 0);
+}
+
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags)
 {
 #if HAVE_THREADS
     AVThreadMessageQueue *rmq;
+    unsigned nb_slots = 0;
     int ret = 0;
 
     if (nelem > INT_MAX / elsize)
         return AVERROR(EINVAL);
+    if (flags & AV_THREAD_MESSAGE_QUEUE_SPSC) {
+        if (!nelem || nelem > (1U << 30))
+            return AVERROR(EINVAL);
+        /* a power of two number of slots keeps the positions valid across
+         * unsigned wraparound */
+        nb_slots = 1U << av_ceil_log2(nelem);
+        if (nb_slots > INT_MAX / elsize)
+            return AVERROR(EINVAL);
+    }
     if (!(rmq = av_mallocz(sizeof(*rmq))))
         return AVERROR(ENOMEM);
     if ((ret = pthread_mutex_init(&rmq->lock, NULL))) {
@@ -64,13 +101,28 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
         av_free(rmq);
         return AVERROR(ret);
     }
-    if (!(rmq->fifo = av_fifo_alloc(elsize * nelem))) {
+    if (nb_slots)
+        rmq->ring = av_malloc_array(nb_slots, elsize);
+    else
+        rmq->fifo = av_fifo_alloc(elsize * nelem);
+    if (!rmq->ring && !rmq->fifo) {
         pthread_cond_destroy(&rmq->cond_send);
         pthread_cond_destroy(&rmq->cond_recv);
         pthread_mutex_destroy(&rmq->lock);
         av_free(rmq);
         return AVERROR(ENOMEM);
     }
+    atomic_init(&rmq->err_send, 0);
+    atomic_init(&rmq->err_recv, 0);
+    atomic_init(&rmq->head, 0);
+    atomic_init(&rmq->tail, 0);
+    atomic_init(&rmq->recv_waiting, 0);
+    atomic_init(&rmq->send_waiting, 0);
+    /* polling only helps when the other side runs on another core */
+    rmq->spin_count = av_cpu_count() > 1 ? SPSC_SPIN_COUNT : 0;
+    rmq->spsc   = !!nb_slots;
+    rmq->nelem  = nelem;
+    rmq->mask   = nb_slots - 1;
     rmq->elsize = elsize;
     *mq = rmq;
     return 0;
@@ -94,6 +146,7 @@ void av_thread_message_queue_free(AVThreadMessageQueue **mq)
     if (*mq) {
         av_thread_message_flush(*mq);
         av_fifo_freep(&(*mq)->fifo);
+        av_freep(&(*mq)->ring);
         pthread_cond_destroy(&(*mq)->cond_send);
         pthread_cond_destroy(&(*mq)->cond_recv);
         pthread_mutex_destroy(&(*mq)->lock);
@@ -106,6 +159,8 @@ int av_thread_message_queue_nb_elems(AVThreadMessageQueue *mq)
 {
 #if HAVE_THREADS
     int ret;
+    if (mq->spsc)
+        return atomic_load(&mq->tail) - atomic_load(&mq->head);
     pthread_mutex_lock(&mq->lock);
     ret = av_fifo_size(mq->fifo);
     pthread_mutex_unlock(&mq->lock);
@@ -121,13 +176,16 @@ static int av_thread_message_queue_send_locked(AVThreadMessageQueue *mq,
                                                void *msg,
                                                unsigned flags)
 {
-    while (!mq->err_send && av_fifo_space(mq->fifo) < mq->elsize) {
+    int err;
+
+    while (!(err = atomic_load(&mq->err_send)) &&
+           av_fifo_space(mq->fifo) < mq->elsize) {
         if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
             return AVERROR(EAGAIN);
         pthread_cond_wait(&mq->cond_send, &mq->lock);
     }
-    if (mq->err_send)
-        return mq->err_send;
+    if (err)
+        return err;
     av_fifo_generic_write(mq->fifo, msg, mq->elsize, NULL);
     /* one message is sent, signal one receiver */
     pthread_cond_signal(&mq->cond_recv);
@@ -138,19 +196,120 @@ static int av_thread_message_queue_recv_locked(AVThreadMessageQueue *mq,
                                                void *msg,
                                                unsigned flags)
 {
-    while (!mq->err_recv && av_fifo_size(mq->fifo) < mq->elsize) {
+    int err;
+
+    while (!(err = atomic_load(&mq->err_recv)) &&
+           av_fifo_size(mq->fifo) < mq->elsize) {
         if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
             return AVERROR(EAGAIN);
         pthread_cond_wait(&mq->cond_recv, &mq->lock);
     }
     if (av_fifo_size(mq->fifo) < mq->elsize)
-        return mq->err_recv;
+        return err;
     av_fifo_generic_read(mq->fifo, msg, mq->elsize, NULL);
     /* one message space appeared, signal one sender */
     pthread_cond_signal(&mq->cond_send);
     return 0;
 }
 
+/*
+ * In SPSC mode the sender only writes tail and the receiver only writes head,
+ * so a message is handed over with a single release store. A thread that finds
+ * the ring full (resp. empty) polls it for a while and then sleeps on the
+ * condition variable after announcing itself in send_waiting (resp.
+ * recv_waiting). The announcement and the position updates are sequentially
+ * consistent, so either the waiter sees the new position or the other side
+ * sees the flag and takes the lock to signal it.
+ */
+
+static int spsc_is_full(AVThreadMessageQueue *mq, unsigned tail)
+{
+    return tail - atomic_load(&mq->head) >= mq->nelem;
+}
+
+static int spsc_is_empty(AVThreadMessageQueue *mq, unsigned head)
+{
+    return atomic_load(&mq->tail) == head;
+}
+
+static int av_thread_message_queue_send_spsc(AVThreadMessageQueue *mq,
+                                             void *msg,
+                                             unsigned flags)
+{
+    unsigned tail = atomic_load_explicit(&mq->tail, memory_order_relaxed);
+    int err, spin;
+
+    if ((err = atomic_load(&mq->err_send)))
+        return err;
+    if (spsc_is_full(mq, tail)) {
+        if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+            return AVERROR(EAGAIN);
+        for (spin = 0; spin < mq->spin_count && spsc_is_full(mq, tail); spin++)
+            ;
+        if (spsc_is_full(mq, tail)) {
+            pthread_mutex_lock(&mq->lock);
+            atomic_store(&mq->send_waiting, 1);
+            while (!(err = atomic_load(&mq->err_send)) && spsc_is_full(mq, tail))
+                pthread_cond_wait(&mq->cond_send, &mq->lock);
+            atomic_store(&mq->send_waiting, 0);
+            pthread_mutex_unlock(&mq->lock);
+            if (err)
+                return err;
+        }
+    }
+
+    memcpy(mq->ring + (size_t)(tail & mq->mask) * mq->elsize, msg, mq->elsize);
+    atomic_store(&mq->tail, tail + 1);
+
+    if (atomic_load(&mq->recv_waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(&mq->cond_recv);
+        pthread_mutex_unlock(&mq->lock);
+    }
+    return 0;
+}
+
+static int av_thread_message_queue_recv_spsc(AVThreadMessageQueue *mq,
+                                             void *msg,
+                                             unsigned flags)
+{
+    unsigned head = atomic_load_explicit(&mq->head, memory_order_relaxed);
+    int err, spin;
+
+    if (spsc_is_empty(mq, head)) {
+        if (!(flags & AV_THREAD_MESSAGE_NONBLOCK))
+            for (spin = 0; spin < mq->spin_count && spsc_is_empty(mq, head); spin++)
+                ;
+        /* the sender sets err_recv after its last message, so the ring has to
+         * be checked again once the error is seen */
+        err = atomic_load(&mq->err_recv);
+        if (spsc_is_empty(mq, head)) {
+            if (err)
+                return err;
+            if ((flags & AV_THREAD_MESSAGE_NONBLOCK))
+                return AVERROR(EAGAIN);
+            pthread_mutex_lock(&mq->lock);
+            atomic_store(&mq->recv_waiting, 1);
+            while (!(err = atomic_load(&mq->err_recv)) && spsc_is_empty(mq, head))
+                pthread_cond_wait(&mq->cond_recv, &mq->lock);
+            atomic_store(&mq->recv_waiting, 0);
+            pthread_mutex_unlock(&mq->lock);
+            if (spsc_is_empty(mq, head))
+                return err;
+        }
+    }
+
+    memcpy(msg, mq->ring + (size_t)(head & mq->mask) * mq->elsize, mq->elsize);
+    atomic_store(&mq->head, head + 1);
+
+    if (atomic_load(&mq->send_waiting)) {
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_signal(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+    }
+    return 0;
+}
+
 #endif /* HAVE_THREADS */
 
 int av_thread_message_queue_send(AVThreadMessageQueue *mq,
@@ -160,6 +319,8 @@ int av_thread_message_queue_send(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return av_thread_message_queue_send_spsc(mq, msg, flags);
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_send_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -176,6 +337,8 @@ int av_thread_message_queue_recv(AVThreadMessageQueue *mq,
 #if HAVE_THREADS
     int ret;
 
+    if (mq->spsc)
+        return av_thread_message_queue_recv_spsc(mq, msg, flags);
     pthread_mutex_lock(&mq->lock);
     ret = av_thread_message_queue_recv_locked(mq, msg, flags);
     pthread_mutex_unlock(&mq->lock);
@@ -190,7 +353,7 @@ void av_thread_message_queue_set_err_send(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_send = err;
+    atomic_store(&mq->err_send, err);
     pthread_cond_broadcast(&mq->cond_send);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
@@ -201,7 +364,7 @@ void av_thread_message_queue_set_err_recv(AVThreadMessageQueue *mq,
 {
 #if HAVE_THREADS
     pthread_mutex_lock(&mq->lock);
-    mq->err_recv = err;
+    atomic_store(&mq->err_recv, err);
     pthread_cond_broadcast(&mq->cond_recv);
     pthread_mutex_unlock(&mq->lock);
 #endif /* HAVE_THREADS */
@@ -221,6 +384,20 @@ void av_thread_message_flush(AVThreadMessageQueue *mq)
     int used, off;
     void *free_func = mq->free_func;
 
+    if (mq->spsc) {
+        unsigned head = atomic_load(&mq->head);
+        unsigned tail = atomic_load(&mq->tail);
+
+        if (free_func)
+            for (; head != tail; head++)
+                mq->free_func(mq->ring + (size_t)(head & mq->mask) * mq->elsize);
+        atomic_store(&mq->head, tail);
+        pthread_mutex_lock(&mq->lock);
+        pthread_cond_broadcast(&mq->cond_send);
+        pthread_mutex_unlock(&mq->lock);
+        return;
+    }
+
     pthread_mutex_lock(&mq->lock);
     used = av_fifo_size(mq->fifo);
     if (free_func)
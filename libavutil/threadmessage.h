@@ -32,6 +32,20 @@ typedef enum AVThreadMessageFlags {
 
 } AVThreadMessageFlags;
 
+typedef enum AVThreadMessageQueueFlags {
+
+    /**
+     * The queue has exactly one sending and one receiving thread.
+     * Messages are then passed through a lock-free ring buffer; a thread that
+     * has to wait polls the ring briefly before sleeping, and the mutex is only
+     * taken to put a thread to sleep or wake it up.
+     * av_thread_message_flush() must only be called from the receiving thread
+     * in this mode.
+     */
+    AV_THREAD_MESSAGE_QUEUE_SPSC = 1,
+
+} AVThreadMessageQueueFlags;
+
 /**
  * Allocate a new message queue.
  *
@@ -45,6 +59,21 @@ int av_thread_message_queue_alloc(AVThreadMessageQueue **mq,
                                   unsigned nelem,
                                   unsigned elsize);
 
+/**
+ * Allocate a new message queue with additional flags.
+ *
+ * @param mq      pointer to the message queue
+ * @param nelem   maximum number of elements in the queue
+ * @param elsize  size of each element in the queue
+ * @param flags   a combination of AVThreadMessageQueueFlags
+ * @return  >=0 for success; <0 for error, in particular AVERROR(ENOSYS) if
+ *          lavu was built without thread support
+ */
+int av_thread_message_queue_alloc2(AVThreadMessageQueue **mq,
+                                   unsigned nelem,
+                                   unsigned elsize,
+                                   unsigned flags);
+
 /**
  * Free a message queue.
  *
@@ -0,0 +1,48 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVUTIL_THREADPOOL_H
+#define AVUTIL_THREADPOOL_H
+
+/**
+ * Create a process-wide pool of worker threads for slice threading.
+ *
+ * Codec and filter graph contexts created after this call do not start
+ * slice threads of their own; their slice jobs run on the pool threads and on
+ * the thread that submits them. This bounds the number of threads running
+ * slice jobs in the process regardless of how many contexts are open.
+ * Contexts created before this call keep their own threads.
+ *
+ * Frame threading in libavcodec is not affected.
+ *
+ * @param nb_threads number of worker threads, 0 to use av_cpu_count()
+ * @return 0 on success, AVERROR(EEXIST) if the pool already exists,
+ *         AVERROR(ENOSYS) if lavu was built without thread support,
+ *         another negative AVERROR code on failure
+ */
+int av_threadpool_init_shared(int nb_threads);
+
+/**
+ * Release the process-wide slice thread pool.
+ *
+ * Contexts created afterwards use their own threads again. The pool threads
+ * exit once the last context using the pool is freed.
+ */
+void av_threadpool_uninit_shared(void);
+
+#endif /* AVUTIL_THREADPOOL_H */
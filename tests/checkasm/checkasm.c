@@ -169,12 +169,16 @@ static const struct {
     #if CONFIG_AFIR_FILTER
         { "af_afir", checkasm_check_afir },
     #endif
+        { "drawutils", checkasm_check_drawutils },
     #if CONFIG_BLEND_FILTER
         { "vf_blend", checkasm_check_blend },
     #endif
     #if CONFIG_COLORSPACE_FILTER
         { "vf_colorspace", checkasm_check_colorspace },
     #endif
+    #if CONFIG_DESHAKE_FILTER
+        { "vf_deshake", checkasm_check_vf_deshake },
+    #endif
     #if CONFIG_EQ_FILTER
         { "vf_eq", checkasm_check_vf_eq },
     #endif
@@ -184,12 +188,27 @@ static const struct {
     #if CONFIG_HFLIP_FILTER
         { "vf_hflip", checkasm_check_vf_hflip },
     #endif
+    #if CONFIG_LUT3D_FILTER
+        { "vf_lut3d", checkasm_check_vf_lut3d },
+    #endif
     #if CONFIG_NLMEANS_FILTER
         { "vf_nlmeans", checkasm_check_nlmeans },
     #endif
+    #if CONFIG_OVERLAY_FILTER
+        { "vf_overlay", checkasm_check_vf_overlay },
+    #endif
+    #if CONFIG_PALETTEUSE_FILTER
+        { "vf_paletteuse", checkasm_check_vf_paletteuse },
+    #endif
     #if CONFIG_THRESHOLD_FILTER
         { "vf_threshold", checkasm_check_vf_threshold },
     #endif
+    #if CONFIG_THUMBNAIL_FILTER
+        { "vf_thumbnail", checkasm_check_vf_thumbnail },
+    #endif
+    #if CONFIG_XFADE_FILTER
+        { "vf_xfade", checkasm_check_vf_xfade },
+    #endif
 #endif
 #if CONFIG_SWSCALE
     { "sw_rgb", checkasm_check_sw_rgb },
@@ -47,6 +47,7 @@ void checkasm_check_blend(void);
 void checkasm_check_blockdsp(void);
 void checkasm_check_bswapdsp(void);
 void checkasm_check_colorspace(void);
+void checkasm_check_drawutils(void);
 void checkasm_check_exrdsp(void);
 void checkasm_check_fixed_dsp(void);
 void checkasm_check_flacdsp(void);
@@ -83,10 +84,16 @@ void checkasm_check_sw_scale(void);
 void checkasm_check_utvideodsp(void);
 void checkasm_check_v210dec(void);
 void checkasm_check_v210enc(void);
+void checkasm_check_vf_deshake(void);
 void checkasm_check_vf_eq(void);
 void checkasm_check_vf_gblur(void);
 void checkasm_check_vf_hflip(void);
+void checkasm_check_vf_lut3d(void);
+void checkasm_check_vf_overlay(void);
+void checkasm_check_vf_paletteuse(void);
 void checkasm_check_vf_threshold(void);
+void checkasm_check_vf_thumbnail(void);
+void checkasm_check_vf_xfade(void);
 void checkasm_check_vp8dsp(void);
 void checkasm_check_vp9dsp(void);
 void checkasm_check_videodsp(void);
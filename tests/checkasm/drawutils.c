@@ -0,0 +1,101 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/drawutils.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 256
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        int j;                            \
+        for (j = 0; j < size; j++)        \
+            buf[j] = rnd() & 0xFF;        \
+    } while (0)
+
+static void check_blend_row(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, mask,    [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH]);
+    FFDrawContext draw;
+    unsigned src, alpha;
+    int w;
+
+    declare_func(void, uint8_t *dst, const uint8_t *mask, int w,
+                 unsigned src, unsigned alpha);
+
+    if (ff_draw_init(&draw, AV_PIX_FMT_GRAY8, 0) < 0)
+        return;
+
+    if (check_func(draw.blend_row, "blend_row")) {
+        for (w = 1; w <= WIDTH; w++) {
+            randomize_buffers(mask, WIDTH);
+            randomize_buffers(dst_ref, WIDTH);
+            memcpy(dst_new, dst_ref, WIDTH);
+            src   = rnd() & 0xFF;
+            alpha = (0x10307 * (rnd() & 0xFF) + 0x3) >> 8;
+            call_ref(dst_ref, mask, w, src, alpha);
+            call_new(dst_new, mask, w, src, alpha);
+            if (memcmp(dst_ref, dst_new, WIDTH))
+                fail();
+        }
+        bench_new(dst_new, mask, WIDTH, src, alpha);
+    }
+}
+
+static void check_blend_layer_row(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, val,     [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, trans,   [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH]);
+    FFDrawContext draw;
+    int w;
+
+    declare_func(void, uint8_t *dst, const uint8_t *val,
+                 const uint8_t *trans, int w);
+
+    if (ff_draw_init(&draw, AV_PIX_FMT_GRAY8, 0) < 0)
+        return;
+
+    if (check_func(draw.blend_layer_row, "blend_layer_row")) {
+        for (w = 1; w <= WIDTH; w++) {
+            randomize_buffers(val, WIDTH);
+            randomize_buffers(trans, WIDTH);
+            randomize_buffers(dst_ref, WIDTH);
+            memcpy(dst_new, dst_ref, WIDTH);
+            call_ref(dst_ref, val, trans, w);
+            call_new(dst_new, val, trans, w);
+            if (memcmp(dst_ref, dst_new, WIDTH))
+                fail();
+        }
+        bench_new(dst_new, val, trans, WIDTH);
+    }
+}
+
+void checkasm_check_drawutils(void)
+{
+    check_blend_row();
+    report("blend_row");
+
+    check_blend_layer_row();
+    report("blend_layer_row");
+}
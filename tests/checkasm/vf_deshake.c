@@ -0,0 +1,61 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "checkasm.h"
+#include "libavfilter/deshake.h"
+#include "libavutil/mem_internal.h"
+
+#define STRIDE 48
+#define MAX_H  (2 * MAX_R + 1)
+
+static void check_block_minmax(DeshakeDSPContext *dsp)
+{
+    LOCAL_ALIGNED_16(uint8_t, src, [(MAX_H + 1) * STRIDE]);
+    uint8_t lo_ref, hi_ref, lo_new, hi_new;
+    int h, i;
+
+    declare_func(void, const uint8_t *src, ptrdiff_t stride, int h,
+                 uint8_t *lowest, uint8_t *highest);
+
+    if (check_func(dsp->block_minmax, "block_minmax")) {
+        for (h = 1; h <= MAX_H; h += 8) {
+            /* narrow range, so that the extremes are not always 0 and 255 */
+            const int base = rnd() & 0x7f;
+            for (i = 0; i < (MAX_H + 1) * STRIDE; i++)
+                src[i] = base + (rnd() & 0x7f);
+            /* unaligned source, with the extremes around the block */
+            src[0] = 0;
+            src[h * STRIDE + 1] = 255;
+
+            call_ref(src + 1, STRIDE, h, &lo_ref, &hi_ref);
+            call_new(src + 1, STRIDE, h, &lo_new, &hi_new);
+            if (lo_ref != lo_new || hi_ref != hi_new)
+                fail();
+        }
+        bench_new(src + 1, STRIDE, 17, &lo_new, &hi_new);
+    }
+}
+
+void checkasm_check_vf_deshake(void)
+{
+    DeshakeDSPContext dsp;
+
+    ff_deshake_dsp_init(&dsp);
+    check_block_minmax(&dsp);
+    report("block_minmax");
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <float.h>
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/lut3d.h"
+#include "libavutil/mem_internal.h"
+
+#define LUTSIZE 17
+#define WIDTH 256
+#define WIDTH_PADDED (WIDTH + 16)
+
+/* The SIMD versions use fused multiply-adds and may sum the vertices in
+ * another order than the C code: allow a few ULP of the [0, 1] output. */
+#define EPS (FLT_EPSILON * 16)
+
+static void randomize_coords(float *coord)
+{
+    int i;
+
+    for (i = 0; i < WIDTH; i++) {
+        switch (rnd() & 7) {
+        /* the lower and upper edges, and points on a lattice plane */
+        case 0:  coord[i] = 0;                      break;
+        case 1:  coord[i] = LUTSIZE - 1;            break;
+        case 2:  coord[i] = rnd() % LUTSIZE;        break;
+        default: coord[i] = (rnd() & 0xFFFFFF) * ((LUTSIZE - 1) / (float)(1 << 24));
+        }
+    }
+    /* the padding is read by the SIMD versions and must be in range */
+    for (; i < WIDTH_PADDED; i++)
+        coord[i] = 0;
+}
+
+static void check_interp(const char *name, int tetrahedral)
+{
+    LOCAL_ALIGNED_32(float, lut, [LUTSIZE * LUTSIZE * LUTSIZE * 3]);
+    LOCAL_ALIGNED_32(float, src,     [3 * WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(float, dst_ref, [3 * WIDTH_PADDED]);
+    LOCAL_ALIGNED_32(float, dst_new, [3 * WIDTH_PADDED]);
+    float *const srcp[3]     = { src,     src     + WIDTH_PADDED, src     + 2 * WIDTH_PADDED };
+    float *const dst_refp[3] = { dst_ref, dst_ref + WIDTH_PADDED, dst_ref + 2 * WIDTH_PADDED };
+    float *const dst_newp[3] = { dst_new, dst_new + WIDTH_PADDED, dst_new + 2 * WIDTH_PADDED };
+    /* not a multiple of the SIMD width */
+    const int w = WIDTH - (rnd() & 15);
+    LUT3DDSPContext dsp;
+    int i;
+
+    declare_func(void, float *const dst[3], const float *const src[3],
+                 const float *lut, int lutsize, int width);
+
+    ff_lut3d_dsp_init(&dsp);
+    for (i = 0; i < LUTSIZE * LUTSIZE * LUTSIZE * 3; i++)
+        lut[i] = (rnd() & 0xFFFFFF) / (float)(1 << 24);
+    for (i = 0; i < 3; i++)
+        randomize_coords(srcp[i]);
+    /* ties between the fractional parts */
+    for (i = 0; i < WIDTH; i += 7)
+        srcp[1][i] = srcp[0][i];
+    memset(dst_ref, 0, 3 * WIDTH_PADDED * sizeof(*dst_ref));
+    memset(dst_new, 0, 3 * WIDTH_PADDED * sizeof(*dst_new));
+
+    if (check_func(tetrahedral ? dsp.interp_tetrahedral : dsp.interp_trilinear, "%s", name)) {
+        call_ref(dst_refp, (const float *const *)srcp, lut, LUTSIZE, w);
+        call_new(dst_newp, (const float *const *)srcp, lut, LUTSIZE, w);
+        for (i = 0; i < 3; i++)
+            if (!float_near_abs_eps_array(dst_refp[i], dst_newp[i], EPS, w))
+                fail();
+        bench_new(dst_newp, (const float *const *)srcp, lut, LUTSIZE, WIDTH);
+    }
+}
+
+void checkasm_check_vf_lut3d(void)
+{
+    check_interp("interp_trilinear", 0);
+    report("interp_trilinear");
+
+    check_interp("interp_tetrahedral", 1);
+    report("interp_tetrahedral");
+}
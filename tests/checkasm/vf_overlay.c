@@ -0,0 +1,69 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavfilter/vf_overlay.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 256
+
+static void check_blend_layer_row(OverlayContext *s)
+{
+    LOCAL_ALIGNED_32(uint8_t,  src,     [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t,  dst_ref, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t,  dst_new, [WIDTH]);
+    LOCAL_ALIGNED_32(uint16_t, val,     [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t,  trans,   [WIDTH]);
+    int i, w, c;
+
+    declare_func(int, uint8_t *d, const uint16_t *val, const uint8_t *trans, int w);
+
+    if (check_func(s->blend_layer_row, "blend_layer_row")) {
+        for (i = 0; i < WIDTH; i++) {
+            const int alpha = rnd() & 0xff;
+
+            src[i]   = rnd() & 0xff;
+            /* as stored by the filter for an overlay value and its alpha */
+            val[i]   = (rnd() & 0xff) * alpha + 128;
+            trans[i] = 255 - alpha;
+        }
+
+        for (w = 1; w <= WIDTH; w += 17) {
+            memcpy(dst_ref, src, WIDTH);
+            memcpy(dst_new, src, WIDTH);
+            call_ref(dst_ref, val, trans, w);
+            c = call_new(dst_new, val, trans, w);
+            /* the bytes that are not processed must be left untouched */
+            if (c < 0 || c > w ||
+                memcmp(dst_ref, dst_new, c) || memcmp(src + c, dst_new + c, WIDTH - c))
+                fail();
+        }
+        bench_new(dst_new, val, trans, WIDTH);
+    }
+}
+
+void checkasm_check_vf_overlay(void)
+{
+    OverlayContext s = { 0 };
+
+    ff_overlay_layer_init(&s);
+    check_blend_layer_row(&s);
+    report("blend_layer_row");
+}
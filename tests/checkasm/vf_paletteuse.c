@@ -0,0 +1,59 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "checkasm.h"
+#include "libavfilter/paletteuse.h"
+#include "libavutil/mem_internal.h"
+
+static void check_nearest(PaletteUseDSPContext *dsp)
+{
+    LOCAL_ALIGNED_32(int32_t, pal, [3 * AVPALETTE_COUNT]);
+    int nb, i, j;
+
+    declare_func(int, const int32_t *pal, int nb, int r, int g, int b);
+
+    if (check_func(dsp->nearest, "nearest")) {
+        for (nb = 16; nb <= AVPALETTE_COUNT; nb += 16) {
+            /* few distinct colors, so that there are ties */
+            const int nb_colors = 1 + rnd() % nb;
+            for (i = 0; i < AVPALETTE_COUNT; i++) {
+                const int pad = i >= nb_colors;
+                pal[i                      ] = pad ? PALETTEUSE_PAD_COLOR : rnd() & 0xf0;
+                pal[i +     AVPALETTE_COUNT] = pad ? PALETTEUSE_PAD_COLOR : rnd() & 0xf0;
+                pal[i + 2 * AVPALETTE_COUNT] = pad ? PALETTEUSE_PAD_COLOR : rnd() & 0xf0;
+            }
+            for (j = 0; j < 64; j++) {
+                const int r = rnd() & 0xff, g = rnd() & 0xff, b = rnd() & 0xff;
+                const int ref = call_ref(pal, nb, r, g, b);
+                const int new = call_new(pal, nb, r, g, b);
+                if (ref != new)
+                    fail();
+            }
+        }
+        bench_new(pal, AVPALETTE_COUNT, 0x80, 0x80, 0x80);
+    }
+}
+
+void checkasm_check_vf_paletteuse(void)
+{
+    PaletteUseDSPContext dsp;
+
+    ff_paletteuse_dsp_init(&dsp);
+    check_nearest(&dsp);
+    report("nearest");
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "checkasm.h"
+#include "libavfilter/thumbnail.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 256
+
+static void check_histogram_row(const ThumbnailDSPContext *dsp)
+{
+    LOCAL_ALIGNED_32(uint8_t, src, [WIDTH]);
+    int hist_ref[4 * 256], hist_new[4 * 256];
+    int i, len, c;
+
+    declare_func(int, int *hist, const uint8_t *src, int len);
+
+    if (check_func(dsp->histogram_row, "histogram_row")) {
+        /* runs of equal bytes as well as random ones */
+        for (i = 0; i < WIDTH; i++)
+            src[i] = i < WIDTH / 2 ? rnd() : (i / 24) * 3;
+
+        for (len = 1; len <= WIDTH; len += 17) {
+            for (i = 0; i < 4 * 256; i++)
+                hist_ref[i] = hist_new[i] = rnd() & 0xffff;
+            c = call_new(hist_new, src, len);
+            if (c < 0 || c > len || c & 3) {
+                fail();
+                continue;
+            }
+            /* only the c first bytes must have been counted */
+            call_ref(hist_ref, src, c);
+            if (memcmp(hist_ref, hist_new, sizeof(hist_ref)))
+                fail();
+        }
+        bench_new(hist_new, src, WIDTH);
+    }
+}
+
+void checkasm_check_vf_thumbnail(void)
+{
+    ThumbnailDSPContext dsp;
+
+    ff_thumbnail_dsp_init(&dsp);
+    check_histogram_row(&dsp);
+    report("histogram_row");
+}
@@ -0,0 +1,111 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/xfade.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 256
+#define WIDTH_PADDED (WIDTH + 16)
+#define BUF_SIZE (WIDTH_PADDED * 2)
+
+static void randomize_buffer(uint8_t *buf, int depth)
+{
+    if (depth == 8) {
+        for (int i = 0; i < BUF_SIZE; i++)
+            buf[i] = rnd();
+    } else {
+        for (int i = 0; i < BUF_SIZE; i += 2)
+            AV_WN16A(buf + i, rnd() & ((1 << depth) - 1));
+    }
+}
+
+static void check_fade(int depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, a,       [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, b,       [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [BUF_SIZE]);
+    const int bpp = 1 + (depth > 8);
+    /* not a multiple of the SIMD width */
+    const int w = WIDTH - (rnd() & 15);
+    const float progress = (rnd() & 0xFFFF) / 65535.f;
+    XFadeDSPContext dsp;
+
+    declare_func(void, uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                 ptrdiff_t width, float progress);
+
+    ff_xfade_init(&dsp, depth);
+    randomize_buffer(a, depth);
+    randomize_buffer(b, depth);
+    memset(dst_ref, 0, BUF_SIZE);
+    memset(dst_new, 0, BUF_SIZE);
+
+    if (check_func(dsp.fade, "fade%d", depth)) {
+        call_ref(dst_ref, a, b, w, progress);
+        call_new(dst_new, a, b, w, progress);
+        if (memcmp(dst_ref, dst_new, w * bpp))
+            fail();
+        bench_new(dst_new, a, b, WIDTH, progress);
+    }
+}
+
+static void check_dissolve(int depth)
+{
+    LOCAL_ALIGNED_32(uint8_t, a,       [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, b,       [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [BUF_SIZE]);
+    LOCAL_ALIGNED_32(float,   noise,   [WIDTH_PADDED]);
+    const int bpp = 1 + (depth > 8);
+    const int w = WIDTH - (rnd() & 15);
+    const float progress = (rnd() & 0xFFFF) / 65535.f;
+    XFadeDSPContext dsp;
+
+    declare_func(void, uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                 const float *noise, ptrdiff_t width, float progress);
+
+    ff_xfade_init(&dsp, depth);
+    randomize_buffer(a, depth);
+    randomize_buffer(b, depth);
+    memset(dst_ref, 0, BUF_SIZE);
+    memset(dst_new, 0, BUF_SIZE);
+    for (int i = 0; i < WIDTH_PADDED; i++)
+        noise[i] = (rnd() & 0xFFFFFF) / (float)(1 << 24);
+
+    if (check_func(dsp.dissolve, "dissolve%d", depth)) {
+        call_ref(dst_ref, a, b, noise, w, progress);
+        call_new(dst_new, a, b, noise, w, progress);
+        if (memcmp(dst_ref, dst_new, w * bpp))
+            fail();
+        bench_new(dst_new, a, b, noise, WIDTH, progress);
+    }
+}
+
+void checkasm_check_vf_xfade(void)
+{
+    check_fade(8);
+    check_fade(16);
+    report("fade");
+
+    check_dissolve(8);
+    check_dissolve(16);
+    report("dissolve");
+}
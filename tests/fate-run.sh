@@ -305,12 +305,22 @@ lavf_audio(){
 }
 
 lavf_container(){
-    t="${test#lavf-}"
+    t="${test#lavf-${io:+$io-}}"
     outdir="tests/data/lavf"
-    file=${outdir}/lavf.$t
-    do_avconv $file -auto_conversion_filters $DEC_OPTS -f image2 -c:v pgmyuv -i $raw_src $DEC_OPTS -ar 44100 -f s16le $1 -i $pcm_src "$ENC_OPTS -metadata title=lavftest" -b:a 64k -t 1 -qscale:v 10 $2
+    file=${outdir}/lavf${io:+-$io}.$t
+    do_avconv $file -auto_conversion_filters $DEC_OPTS -f image2 -c:v pgmyuv -i $raw_src $DEC_OPTS -ar 44100 -f s16le $1 -i $pcm_src "$ENC_OPTS -metadata title=lavftest" -b:a 64k -t 1 -qscale:v 10 $2 $io_mux_opts
     test "$3" = "disable_crc" ||
-        do_avconv_crc $file -auto_conversion_filters $DEC_OPTS -i $target_path/$file $3
+        do_avconv_crc $file -auto_conversion_filters $DEC_OPTS $io_demux_opts -i $target_path/$file $3
+}
+
+# Run a lavf_container test named lavf-<io>-<ext> with protocol options for
+# writing and reading the file, printing the paths of the plain test.
+lavf_container_io(){
+    io=$1
+    io_mux_opts=$2
+    io_demux_opts=$3
+    shift 3
+    "$@" | sed "s,/lavf-$io\.,/lavf.,"
 }
 
 lavf_container_attach() {          lavf_container "" "$1 -attach ${raw_src%/*}/00.pgm -metadata:s:t mimetype=image/x-portable-greymap"; }
@@ -4,6 +4,7 @@ FATE_CHECKASM = fate-checkasm-aacpsdsp                                  \
                 fate-checkasm-audiodsp                                  \
                 fate-checkasm-blockdsp                                  \
                 fate-checkasm-bswapdsp                                  \
+                fate-checkasm-drawutils                                 \
                 fate-checkasm-exrdsp                                    \
                 fate-checkasm-fixed_dsp                                 \
                 fate-checkasm-flacdsp                                   \
@@ -29,10 +30,16 @@ FATE_CHECKASM = fate-checkasm-aacpsdsp                                  \
                 fate-checkasm-v210enc                                   \
                 fate-checkasm-vf_blend                                  \
                 fate-checkasm-vf_colorspace                             \
+                fate-checkasm-vf_deshake                                \
                 fate-checkasm-vf_eq                                     \
                 fate-checkasm-vf_gblur                                  \
                 fate-checkasm-vf_hflip                                  \
+                fate-checkasm-vf_lut3d                                  \
+                fate-checkasm-vf_overlay                                \
+                fate-checkasm-vf_paletteuse                             \
                 fate-checkasm-vf_threshold                              \
+                fate-checkasm-vf_thumbnail                              \
+                fate-checkasm-vf_xfade                                  \
                 fate-checkasm-videodsp                                  \
                 fate-checkasm-vp8dsp                                    \
                 fate-checkasm-vp9dsp                                    \
@@ -122,6 +122,10 @@ FATE_FILTER-$(call ALLYES, FRAMERATE_FILTER TESTSRC2_FILTER FORMAT_FILTER) += fa
 fate-filter-framerate-12bit-up: CMD = framecrc -lavfi testsrc2=r=50:d=1,format=pix_fmts=yuv422p12le,scale,framerate=fps=60,scale -t 1 -pix_fmt yuv422p12le
 fate-filter-framerate-12bit-down: CMD = framecrc -lavfi testsrc2=r=60:d=1,format=pix_fmts=yuv422p12le,scale,framerate=fps=50,scale -t 1 -pix_fmt yuv422p12le
 
+FATE_FILTER-$(call ALLYES, DESHAKE_FILTER TESTSRC2_FILTER) += fate-filter-deshake-tiny fate-filter-deshake-small-area
+fate-filter-deshake-tiny: CMD = framecrc -lavfi testsrc2=s=48x48:r=5:d=1,deshake
+fate-filter-deshake-small-area: CMD = framecrc -lavfi testsrc2=s=160x120:r=5:d=1,deshake=x=0:y=0:w=20:h=20
+
 FATE_FILTER-$(call ALLYES, MINTERPOLATE_FILTER TESTSRC2_FILTER) += fate-filter-minterpolate-up fate-filter-minterpolate-down
 fate-filter-minterpolate-up: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10 -t 1
 fate-filter-minterpolate-down: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=1 -t 1
@@ -462,6 +466,47 @@ fate-filter-fps-down-eof-pass: CMD = framecrc -lavfi testsrc2=r=7:d=3.5,fps=3:eo
 fate-filter-fps-start-drop: CMD = framecrc -lavfi testsrc2=r=7:d=3.5,fps=3:start_time=1.5
 fate-filter-fps-start-fill: CMD = framecrc -lavfi testsrc2=r=7:d=1.5,setpts=PTS+14,fps=3:start_time=1.5
 
+# Frames repeated by fps are sent again by scale and overlay, and dropped by
+# the encoder with skip_duplicate. copy does not forward the duplicate flag,
+# so the -nodup variants process every frame for the shared reference.
+FPS_DUP_SRC = testsrc2=r=3:d=2,format=yuv420p
+FPS_DUP_SCALE = scale=64:48:flags=bicubic+accurate_rnd+bitexact
+FPS_DUP_OVERLAY = [o];testsrc2=s=16x16:r=1:d=1,format=yuva420p[ov];[o][ov]overlay=8:8
+FATE_FILTER-$(call ALLYES, FPS_FILTER TESTSRC2_FILTER FORMAT_FILTER COPY_FILTER SCALE_FILTER) += fate-filter-fps-dup-scale fate-filter-fps-dup-scale-nodup
+fate-filter-fps-dup-scale: CMD = framecrc -lavfi $(FPS_DUP_SRC),fps=7,$(FPS_DUP_SCALE)
+fate-filter-fps-dup-scale-nodup: CMD = framecrc -lavfi $(FPS_DUP_SRC),fps=7,copy,$(FPS_DUP_SCALE)
+fate-filter-fps-dup-scale-nodup: REF = $(SRC_PATH)/tests/ref/fate/filter-fps-dup-scale
+
+FATE_FILTER-$(call ALLYES, FPS_FILTER TESTSRC2_FILTER FORMAT_FILTER COPY_FILTER OVERLAY_FILTER) += fate-filter-fps-dup-overlay fate-filter-fps-dup-overlay-nodup
+fate-filter-fps-dup-overlay: CMD = framecrc -lavfi "$(FPS_DUP_SRC),fps=7$(FPS_DUP_OVERLAY)"
+fate-filter-fps-dup-overlay-nodup: CMD = framecrc -lavfi "$(FPS_DUP_SRC),fps=7,copy$(FPS_DUP_OVERLAY)"
+fate-filter-fps-dup-overlay-nodup: REF = $(SRC_PATH)/tests/ref/fate/filter-fps-dup-overlay
+
+FATE_FILTER-$(call ALLYES, FPS_FILTER TESTSRC2_FILTER FORMAT_FILTER MPEG4_ENCODER) += fate-filter-fps-dup-skip
+fate-filter-fps-dup-skip: CMD = framecrc -lavfi $(FPS_DUP_SRC),fps=7 -c:v mpeg4 -skip_duplicate 1 -qscale:v 10 -threads 1 -flags +bitexact
+
+# The captions of a frame repeated by fps are only kept on its first output,
+# also when scale or overlay send their previous output again. The captions
+# are read back as a subtitle stream through subcc.
+tests/data/fps-dup-a53cc.m2v: TAG = GEN
+tests/data/fps-dup-a53cc.m2v: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+	-f lavfi -i testsrc2=size=32x32:rate=5:duration=1 -c:v mpeg2video -g 1 -qscale:v 10 -threads 1 \
+	-flags +bitexact -fflags +bitexact -f mpeg2video -y $(TARGET_PATH)/tests/data/fps-dup.m2v 2>/dev/null && \
+	for i in 1 2; do printf '\000\000\001\262GA94\003\301\377\374\224\054'; cat tests/data/fps-dup.m2v; done > $@
+
+FPS_DUP_CC_COMMAND = ffprobe$(PROGSSUF)$(EXESUF) -of compact=p=0 -show_entries packet=stream_index,pts -bitexact -f lavfi
+FPS_DUP_CC_SRC = movie='$(TARGET_PATH)/tests/data/fps-dup-a53cc.m2v',fps=15
+FPS_DUP_CC_DEPS = FFPROBE LAVFI_INDEV MOVIE_FILTER MPEG2VIDEO_ENCODER MPEG2VIDEO_DECODER MPEGVIDEO_DEMUXER \
+                  TESTSRC2_FILTER FPS_FILTER SCALE_FILTER COLOR_FILTER TRIM_FILTER OVERLAY_FILTER
+FATE_FPS_DUP_CC = fate-filter-fps-dup-a53cc fate-filter-fps-dup-a53cc-scale fate-filter-fps-dup-a53cc-overlay
+FATE_FILTER_FFPROBE-$(call ALLYES, $(FPS_DUP_CC_DEPS)) += $(FATE_FPS_DUP_CC)
+$(FATE_FPS_DUP_CC): tests/data/fps-dup-a53cc.m2v
+fate-filter-fps-dup-a53cc-scale fate-filter-fps-dup-a53cc-overlay: REF = $(SRC_PATH)/tests/ref/fate/filter-fps-dup-a53cc
+fate-filter-fps-dup-a53cc: CMD = run $(FPS_DUP_CC_COMMAND) "$(FPS_DUP_CC_SRC)[out0+subcc]"
+fate-filter-fps-dup-a53cc-scale: CMD = run $(FPS_DUP_CC_COMMAND) "$(FPS_DUP_CC_SRC),$(FPS_DUP_SCALE)[out0+subcc]"
+fate-filter-fps-dup-a53cc-overlay: CMD = run $(FPS_DUP_CC_COMMAND) "$(FPS_DUP_CC_SRC)[m];color=red:s=8x8,trim=end_frame=1[o];[m][o]overlay[out0+subcc]"
+
 FATE_FILTER_SAMPLES-$(call ALLYES, MOV_DEMUXER FPS_FILTER QTRLE_DECODER) += fate-filter-fps-cfr fate-filter-fps fate-filter-fps-r
 fate-filter-fps-cfr: CMD = framecrc -auto_conversion_filters -i $(TARGET_SAMPLES)/qtrle/apple-animation-variable-fps-bug.mov -r 30 -vsync cfr -pix_fmt yuv420p
 fate-filter-fps-r:   CMD = framecrc -auto_conversion_filters -i $(TARGET_SAMPLES)/qtrle/apple-animation-variable-fps-bug.mov -r 30 -vf fps -pix_fmt yuv420p
@@ -862,7 +907,8 @@ fate-filter-refcmp-ssim-yuv: CMD = refcmp_metadata ssim yuv422p 0.015
 FATE_SAMPLES_FFPROBE += $(FATE_METADATA_FILTER-yes)
 FATE_SAMPLES_FFMPEG += $(FATE_FILTER_SAMPLES-yes)
 FATE_FFMPEG += $(FATE_FILTER-yes)
+FATE_FFPROBE += $(FATE_FILTER_FFPROBE-yes)
 
-fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_SAMPLES-yes) $(FATE_FILTER_VSYNTH-yes)
+fate-vfilter: $(FATE_FILTER-yes) $(FATE_FILTER_SAMPLES-yes) $(FATE_FILTER_VSYNTH-yes) $(FATE_FILTER_FFPROBE-yes)
 
 fate-filter: fate-afilter fate-vfilter $(FATE_METADATA_FILTER-yes)
@@ -41,6 +41,13 @@ fate-hls-live-endlist: CMD = md5 -i $(SRC) -af hdcd=process_stereo=false -t 20 -
 fate-hls-live-endlist: CMP = oneline
 fate-hls-live-endlist: REF = e189ce781d9c87882f58e3929455167b
 
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-live-endlist-prefetch
+fate-hls-live-endlist-prefetch: tests/data/live_endlist.m3u8
+fate-hls-live-endlist-prefetch: SRC = $(TARGET_PATH)/tests/data/live_endlist.m3u8
+fate-hls-live-endlist-prefetch: CMD = md5 -prefetch_segments 2 -i $(SRC) -af hdcd=process_stereo=false -t 20 -f s24le
+fate-hls-live-endlist-prefetch: CMP = oneline
+fate-hls-live-endlist-prefetch: REF = e189ce781d9c87882f58e3929455167b
+
 tests/data/hls_segment_size.m3u8: TAG = GEN
 tests/data/hls_segment_size.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
@@ -63,6 +70,11 @@ FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILT
 fate-hls-segment-single: tests/data/hls_segment_single.m3u8
 fate-hls-segment-single: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_segment_single.m3u8 -vf setpts=N*23
 
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-segment-single-prefetch
+fate-hls-segment-single-prefetch: tests/data/hls_segment_single.m3u8
+fate-hls-segment-single-prefetch: CMD = framecrc -auto_conversion_filters -flags +bitexact -prefetch_segments 2 -prefetch_size 65536 -i $(TARGET_PATH)/tests/data/hls_segment_single.m3u8 -vf setpts=N*23
+fate-hls-segment-single-prefetch: REF = $(SRC_PATH)/tests/ref/fate/hls-segment-single
+
 tests/data/hls_init_time.m3u8: TAG = GEN
 tests/data/hls_init_time.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
@@ -97,6 +109,18 @@ FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MPEGTS_MUXER MPEGTS_DEMUXER AEVALSRC_FILT
 fate-hls-fmp4: tests/data/hls_fmp4.m3u8
 fate-hls-fmp4: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_fmp4.m3u8 -vf setpts=N*23
 
+tests/data/hls_fmp4_parts.m3u8: TAG = GEN
+tests/data/hls_fmp4_parts.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=5" -map 0 -codec:a mp2fixed \
+	-hls_segment_type fmp4 -hls_fmp4_init_filename hls_fmp4_parts_init.mp4 -hls_list_size 0 \
+	-hls_time 1 -hls_part_time 0.25 -hls_segment_filename "$(TARGET_PATH)/tests/data/hls_fmp4_parts_%d.m4s" \
+	$(TARGET_PATH)/tests/data/hls_fmp4_parts.m3u8 2>/dev/null
+
+FATE_HLSENC-$(call ALLYES, HLS_DEMUXER MOV_MUXER MOV_DEMUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-fmp4-parts
+fate-hls-fmp4-parts: tests/data/hls_fmp4_parts.m3u8
+fate-hls-fmp4-parts: CMD = framecrc -auto_conversion_filters -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_fmp4_parts.m3u8
+
 tests/data/hls_fmp4_ac3.m3u8: TAG = GEN
 tests/data/hls_fmp4_ac3.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
 	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< \
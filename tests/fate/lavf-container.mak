@@ -53,8 +53,26 @@ fate-lavf-rm:  CMD = lavf_container "" "-c:a ac3_fixed" disable_crc
 fate-lavf-ts:  CMD = lavf_container "" "-mpegts_transport_stream_id 42 -ar 44100 -threads 1"
 fate-lavf-wtv: CMD = lavf_container "" "-c:a mp2 -threads 1"
 
-FATE_AVCONV += $(FATE_LAVF_CONTAINER)
-fate-lavf-container fate-lavf: $(FATE_LAVF_CONTAINER)
+# The same files written and read through io_uring with small requests and
+# few of them in flight, so that the ring wraps and waits often.
+FATE_LAVF_URING-$(call ENCDEC2, MPEG4,      MP2,       MATROSKA)           += mkv
+FATE_LAVF_URING-$(call ENCDEC2, MPEG4,      PCM_ALAW,  MOV)                += mov
+FATE_LAVF_URING-$(call ENCDEC,  MPEG4,                 MOV)                += mp4
+FATE_LAVF_URING-$(call ENCDEC2, MPEG2VIDEO, MP2,       MPEGTS)             += ts
+
+FATE_LAVF_URING = $(FATE_LAVF_URING-yes:%=fate-lavf-uring-%)
+LAVF_URING_OPTS = -io_uring 1 -io_uring_block_size 4096 -io_uring_depth 2
+
+$(FATE_LAVF_URING): REF = $(SRC_PATH)/tests/ref/lavf/$(@:fate-lavf-uring-%=%)
+$(FATE_LAVF_URING): $(AREF) $(VREF)
+
+fate-lavf-uring-mkv: CMD = lavf_container_io uring "$(LAVF_URING_OPTS)" "$(LAVF_URING_OPTS)" lavf_container "" "-c:a mp2 -c:v mpeg4 -ar 44100 -threads 1"
+fate-lavf-uring-mov: CMD = lavf_container_io uring "$(LAVF_URING_OPTS)" "$(LAVF_URING_OPTS)" lavf_container_timecode "-movflags +faststart -c:a pcm_alaw -c:v mpeg4 -threads 1"
+fate-lavf-uring-mp4: CMD = lavf_container_io uring "$(LAVF_URING_OPTS)" "$(LAVF_URING_OPTS)" lavf_container_timecode "-c:v mpeg4 -an -threads 1"
+fate-lavf-uring-ts:  CMD = lavf_container_io uring "$(LAVF_URING_OPTS)" "$(LAVF_URING_OPTS)" lavf_container "" "-mpegts_transport_stream_id 42 -ar 44100 -threads 1"
+
+FATE_AVCONV += $(FATE_LAVF_CONTAINER) $(FATE_LAVF_URING)
+fate-lavf-container fate-lavf: $(FATE_LAVF_CONTAINER) $(FATE_LAVF_URING)
 
 FATE_LAVF_CONTAINER_FATE-$(call ALLYES, IVF_DEMUXER AV1_PARSER MOV_MUXER)      += av1.mp4
 FATE_LAVF_CONTAINER_FATE-$(call ALLYES, IVF_DEMUXER AV1_PARSER MATROSKA_MUXER) += av1.mkv
@@ -149,6 +149,16 @@ fate-tree: libavutil/tests/tree$(EXESUF)
 fate-tree: CMD = run libavutil/tests/tree$(EXESUF)
 fate-tree: CMP = null
 
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-threadmessage
+fate-threadmessage: libavutil/tests/threadmessage$(EXESUF)
+fate-threadmessage: CMD = run libavutil/tests/threadmessage$(EXESUF)
+fate-threadmessage: CMP = null
+
+FATE_LIBAVUTIL-$(HAVE_THREADS) += fate-threadpool
+fate-threadpool: libavutil/tests/threadpool$(EXESUF)
+fate-threadpool: CMD = run libavutil/tests/threadpool$(EXESUF)
+fate-threadpool: CMP = null
+
 FATE_LIBAVUTIL += fate-twofish
 fate-twofish: libavutil/tests/twofish$(EXESUF)
 fate-twofish: CMD = run libavutil/tests/twofish$(EXESUF)
@@ -33,11 +33,86 @@ FATE_MOV_FFPROBE = fate-mov-neg-firstpts-discard \
 
 FATE_MOV_FASTSTART = fate-mov-faststart-4gb-overflow \
 
+# Seeks in fragmented files whose fragments do not start with a keyframe,
+# indexed by a sidx per segment with and without walking them, or by a
+# global sidx. The packets read must be the same in the three cases.
+tests/data/mov-dash-sidx.mp4: TAG = GEN
+tests/data/mov-dash-sidx.mp4: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "testsrc2=size=64x48:rate=25:duration=10" -f lavfi -i "aevalsrc=sin(2*PI*440*t):d=10" \
+        -c:v mpeg4 -g 30 -bf 2 -threads 1 -c:a mp2fixed -flags +bitexact -fflags +bitexact \
+        -movflags dash -frag_duration 1000000 -y $(TARGET_PATH)/$@ 2>/dev/null
+
+tests/data/mov-global-sidx.mp4: TAG = GEN
+tests/data/mov-global-sidx.mp4: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "testsrc2=size=64x48:rate=25:duration=10" -f lavfi -i "aevalsrc=sin(2*PI*440*t):d=10" \
+        -c:v mpeg4 -g 30 -bf 2 -threads 1 -c:a mp2fixed -flags +bitexact -fflags +bitexact \
+        -movflags empty_moov+default_base_moof+global_sidx -frag_duration 1000000 -y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_MOV_FFMPEG_FFPROBE-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER AEVALSRC_FILTER MPEG4_ENCODER \
+                                      MP2FIXED_ENCODER MOV_MUXER MOV_DEMUXER) \
+                                      += fate-mov-dash-sidx-seek fate-mov-dash-sidx-walk-seek \
+                                         fate-mov-global-sidx-seek
+fate-mov-dash-sidx-seek: tests/data/mov-dash-sidx.mp4
+fate-mov-dash-sidx-seek: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -walk_sidx 0 -read_intervals 5.3%+0.4,2%+0.4,8.1%+0.4 -show_entries packet=stream_index,pts,dts,flags -of compact -bitexact $(TARGET_PATH)/tests/data/mov-dash-sidx.mp4
+fate-mov-dash-sidx-walk-seek: tests/data/mov-dash-sidx.mp4
+fate-mov-dash-sidx-walk-seek: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -walk_sidx 1 -read_intervals 5.3%+0.4,2%+0.4,8.1%+0.4 -show_entries packet=stream_index,pts,dts,flags -of compact -bitexact $(TARGET_PATH)/tests/data/mov-dash-sidx.mp4
+fate-mov-dash-sidx-walk-seek: REF = $(SRC_PATH)/tests/ref/fate/mov-dash-sidx-seek
+fate-mov-global-sidx-seek: tests/data/mov-global-sidx.mp4
+fate-mov-global-sidx-seek: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -read_intervals 5.3%+0.4,2%+0.4,8.1%+0.4 -show_entries packet=stream_index,pts,dts,flags -of compact -bitexact $(TARGET_PATH)/tests/data/mov-global-sidx.mp4
+fate-mov-global-sidx-seek: REF = $(SRC_PATH)/tests/ref/fate/mov-dash-sidx-seek
+
+# Packets and seeks with the sample tables used as index must be the same as
+# with the index built at open, on a file with B-frames and edit lists.
+tests/data/mov-lazy-index.mp4: TAG = GEN
+tests/data/mov-lazy-index.mp4: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "testsrc2=size=64x48:rate=25:duration=10" -f lavfi -i "aevalsrc=sin(2*PI*440*t):d=10" \
+        -c:v mpeg4 -g 30 -bf 2 -threads 1 -c:a mp2fixed -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+MOV_LAZY_INDEX_FILE = $(TARGET_PATH)/tests/data/mov-lazy-index.mp4
+FATE_MOV_LAZY_INDEX = fate-mov-lazy-index-packets fate-mov-lazy-index-packets-lazy \
+                      fate-mov-lazy-index-seek fate-mov-lazy-index-seek-lazy \
+                      fate-mov-lazy-index-ss fate-mov-lazy-index-ss-lazy
+FATE_MOV_FFMPEG_FFPROBE-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER AEVALSRC_FILTER MPEG4_ENCODER \
+                                      MP2FIXED_ENCODER MOV_MUXER MOV_DEMUXER FRAMECRC_MUXER) \
+                                      += $(FATE_MOV_LAZY_INDEX)
+$(FATE_MOV_LAZY_INDEX): tests/data/mov-lazy-index.mp4
+fate-mov-lazy-index-packets fate-mov-lazy-index-seek fate-mov-lazy-index-ss: MOV_LAZY_INDEX = 0
+fate-mov-lazy-index-packets-lazy fate-mov-lazy-index-seek-lazy fate-mov-lazy-index-ss-lazy: MOV_LAZY_INDEX = 1
+fate-mov-lazy-index-packets fate-mov-lazy-index-packets-lazy: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -lazy_index $(MOV_LAZY_INDEX) -show_packets -of compact -bitexact $(MOV_LAZY_INDEX_FILE)
+fate-mov-lazy-index-seek fate-mov-lazy-index-seek-lazy: CMD = run ffprobe$(PROGSSUF)$(EXESUF) -lazy_index $(MOV_LAZY_INDEX) -read_intervals 5.3%+0.4,2%+0.4,8.1%+0.4 -show_entries packet=stream_index,pts,dts,flags -of compact -bitexact $(MOV_LAZY_INDEX_FILE)
+fate-mov-lazy-index-ss fate-mov-lazy-index-ss-lazy: CMD = framecrc -lazy_index $(MOV_LAZY_INDEX) -ss 5.3 -i $(MOV_LAZY_INDEX_FILE) -c copy
+fate-mov-lazy-index-packets-lazy: REF = $(SRC_PATH)/tests/ref/fate/mov-lazy-index-packets
+fate-mov-lazy-index-seek-lazy: REF = $(SRC_PATH)/tests/ref/fate/mov-lazy-index-seek
+fate-mov-lazy-index-ss-lazy: REF = $(SRC_PATH)/tests/ref/fate/mov-lazy-index-ss
+
+# Check that reserving space for the moov atom keeps the packets untouched,
+# with a duration too short for the reserved space to fit the moov atom.
+MOV_FASTSTART_FILE = tests/data/fate/$(@:fate-%=%).mov
+MOV_FASTSTART_CMD = ffmpeg -f lavfi -i testsrc2=size=32x32:rate=600:duration=10 \
+                    -c:v mpeg4 -qscale:v 10 -bf 2 -threads 1 -flags +bitexact -fflags +bitexact \
+                    -movflags +faststart $(MOV_FASTSTART_OPTS) -y $(TARGET_PATH)/$(MOV_FASTSTART_FILE) && \
+                    do_md5sum $(MOV_FASTSTART_FILE) | cut -d " " -f1 && \
+                    md5 -i $(TARGET_PATH)/$(MOV_FASTSTART_FILE) -c copy -f framecrc
+
+FATE_MOV_FASTSTART_RESERVE = fate-mov-faststart fate-mov-faststart-reserve-moov \
+                             fate-mov-faststart-reserve-moov-fallback
+FATE_MOV_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER MPEG4_ENCODER MOV_MUXER \
+                               MOV_DEMUXER FRAMECRC_MUXER) += $(FATE_MOV_FASTSTART_RESERVE)
+$(FATE_MOV_FASTSTART_RESERVE): CMD = $(MOV_FASTSTART_CMD)
+fate-mov-faststart-reserve-moov: MOV_FASTSTART_OPTS = -reserve_moov 1 -reserve_moov_duration 10
+fate-mov-faststart-reserve-moov-fallback: MOV_FASTSTART_OPTS = -reserve_moov 1 -reserve_moov_duration 0.1
+
 FATE_SAMPLES_AVCONV += $(FATE_MOV)
 FATE_SAMPLES_FFPROBE += $(FATE_MOV_FFPROBE)
 FATE_SAMPLES_FASTSTART += $(FATE_MOV_FASTSTART)
+FATE_FFMPEG += $(FATE_MOV_FFMPEG-yes)
+FATE_FFMPEG_FFPROBE += $(FATE_MOV_FFMPEG_FFPROBE-yes)
 
-fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART)
+fate-mov: $(FATE_MOV) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_FFMPEG-yes) $(FATE_MOV_FFMPEG_FFPROBE-yes)
 
 # Make sure we handle edit lists correctly in normal cases.
 fate-mov-1elist-noctts: CMD = framemd5 -i $(TARGET_SAMPLES)/mov/mov-1elist-noctts.mov
@@ -20,6 +20,35 @@ fate-mpegts-probe-pmt-merge: SRC = $(TARGET_SAMPLES)/mpegts/pmtchange.ts
 fate-mpegts-probe-pmt-merge: CMD = run $(PROBE_CODEC_NAME_COMMAND) -merge_pmt_versions 1 -i "$(SRC)"
 
 
+# Demux only program 20 out of a three-program multiplex. Its packets must be
+# the same as the ones of program 20 in a full demux, and the PIDs of the
+# other programs must not come back as guessed streams.
+tests/data/mpegts-programs.ts: TAG = GEN
+tests/data/mpegts-programs.ts: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+        -f lavfi -i "testsrc2=size=64x48:rate=25:duration=2" -f lavfi -i "sine=frequency=440:duration=2" \
+        -f lavfi -i "testsrc2=size=32x32:rate=25:duration=2" -f lavfi -i "sine=frequency=880:duration=2" \
+        -f lavfi -i "testsrc2=size=48x32:rate=25:duration=2" -f lavfi -i "sine=frequency=220:duration=2" \
+        -map 0 -map 1 -map 2 -map 3 -map 4 -map 5 \
+        -program program_num=10:st=0:st=1 -program program_num=20:st=2:st=3 -program program_num=30:st=4:st=5 \
+        -c:v mpeg2video -threads 1 -c:a mp2fixed -flags +bitexact -fflags +bitexact \
+        -y $(TARGET_PATH)/$@ 2>/dev/null
+
+MPEGTS_PROGRAMS_FILE = $(TARGET_PATH)/tests/data/mpegts-programs.ts
+MPEGTS_PROGRAMS_PROBE = ffprobe$(PROGSSUF)$(EXESUF) -of flat -bitexact -v 0
+FATE_MPEGTS_PROGRAMS = fate-mpegts-programs-streams fate-mpegts-programs-packets \
+                       fate-mpegts-programs-packets-map fate-mpegts-programs-invalid
+FATE_MPEGTS_FFMPEG_FFPROBE-$(call ALLYES, LAVFI_INDEV TESTSRC2_FILTER SINE_FILTER MPEG2VIDEO_ENCODER \
+                                         MP2FIXED_ENCODER MPEGTS_MUXER MPEGTS_DEMUXER) \
+                                         += $(FATE_MPEGTS_PROGRAMS)
+$(FATE_MPEGTS_PROGRAMS): tests/data/mpegts-programs.ts
+fate-mpegts-programs-streams: CMD = run $(MPEGTS_PROGRAMS_PROBE) -programs 20 -show_entries program=program_num:stream=index,id,codec_name $(MPEGTS_PROGRAMS_FILE)
+fate-mpegts-programs-packets: CMD = run $(MPEGTS_PROGRAMS_PROBE) -programs 20 -show_entries packet=codec_type,pts,dts,size,flags $(MPEGTS_PROGRAMS_FILE)
+fate-mpegts-programs-packets-map: CMD = run $(MPEGTS_PROGRAMS_PROBE) -select_streams p:20 -show_entries packet=codec_type,pts,dts,size,flags $(MPEGTS_PROGRAMS_FILE)
+fate-mpegts-programs-packets-map: REF = $(SRC_PATH)/tests/ref/fate/mpegts-programs-packets
+fate-mpegts-programs-invalid: CMD = run $(MPEGTS_PROGRAMS_PROBE) -programs 20,x $(MPEGTS_PROGRAMS_FILE) || echo rejected
+
 FATE_SAMPLES_FFPROBE += $(FATE_MPEGTS_PROBE-yes)
+FATE_FFMPEG_FFPROBE += $(FATE_MPEGTS_FFMPEG_FFPROBE-yes)
 
-fate-mpegts: $(FATE_MPEGTS_PROBE-yes)
+fate-mpegts: $(FATE_MPEGTS_PROBE-yes) $(FATE_MPEGTS_FFMPEG_FFPROBE-yes)
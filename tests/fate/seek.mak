@@ -246,6 +246,19 @@ fate-seek-lavf-y4m:      SRC = lavf/lavf.y4m
 
 FATE_SEEK += $(FATE_SEEK_LAVF-yes:%=fate-seek-lavf-%)
 
+# some of the files from fate-lavf read through a memory mapping
+
+FATE_SEEK_MMAP-$(call ENCDEC2, MPEG4,      MP2,       MATROSKA)    += mkv
+FATE_SEEK_MMAP-$(call ENCDEC2, MPEG4,      PCM_ALAW,  MOV)         += mov
+FATE_SEEK_MMAP-$(call ENCDEC2, MPEG2VIDEO, MP2,       MPEGTS)      += ts
+
+FATE_SEEK_MMAP = $(FATE_SEEK_MMAP-yes:%=fate-seek-mmap-lavf-%)
+
+$(FATE_SEEK_MMAP): libavformat/tests/seek$(EXESUF)
+$(FATE_SEEK_MMAP): fate-seek-mmap-lavf-%: fate-lavf-%
+$(FATE_SEEK_MMAP): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.$(@:fate-seek-mmap-lavf-%=%) -mmap 1
+$(FATE_SEEK_MMAP): REF = $(SRC_PATH)/tests/ref/seek/lavf-$(@:fate-seek-mmap-lavf-%=%)
+
 # extra files
 
 FATE_SEEK_EXTRA-$(CONFIG_MP3_DEMUXER)   += fate-seek-extra-mp3
@@ -273,6 +286,6 @@ $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 $(subst fate-seek-,fate-,$(FATE_SAMPLES_SEEK) $(FATE_SEEK)): KEEP_OVERRIDE = -keep
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_MMAP)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SEEK_MMAP) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
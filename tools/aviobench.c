@@ -0,0 +1,225 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the throughput of reading an url, and optionally copying it to an
+ * output url, through AVIOContext, with several jobs running at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "libavutil/avstring.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "libavformat/avformat.h"
+
+typedef struct Job {
+    const char *input_url;
+    char *output_url;
+    AVDictionary *in_opts;
+    AVDictionary *out_opts;
+    int block_size;
+    int64_t bytes;
+    int ret;
+} Job;
+
+static int usage(const char *argv0, int ret)
+{
+    fprintf(stderr, "%s [-s blocksize] [-j jobs] [-oi <options>] [-oo <options>] input_url [output_url]\n", argv0);
+    fprintf(stderr, "<options>: AVOptions expressed as key=value, :-separated\n");
+    fprintf(stderr, "With several jobs, each one reads the whole input and writes to output_url.<job>\n");
+    return ret;
+}
+
+static void *run_job(void *arg)
+{
+    Job *job = arg;
+    AVIOContext *input = NULL, *output = NULL;
+    uint8_t *buf = av_malloc(job->block_size);
+    char errbuf[50];
+    int ret;
+
+    if (!buf) {
+        job->ret = AVERROR(ENOMEM);
+        return NULL;
+    }
+    ret = avio_open2(&input, job->input_url, AVIO_FLAG_READ, NULL, &job->in_opts);
+    if (ret < 0) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        fprintf(stderr, "Unable to open %s: %s\n", job->input_url, errbuf);
+        goto end;
+    }
+    if (job->output_url) {
+        ret = avio_open2(&output, job->output_url, AVIO_FLAG_WRITE, NULL, &job->out_opts);
+        if (ret < 0) {
+            av_strerror(ret, errbuf, sizeof(errbuf));
+            fprintf(stderr, "Unable to open %s: %s\n", job->output_url, errbuf);
+            goto end;
+        }
+    }
+
+    while (1) {
+        int n = avio_read(input, buf, job->block_size);
+        if (n <= 0) {
+            if (n < 0 && n != AVERROR_EOF)
+                ret = n;
+            break;
+        }
+        job->bytes += n;
+        if (output) {
+            avio_write(output, buf, n);
+            if (output->error) {
+                ret = output->error;
+                break;
+            }
+        }
+    }
+    if (output) {
+        avio_flush(output);
+        if (!ret)
+            ret = output->error;
+    }
+    if (ret < 0) {
+        av_strerror(ret, errbuf, sizeof(errbuf));
+        fprintf(stderr, "Error copying %s: %s\n", job->input_url, errbuf);
+    }
+
+end:
+    if (output) {
+        int err = avio_closep(&output);
+        if (!ret)
+            ret = err;
+    }
+    avio_closep(&input);
+    av_free(buf);
+    job->ret = ret;
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int block_size = 65536, nb_jobs = 1, ret = 0, i;
+    const char *input_url = NULL, *output_url = NULL;
+    AVDictionary *in_opts = NULL, *out_opts = NULL;
+    int64_t start_time, elapsed, bytes = 0;
+    Job *jobs;
+
+    avformat_network_init();
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            block_size = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            nb_jobs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-oi") && i + 1 < argc) {
+            if (av_dict_parse_string(&in_opts, argv[i + 1], "=", ":", 0) < 0) {
+                fprintf(stderr, "Cannot parse option string %s\n",
+                        argv[i + 1]);
+                return usage(argv[0], 1);
+            }
+            i++;
+        } else if (!strcmp(argv[i], "-oo") && i + 1 < argc) {
+            if (av_dict_parse_string(&out_opts, argv[i + 1], "=", ":", 0) < 0) {
+                fprintf(stderr, "Cannot parse option string %s\n",
+                        argv[i + 1]);
+                return usage(argv[0], 1);
+            }
+            i++;
+        } else if (!input_url) {
+            input_url = argv[i];
+        } else if (!output_url) {
+            output_url = argv[i];
+        } else {
+            return usage(argv[0], 1);
+        }
+    }
+    if (!input_url || block_size <= 0 || nb_jobs <= 0)
+        return usage(argv[0], 1);
+#if !HAVE_THREADS
+    if (nb_jobs > 1) {
+        fprintf(stderr, "Several jobs need threading support\n");
+        return 1;
+    }
+#endif
+
+    jobs = av_calloc(nb_jobs, sizeof(*jobs));
+    if (!jobs)
+        return 1;
+    for (i = 0; i < nb_jobs; i++) {
+        Job *job = &jobs[i];
+        job->input_url  = input_url;
+        job->block_size = block_size;
+        if (output_url)
+            job->output_url = nb_jobs > 1 ? av_asprintf("%s.%d", output_url, i)
+                                          : av_strdup(output_url);
+        if ((output_url && !job->output_url) ||
+            av_dict_copy(&job->in_opts, in_opts, 0) < 0 ||
+            av_dict_copy(&job->out_opts, out_opts, 0) < 0) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
+
+    start_time = av_gettime_relative();
+#if HAVE_THREADS
+    if (nb_jobs > 1) {
+        pthread_t *threads = av_calloc(nb_jobs, sizeof(*threads));
+        int nb_threads;
+        if (!threads) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        for (nb_threads = 0; nb_threads < nb_jobs; nb_threads++)
+            if (pthread_create(&threads[nb_threads], NULL, run_job, &jobs[nb_threads]))
+                break;
+        for (i = 0; i < nb_threads; i++)
+            pthread_join(threads[i], NULL);
+        av_free(threads);
+        if (nb_threads < nb_jobs) {
+            fprintf(stderr, "Unable to start the jobs\n");
+            ret = AVERROR(EAGAIN);
+            goto end;
+        }
+    } else
+#endif
+        run_job(&jobs[0]);
+    elapsed = FFMAX(av_gettime_relative() - start_time, 1);
+
+    for (i = 0; i < nb_jobs; i++) {
+        bytes += jobs[i].bytes;
+        if (jobs[i].ret < 0)
+            ret = jobs[i].ret;
+    }
+    printf("%d job(s), %"PRId64" bytes in %.3f s: %.1f MB/s\n", nb_jobs, bytes,
+           elapsed / 1000000.0, bytes / (double)elapsed);
+
+end:
+    for (i = 0; i < nb_jobs; i++) {
+        av_free(jobs[i].output_url);
+        av_dict_free(&jobs[i].in_opts);
+        av_dict_free(&jobs[i].out_opts);
+    }
+    av_free(jobs);
+    av_dict_free(&in_opts);
+    av_dict_free(&out_opts);
+    avformat_network_deinit();
+    return ret < 0;
+}